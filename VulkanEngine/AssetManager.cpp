@@ -3,9 +3,17 @@
 #include "SceneManager.h"
 #include "MeshManager.h"
 #include "Model.h"
+#include "JobSystem.h"
+#include "UploadManager.h"
+#include "MeshCache.h"
+#include "VertexDeduplicator.h"
+#include "MeshOptimizer.h"
+#include "Profiler.h"
 
 #include <algorithm>
 
+#include "imgui/imgui.h"
+
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tiny_obj_loader.h>
 
@@ -19,7 +27,16 @@ void AssetManager::Create()
 
 void AssetManager::Destroy() 
 {
-
+    // decode jobs are drained by JobSystem::Destroy before this runs
+    for (PendingTexture* pending : pendingTextures)
+    {
+        if (pending->pixels != nullptr)
+        {
+            stbi_image_free(pending->pixels);
+        }
+        delete pending;
+    }
+    pendingTextures.clear();
 }
 
 void AssetManager::Load(std::filesystem::path path) 
@@ -34,125 +51,678 @@ void AssetManager::Load(std::filesystem::path path)
     }
 }
 
-std::vector<Model*> AssetManager::LoadObjFile(std::filesystem::path path) 
+struct ObjData
 {
+    std::filesystem::path path;
     tinyobj::attrib_t attrib;
     std::vector<tinyobj::shape_t> shapes;
     std::vector<tinyobj::material_t> materials;
-    std::string warn, err;
-    std::filesystem::path parentPath = path.parent_path();
-    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path.string().c_str(), parentPath.string().c_str())) 
+    std::string warn;
+    std::string err;
+    std::vector<std::vector<CookedMesh>> shapeMeshes;
+
+    // filled either from the mesh cache or from the parsed shapes
+    bool cached = false;
+    CookedObj cooked;
+};
+
+size_t FreeCookedMeshes(CookedObj& cooked)
+{
+    size_t meshCount = cooked.meshes.size();
+    for (CookedMesh& mesh : cooked.meshes)
     {
-        std::cerr << warn << err << std::endl;
-        std::cerr << "Failed to load obj file " << path.string().c_str() << std::endl;
+        delete mesh.desc;
     }
-    TextureResource* defaultTexture = TextureManager::GetDefaultTexture();
-    std::vector<TextureResource*> diffuseTextures(materials.size());
-    for (size_t i = 0; i < materials.size(); i++) 
+    cooked.meshes.clear();
+    return meshCount;
+}
+
+void ParseObj(ObjData& obj, bool useCache)
+{
+    PROFILE_FUNCTION();
+    uint32_t flags = MeshOptimizer::IsEnabled() ? CookOptimized : 0;
+    if (useCache && MeshCache::Load(obj.path, obj.cooked))
     {
-        if (materials[i].diffuse_texname != "") 
+        if (obj.cooked.flags == flags)
         {
-            std::filesystem::path copyPath = parentPath;
-            diffuseTextures[i] = AssetManager::LoadImageFile(copyPath.append(materials[i].diffuse_texname));
+            for (const CookedMesh& mesh : obj.cooked.meshes)
+            {
+                MeshOptimizer::AddStats(mesh.stats);
+            }
+            obj.cached = true;
+            return;
         }
+        FreeCookedMeshes(obj.cooked);
+        obj.cooked = CookedObj{};
+    }
+    obj.cooked.flags = flags;
+
+    std::filesystem::path parentPath = obj.path.parent_path();
+    if (!tinyobj::LoadObj(&obj.attrib, &obj.shapes, &obj.materials, &obj.warn, &obj.err, obj.path.string().c_str(), parentPath.string().c_str())) 
+    {
+        std::cerr << obj.warn << obj.err << std::endl;
+        std::cerr << "Failed to load obj file " << obj.path.string().c_str() << std::endl;
     }
-    if (warn != "") 
+    obj.shapeMeshes.resize(obj.shapes.size());
+
+    obj.cooked.textures.resize(obj.materials.size());
+    for (size_t i = 0; i < obj.materials.size(); i++)
     {
-        std::cerr << "Warning during load obj file " << path.string().c_str() << warn << std::endl;
+        obj.cooked.textures[i] = obj.materials[i].diffuse_texname;
     }
+}
 
-    std::vector<Model*> models;
+void BuildObjShape(ObjData& obj, size_t shapeIndex)
+{
+    PROFILE_FUNCTION();
+    const tinyobj::shape_t& shape = obj.shapes[shapeIndex];
+    const tinyobj::attrib_t& attrib = obj.attrib;
+    std::vector<CookedMesh>& subMeshes = obj.shapeMeshes[shapeIndex];
 
-    for (int i = 0; i < shapes.size(); i++) 
+    if (shape.mesh.indices.empty())
     {
-        MeshDescriptor* desc = new MeshDescriptor;
-        std::unordered_map<MeshVertex, uint32_t> uniqueVertices{};
-        size_t j = 0;
-        size_t lastMaterialId = shapes[i].mesh.material_ids[0];
-        for (const auto& index : shapes[i].mesh.indices) 
+        return;
+    }
+
+    MeshDescriptor* desc = new MeshDescriptor;
+    VertexDeduplicator uniqueVertices;
+    uniqueVertices.Reserve(shape.mesh.indices.size());
+    size_t j = 0;
+    int lastMaterialId = shape.mesh.material_ids[0];
+    for (const auto& index : shape.mesh.indices) 
+    {
+        MeshVertex vertex{};
+
+        vertex.pos = 
+        {
+            attrib.vertices[3 * index.vertex_index + 0],
+            attrib.vertices[3 * index.vertex_index + 1],
+            attrib.vertices[3 * index.vertex_index + 2]
+        };
+
+        vertex.texCoord = 
+        {
+            attrib.texcoords[2 * index.texcoord_index + 0],
+            1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
+        };
+
+        vertex.color = { 1, 1, 1 };
+
+        desc->indices.push_back(uniqueVertices.Insert(vertex, desc->vertices));
+        j += 1;
+
+        if (j % 3 == 0) 
+        {
+            size_t faceId = j / 3;
+            if (faceId >= shape.mesh.material_ids.size() || shape.mesh.material_ids[faceId] != lastMaterialId) 
+            {
+                subMeshes.push_back({ shape.name, lastMaterialId, desc });
+                if (faceId < shape.mesh.material_ids.size()) 
+                {
+                    lastMaterialId = shape.mesh.material_ids[faceId];
+                }
+                uniqueVertices.Clear();
+                desc = new MeshDescriptor;
+            }
+        }
+    }
+
+    if (desc->vertices.size() != 0)
+    {
+        throw std::runtime_error("Reach shapes iteration ending without creating Model.");
+    }
+    delete desc;
+
+    // optimised before cooking so the cache already holds the reordered buffers
+    for (CookedMesh& subMesh : subMeshes)
+    {
+        subMesh.stats = MeshOptimizer::Optimize(subMesh.name, subMesh.desc->vertices, subMesh.desc->indices, (obj.cooked.flags & CookOptimized) != 0);
+    }
+}
+
+void ParseObjFiles(std::vector<ObjData>& objs, bool useCache)
+{
+    JobSystem::ParallelFor((uint32_t)objs.size(), [&objs, useCache](uint32_t i) { ParseObj(objs[i], useCache); });
+}
+
+void BuildObjFiles(std::vector<ObjData>& objs, bool writeCache)
+{
+    // every shape of every file is an independent job
+    std::vector<std::pair<size_t, size_t>> shapeJobs;
+    for (size_t i = 0; i < objs.size(); i++)
+    {
+        for (size_t j = 0; j < objs[i].shapes.size(); j++)
+        {
+            shapeJobs.push_back({ i, j });
+        }
+    }
+    JobSystem::ParallelFor((uint32_t)shapeJobs.size(), [&objs, &shapeJobs](uint32_t i) 
+    {
+        BuildObjShape(objs[shapeJobs[i].first], shapeJobs[i].second);
+    });
+
+    JobSystem::ParallelFor((uint32_t)objs.size(), [&objs, writeCache](uint32_t i)
+    {
+        ObjData& obj = objs[i];
+        if (obj.cached)
         {
-            MeshVertex vertex{};
+            return;
+        }
+        for (auto& subMeshes : obj.shapeMeshes)
+        {
+            obj.cooked.meshes.insert(obj.cooked.meshes.end(), subMeshes.begin(), subMeshes.end());
+        }
+        if (writeCache && !obj.cooked.meshes.empty())
+        {
+            MeshCache::Save(obj.path, obj.cooked);
+        }
+    });
+}
+
+size_t FreeObjFiles(std::vector<ObjData>& objs)
+{
+    size_t meshCount = 0;
+    for (ObjData& obj : objs)
+    {
+        meshCount += FreeCookedMeshes(obj.cooked);
+    }
+    return meshCount;
+}
+
+void DecodeTexture(PendingTexture* pending)
+{
+    PROFILE_FUNCTION();
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // a cooked chain is only mapped, the file is read as the levels are staged
+    if (pending->useCooked && TextureCache::Load(pending->path, pending->cooked) && TextureManager::IsFormatSupported(pending->cooked.format))
+    {
+        auto end = std::chrono::high_resolution_clock::now();
+        pending->decodeMs = std::chrono::duration<float, std::milli>(end - start).count();
+        pending->width = (int)pending->cooked.width;
+        pending->height = (int)pending->cooked.height;
+        pending->contentHash = pending->hashContent ? pending->cooked.pixelHash : 0;
+        pending->decoded = true;
+        return;
+    }
+    pending->cooked = CookedTexture();
+
+    pending->pixels = AssetManager::DecodeImageFile(pending->path, pending->width, pending->height);
+    auto end = std::chrono::high_resolution_clock::now();
+    pending->decodeMs = std::chrono::duration<float, std::milli>(end - start).count();
+
+    if (pending->pixels != nullptr && pending->hashContent)
+    {
+        pending->contentHash = FileManager::Hash(pending->pixels, (size_t)pending->width * pending->height * 4);
+    }
+    // level 0 is copied into the chain, the decoded pixels are not needed after
+    if (pending->pixels != nullptr && MipGenerator::IsEnabled())
+    {
+        MipGenerator::Generate(pending->pixels, pending->width, pending->height, !TextureCache::IsNormalMap(pending->path), pending->mips);
+        AssetManager::FreeImage(pending->pixels);
+        pending->pixels = nullptr;
+    }
+    pending->decoded = true;
+}
 
-            vertex.pos = 
+std::vector<Model*> AssetManager::LoadObjFile(std::filesystem::path path) 
+{
+    return LoadObjFiles({ path })[0];
+}
+
+std::vector<std::vector<Model*>> AssetManager::LoadObjFiles(const std::vector<std::filesystem::path>& paths)
+{
+    PROFILE_FUNCTION();
+    auto start = std::chrono::high_resolution_clock::now();
+
+    std::vector<ObjData> objs(paths.size());
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        objs[i].path = paths[i];
+    }
+
+    MeshOptimizer::ClearStats();
+    ParseObjFiles(objs, true);
+
+    // start decoding images right away so idle workers overlap them with the vertex deduplication,
+    // they are background jobs so every mesh build job is taken first and the Wait in
+    // BuildObjFiles never runs a decode on this thread
+    if (pendingTextures.empty())
+    {
+        streamStart = start;
+    }
+    std::unordered_map<std::string, PendingTexture*> requested;
+    std::vector<std::vector<PendingTexture*>> materialTextures(objs.size());
+    for (size_t i = 0; i < objs.size(); i++)
+    {
+        const ObjData& obj = objs[i];
+        materialTextures[i].resize(obj.cooked.textures.size(), nullptr);
+        for (size_t m = 0; m < obj.cooked.textures.size(); m++) 
+        {
+            if (obj.cooked.textures[m] == "") 
             {
-                attrib.vertices[3 * index.vertex_index + 0],
-                attrib.vertices[3 * index.vertex_index + 1],
-                attrib.vertices[3 * index.vertex_index + 2]
-            };
+                continue;
+            }
+            std::filesystem::path texturePath = obj.path.parent_path();
+            texturePath.append(obj.cooked.textures[m]);
 
-            vertex.texCoord = 
+            std::string key = TextureManager::GetCacheKey(texturePath);
+            PendingTexture*& pending = requested[key];
+            if (pending == nullptr)
             {
-                attrib.texcoords[2 * index.texcoord_index + 0],
-                1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
-            };
+                // a file still decoding from an earlier load
+                auto it = std::find_if(pendingTextures.begin(), pendingTextures.end(), [&](PendingTexture* other) { return other->key == key; });
+                if (it != pendingTextures.end())
+                {
+                    pending = *it;
+                }
+            }
+            if (pending == nullptr)
+            {
+                pending = new PendingTexture();
+                pending->path = texturePath;
+                pending->key = key;
+                pendingTextures.push_back(pending);
 
-            vertex.color = { 1, 1, 1 };
+                // already resident, the models get it on the next Update
+                pending->texture = TextureManager::Find(texturePath);
+                if (pending->texture != nullptr)
+                {
+                    pending->decoded = true;
+                }
+                else
+                {
+                    pending->hashContent = TextureManager::IsContentHashEnabled();
+                    pending->useCooked = TextureManager::IsCookedEnabled();
+                    JobSystem::Submit([pending]() { DecodeTexture(pending); }, nullptr, JobPriority::Background);
+                }
+            }
+            materialTextures[i][m] = pending;
+        }
+        if (obj.warn != "") 
+        {
+            std::cerr << "Warning during load obj file " << obj.path.string().c_str() << obj.warn << std::endl;
+        }
+    }
 
-            if (uniqueVertices.count(vertex) == 0) 
+    BuildObjFiles(objs, true);
+
+    // gpu resources are created here, on the calling thread, in file order
+    TextureResource* defaultTexture = TextureManager::GetDefaultTexture();
+    std::vector<std::vector<Model*>> models(objs.size());
+    for (size_t i = 0; i < objs.size(); i++)
+    {
+        for (const CookedMesh& subMesh : objs[i].cooked.meshes)
+        {
+            Model* model = SceneManager::CreateModel();
+            model->mesh = MeshManager::CreateMesh(subMesh.desc);
+            model->name = subMesh.name;
+            SceneManager::SetTexture(model, defaultTexture);
+            if (subMesh.materialId >= 0 && subMesh.materialId < materialTextures[i].size() && materialTextures[i][subMesh.materialId] != nullptr)
+            {
+                materialTextures[i][subMesh.materialId]->models.push_back(model);
+            }
+            models[i].push_back(model);
+        }
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+    lastLoadMs = std::chrono::duration<float, std::milli>(end - start).count();
+    std::cout << "Loaded " << paths.size() << " obj files in " << lastLoadMs << " ms on " << JobSystem::GetThreadCount() + 1 << " threads" << std::endl;
+
+    return models;
+}
+
+void AssetManager::Update()
+{
+    PROFILE_FUNCTION();
+    for (size_t i = 0; i < pendingTextures.size();)
+    {
+        PendingTexture* pending = pendingTextures[i];
+
+        if (pending->texture == nullptr && pending->decoded)
+        {
+            if (pending->pixels == nullptr && pending->cooked.file == nullptr && pending->mips.levels.empty())
+            {
+                std::cerr << "Failed to load image file " << pending->path.string().c_str() << std::endl;
+                delete pending;
+                pendingTextures.erase(pendingTextures.begin() + i);
+                continue;
+            }
+
+            // same pixels under another name share the resident texture
+            pending->texture = TextureManager::FindContent(pending->contentHash, pending->width, pending->height, pending->path);
+            if (pending->texture == nullptr)
+            {
+                TextureDescriptor desc{};
+                if (pending->cooked.file != nullptr)
+                {
+                    TextureManager::DescribeCooked(pending->cooked, desc);
+                }
+                else if (!pending->mips.levels.empty())
+                {
+                    desc.data = pending->mips.data.data();
+                    desc.width = pending->width;
+                    desc.height = pending->height;
+                    desc.levels = pending->mips.levels;
+                    desc.size = pending->mips.data.size();
+                }
+                else
+                {
+                    desc.data = pending->pixels;
+                    desc.width = pending->width;
+                    desc.height = pending->height;
+                }
+                desc.path = pending->path;
+                desc.contentHash = pending->contentHash;
+                desc.decodeMs = pending->decodeMs;
+
+                pending->texture = TextureManager::CreateTexture(desc);
+                TextureManager::Acquire(pending->texture);
+            }
+
+            // the levels were copied to staging memory, the mapping and the chain can go
+            pending->cooked = CookedTexture();
+            pending->mips = MipChain();
+            if (pending->pixels != nullptr)
             {
-                uniqueVertices[vertex] = (uint32_t)(desc->vertices.size());
-                desc->vertices.push_back(vertex);
+                FreeImage(pending->pixels);
+                pending->pixels = nullptr;
             }
+        }
 
-            desc->indices.push_back(uniqueVertices[vertex]);
-            j += 1;
+        if (pending->texture != nullptr && UploadManager::IsComplete(pending->texture->uploadTicket))
+        {
+            for (Model* model : pending->models)
+            {
+                SceneManager::SetTexture(model, pending->texture);
+            }
+            TextureManager::Release(pending->texture);
+            texturesStreamed++;
+            delete pending;
+            pendingTextures.erase(pendingTextures.begin() + i);
 
-            if (j % 3 == 0) 
+            if (pendingTextures.empty())
             {
-                size_t faceId = j / 3;
-                if (faceId >= shapes[i].mesh.material_ids.size() || shapes[i].mesh.material_ids[faceId] != lastMaterialId) 
+                auto end = std::chrono::high_resolution_clock::now();
+                lastStreamMs = std::chrono::duration<float, std::milli>(end - streamStart).count();
+            }
+            continue;
+        }
+
+        i++;
+    }
+}
+
+void AssetManager::OnImgui()
+{
+    const auto totalSpace = ImGui::GetContentRegionAvail();
+    const float totalWidth = totalSpace.x;
+
+    if (ImGui::CollapsingHeader("Assets"))
+    {
+        ImGui::Text("Last Load");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::Text("%.2f ms", lastLoadMs);
+        ImGui::Text("Textures Resident After");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::Text("%.2f ms", lastStreamMs);
+        ImGui::Text("Textures Streamed");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::Text("%zu", texturesStreamed);
+        ImGui::Text("Textures Pending");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::Text("%zu", pendingTextures.size());
+    }
+}
+
+void AssetManager::BenchmarkLoad(const std::vector<std::filesystem::path>& paths, uint32_t maxThreads)
+{
+    if (maxThreads == 0)
+    {
+        maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (uint32_t threads = 1; threads <= maxThreads; threads *= 2)
+    {
+        // the calling thread also runs jobs, so one thread means no workers
+        if (threads > 1)
+        {
+            JobSystem::Create(threads - 1);
+        }
+
+        // the report after the benchmark describes a single pass
+        MeshOptimizer::ClearStats();
+
+        auto start = std::chrono::high_resolution_clock::now();
+
+        std::vector<ObjData> objs(paths.size());
+        for (size_t i = 0; i < paths.size(); i++)
+        {
+            objs[i].path = paths[i];
+        }
+        ParseObjFiles(objs, false);
+        BuildObjFiles(objs, false);
+
+        auto meshesDone = std::chrono::high_resolution_clock::now();
+
+        std::vector<std::filesystem::path> texturePaths;
+        for (const ObjData& obj : objs)
+        {
+            for (const std::string& texture : obj.cooked.textures)
+            {
+                if (texture != "")
                 {
-                    Model* model = SceneManager::CreateModel();
-                    model->mesh = MeshManager::CreateMesh(desc);
-                    model->name = shapes[i].name;
-                    if (lastMaterialId != -1 && materials[lastMaterialId].diffuse_texname != "") 
-                    {
-                        SceneManager::SetTexture(model, diffuseTextures[lastMaterialId]);
-                    }
-                    else 
-                    {
-                        SceneManager::SetTexture(model, defaultTexture);
-                    }
-                    models.push_back(model);
-                    if (faceId < shapes[i].mesh.material_ids.size()) 
-                    {
-                        lastMaterialId = shapes[i].mesh.material_ids[faceId];
-                    }
-                    uniqueVertices.clear();
-                    desc = new MeshDescriptor;
+                    std::filesystem::path texturePath = obj.path.parent_path();
+                    texturePaths.push_back(texturePath.append(texture));
                 }
             }
         }
+        std::sort(texturePaths.begin(), texturePaths.end());
+        texturePaths.erase(std::unique(texturePaths.begin(), texturePaths.end()), texturePaths.end());
+
+        JobSystem::ParallelFor((uint32_t)texturePaths.size(), [&texturePaths](uint32_t i)
+        {
+            int width, height, channels;
+            stbi_uc* pixels = stbi_load(texturePaths[i].string().c_str(), &width, &height, &channels, STBI_rgb_alpha);
+            stbi_image_free(pixels);
+        });
+
+        auto end = std::chrono::high_resolution_clock::now();
+
+        size_t meshCount = FreeObjFiles(objs);
+
+        std::cout << "threads " << threads
+            << ": meshes " << std::chrono::duration<float, std::milli>(meshesDone - start).count() << " ms"
+            << ", images " << std::chrono::duration<float, std::milli>(end - meshesDone).count() << " ms"
+            << ", total " << std::chrono::duration<float, std::milli>(end - start).count() << " ms"
+            << " (" << meshCount << " meshes, " << texturePaths.size() << " images)" << std::endl;
+
+        if (threads > 1)
+        {
+            JobSystem::Destroy();
+        }
+    }
+
+    // cooked path, the first pass writes the caches if they are missing or stale
+    std::vector<ObjData> objs(paths.size());
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        objs[i].path = paths[i];
+    }
+    ParseObjFiles(objs, true);
+    BuildObjFiles(objs, true);
+    FreeObjFiles(objs);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        objs[i] = ObjData{};
+        objs[i].path = paths[i];
+    }
+    ParseObjFiles(objs, true);
+    auto end = std::chrono::high_resolution_clock::now();
+
+    size_t meshCount = FreeObjFiles(objs);
+    std::cout << "cooked: meshes " << std::chrono::duration<float, std::milli>(end - start).count() << " ms"
+        << " (" << meshCount << " meshes)" << std::endl;
+}
+
+void AssetManager::BenchmarkDedup(const std::vector<std::filesystem::path>& paths)
+{
+    std::vector<ObjData> objs(paths.size());
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        objs[i].path = paths[i];
+        ParseObj(objs[i], false);
+    }
+
+    // every index of every shape turned into a full vertex, the input both paths see
+    std::vector<std::vector<MeshVertex>> shapeVertices;
+    size_t vertexCount = 0;
+    for (const ObjData& obj : objs)
+    {
+        for (const tinyobj::shape_t& shape : obj.shapes)
+        {
+            std::vector<MeshVertex> vertices(shape.mesh.indices.size());
+            for (size_t i = 0; i < shape.mesh.indices.size(); i++)
+            {
+                const auto& index = shape.mesh.indices[i];
+                MeshVertex& vertex = vertices[i];
+                vertex = MeshVertex{};
+                vertex.pos = 
+                {
+                    obj.attrib.vertices[3 * index.vertex_index + 0],
+                    obj.attrib.vertices[3 * index.vertex_index + 1],
+                    obj.attrib.vertices[3 * index.vertex_index + 2]
+                };
+                vertex.texCoord = 
+                {
+                    obj.attrib.texcoords[2 * index.texcoord_index + 0],
+                    1.0f - obj.attrib.texcoords[2 * index.texcoord_index + 1]
+                };
+                vertex.color = { 1, 1, 1 };
+            }
+            vertexCount += vertices.size();
+            shapeVertices.push_back(std::move(vertices));
+        }
+    }
 
-        if (desc->vertices.size() != 0)
+    size_t mapUnique = 0;
+    auto mapStart = std::chrono::high_resolution_clock::now();
+    for (const auto& vertices : shapeVertices)
+    {
+        std::vector<MeshVertex> unique;
+        std::vector<uint32_t> indices;
+        std::unordered_map<MeshVertex, uint32_t> uniqueVertices{};
+        for (const MeshVertex& vertex : vertices)
         {
-            throw std::runtime_error("Reach shapes iteration ending without creating Model.");
+            if (uniqueVertices.count(vertex) == 0) 
+            {
+                uniqueVertices[vertex] = (uint32_t)(unique.size());
+                unique.push_back(vertex);
+            }
+            indices.push_back(uniqueVertices[vertex]);
         }
-        delete desc;
+        mapUnique += unique.size();
     }
+    auto mapEnd = std::chrono::high_resolution_clock::now();
 
-    return models;
+    size_t flatUnique = 0;
+    auto flatStart = std::chrono::high_resolution_clock::now();
+    VertexDeduplicator deduplicator;
+    for (const auto& vertices : shapeVertices)
+    {
+        std::vector<MeshVertex> unique;
+        std::vector<uint32_t> indices;
+        deduplicator.Reserve(vertices.size());
+        for (const MeshVertex& vertex : vertices)
+        {
+            indices.push_back(deduplicator.Insert(vertex, unique));
+        }
+        flatUnique += unique.size();
+    }
+    auto flatEnd = std::chrono::high_resolution_clock::now();
+
+    float mapMs = std::chrono::duration<float, std::milli>(mapEnd - mapStart).count();
+    float flatMs = std::chrono::duration<float, std::milli>(flatEnd - flatStart).count();
+    std::cout << "dedup " << vertexCount << " vertices: unordered_map " << mapMs << " ms (" << mapUnique << " unique)"
+        << ", flat table " << flatMs << " ms (" << flatUnique << " unique)"
+        << ", speedup " << mapMs / flatMs << "x" << std::endl;
 }
 
 TextureResource* AssetManager::LoadImageFile(std::filesystem::path path) 
 {
-    int texWidth, texHeight, texChannels;
-    stbi_uc* pixels = stbi_load(path.string().c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+    TextureResource* texture = TextureManager::Find(path);
+    if (texture != nullptr)
+    {
+        return texture;
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // hashed like the decode jobs do, so a file shares its texture whichever path loaded it
+    const bool hashContent = TextureManager::IsContentHashEnabled();
+
+    CookedTexture cooked;
+    if (TextureManager::IsCookedEnabled() && TextureCache::Load(path, cooked) && TextureManager::IsFormatSupported(cooked.format))
+    {
+        const uint64_t contentHash = hashContent ? cooked.pixelHash : 0;
+        texture = TextureManager::FindContent(contentHash, cooked.width, cooked.height, path);
+        if (texture != nullptr)
+        {
+            return texture;
+        }
+
+        TextureDescriptor desc{};
+        TextureManager::DescribeCooked(cooked, desc);
+        desc.path = path;
+        desc.contentHash = contentHash;
+        texture = TextureManager::CreateTexture(desc);
+        TextureManager::Acquire(texture);
+        return texture;
+    }
+
+    int texWidth, texHeight;
+    stbi_uc* pixels = DecodeImageFile(path, texWidth, texHeight);
     if (!pixels) 
     {
         std::cerr << "Failed to load image file " << path.string().c_str() << std::endl;
         return nullptr;
     }
+    auto end = std::chrono::high_resolution_clock::now();
+
+    const uint64_t contentHash = hashContent ? FileManager::Hash(pixels, (size_t)texWidth * texHeight * 4) : 0;
+    texture = TextureManager::FindContent(contentHash, texWidth, texHeight, path);
+    if (texture != nullptr)
+    {
+        FreeImage(pixels);
+        return texture;
+    }
 
     TextureDescriptor desc{};
     desc.data = pixels;
     desc.width = texWidth;
     desc.height = texHeight;
+    desc.path = path;
+    desc.contentHash = contentHash;
+    desc.decodeMs = std::chrono::duration<float, std::milli>(end - start).count();
 
-    TextureResource* texture = TextureManager::CreateTexture(desc);
-    texture->path = path;
+    texture = TextureManager::CreateTexture(desc);
+    TextureManager::Acquire(texture);
 
-    stbi_image_free(pixels);
+    FreeImage(pixels);
 
     return texture;
+}
+
+unsigned char* AssetManager::DecodeImageFile(const std::filesystem::path& path, int& width, int& height)
+{
+    int channels;
+    return stbi_load(path.string().c_str(), &width, &height, &channels, STBI_rgb_alpha);
+}
+
+void AssetManager::FreeImage(unsigned char* pixels)
+{
+    stbi_image_free(pixels);
 }
\ No newline at end of file
@@ -1,18 +1,73 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
 #include <filesystem>
 
 #include "Model.h"
 #include "MeshManager.h"
 #include "TextureManager.h"
+#include "TextureCache.h"
+#include "MipGenerator.h"
 
-class AssetManager 
+// an image being decoded on a worker thread, the models using it
+// keep the default texture until the upload is resident
+struct PendingTexture
+{
+    std::filesystem::path path;
+    // TextureManager cache key, later loads of the same file join this entry
+    std::string key;
+    std::vector<Model*> models;
+    bool hashContent = false;
+    bool useCooked = false;
+
+    // written by the decode job, either the cooked mip chain, the rgba8 chain built from
+    // the decoded pixels, or the pixels alone when the mips are blitted
+    CookedTexture cooked;
+    MipChain mips;
+    unsigned char* pixels = nullptr;
+    int width = 0;
+    int height = 0;
+    uint64_t contentHash = 0;
+    float decodeMs = 0.0f;
+    std::atomic<bool> decoded = false;
+
+    // holds one reference until the models are given the texture
+    TextureResource* texture = nullptr;
+};
+
+class AssetManager
 {
 public:
     static void Create();
     static void Destroy();
+    // main thread only, creates decoded textures and hands resident ones to their models
+    static void Update();
+    static void OnImgui();
+    // no texture is waiting to be decoded or uploaded
+    static inline bool IsIdle() { return pendingTextures.empty(); }
+
     static void Load(std::filesystem::path path);
     static std::vector<Model*> LoadObjFile(std::filesystem::path path);
+    // files are parsed and deduplicated in parallel on the JobSystem
+    static std::vector<std::vector<Model*>> LoadObjFiles(const std::vector<std::filesystem::path>& paths);
     static MeshResource* LoadObjMesh(std::filesystem::path path, std::string meshName);
+    // cached texture or a synchronous decode, the caller owns one reference
     static TextureResource* LoadImageFile(std::filesystem::path path);
+    // rgba8 pixels, released with FreeImage
+    static unsigned char* DecodeImageFile(const std::filesystem::path& path, int& width, int& height);
+    static void FreeImage(unsigned char* pixels);
+
+    // cpu side of LoadObjFiles with 1..N threads, printed to the console
+    static void BenchmarkLoad(const std::vector<std::filesystem::path>& paths, uint32_t maxThreads = 0);
+    // std::unordered_map against VertexDeduplicator on the same vertices
+    static void BenchmarkDedup(const std::vector<std::filesystem::path>& paths);
+
+private:
+    static inline std::vector<PendingTexture*> pendingTextures;
+
+    static inline float lastLoadMs = 0.0f;
+    static inline float lastStreamMs = 0.0f;
+    static inline std::chrono::high_resolution_clock::time_point streamStart;
+    static inline size_t texturesStreamed = 0;
 };
@@ -0,0 +1,646 @@
+#include "BlockCompressor.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BLOCK_COMPRESSOR_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// texels of a block split per channel, 0 to 255
+struct BlockChannels
+{
+    float values[4][16];
+};
+
+static void Gather(const uint8_t* block, BlockChannels& channels)
+{
+    for (int i = 0; i < 16; i++)
+    {
+        for (int c = 0; c < 4; c++)
+        {
+            channels.values[c][i] = (float)block[i * 4 + c];
+        }
+    }
+}
+
+// principal axis of the first count channels through their mean, the endpoints are the
+// extreme projections of the texels on it
+static void FitEndpoints(const BlockChannels& channels, int count, float e0[4], float e1[4])
+{
+    float mean[4] = {};
+    float minValue[4];
+    float maxValue[4];
+    for (int c = 0; c < count; c++)
+    {
+        minValue[c] = 255.0f;
+        maxValue[c] = 0.0f;
+        for (int i = 0; i < 16; i++)
+        {
+            float v = channels.values[c][i];
+            mean[c] += v;
+            minValue[c] = std::min(minValue[c], v);
+            maxValue[c] = std::max(maxValue[c], v);
+        }
+        mean[c] /= 16.0f;
+    }
+
+    float covariance[4][4] = {};
+    for (int i = 0; i < 16; i++)
+    {
+        for (int a = 0; a < count; a++)
+        {
+            for (int b = a; b < count; b++)
+            {
+                covariance[a][b] += (channels.values[a][i] - mean[a]) * (channels.values[b][i] - mean[b]);
+            }
+        }
+    }
+    for (int a = 0; a < count; a++)
+    {
+        for (int b = 0; b < a; b++)
+        {
+            covariance[a][b] = covariance[b][a];
+        }
+    }
+
+    // the bounding box diagonal misses anti correlated channels,
+    // a few power iterations turn it into the principal axis
+    float axis[4] = {};
+    for (int c = 0; c < count; c++)
+    {
+        axis[c] = maxValue[c] - minValue[c];
+    }
+    for (int iteration = 0; iteration < 4; iteration++)
+    {
+        float next[4] = {};
+        float length = 0.0f;
+        for (int a = 0; a < count; a++)
+        {
+            for (int b = 0; b < count; b++)
+            {
+                next[a] += covariance[a][b] * axis[b];
+            }
+            length += next[a] * next[a];
+        }
+        if (length < 1e-6f)
+        {
+            break;
+        }
+        length = std::sqrt(length);
+        for (int c = 0; c < count; c++)
+        {
+            axis[c] = next[c] / length;
+        }
+    }
+
+    float length = 0.0f;
+    for (int c = 0; c < count; c++)
+    {
+        length += axis[c] * axis[c];
+    }
+    if (length < 1e-6f)
+    {
+        // flat block
+        for (int c = 0; c < count; c++)
+        {
+            e0[c] = mean[c];
+            e1[c] = mean[c];
+        }
+        return;
+    }
+    length = std::sqrt(length);
+
+    float minT = FLT_MAX;
+    float maxT = -FLT_MAX;
+    for (int i = 0; i < 16; i++)
+    {
+        float t = 0.0f;
+        for (int c = 0; c < count; c++)
+        {
+            t += (channels.values[c][i] - mean[c]) * axis[c] / length;
+        }
+        minT = std::min(minT, t);
+        maxT = std::max(maxT, t);
+    }
+
+    for (int c = 0; c < count; c++)
+    {
+        e0[c] = std::clamp(mean[c] + minT * axis[c] / length, 0.0f, 255.0f);
+        e1[c] = std::clamp(mean[c] + maxT * axis[c] / length, 0.0f, 255.0f);
+    }
+}
+
+// position of every texel on the segment from e0 to e1, rounded to 0..maxIndex
+static void Project(const BlockChannels& channels, int count, const float e0[4], const float e1[4], int maxIndex, int32_t indices[16])
+{
+    float direction[4] = {};
+    float lengthSquared = 0.0f;
+    for (int c = 0; c < count; c++)
+    {
+        direction[c] = e1[c] - e0[c];
+        lengthSquared += direction[c] * direction[c];
+    }
+    float scale = lengthSquared > 0.0f ? (float)maxIndex / lengthSquared : 0.0f;
+
+#ifdef BLOCK_COMPRESSOR_SSE2
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 maxT = _mm_set1_ps((float)maxIndex);
+    const __m128 scaleT = _mm_set1_ps(scale);
+    for (int i = 0; i < 16; i += 4)
+    {
+        __m128 dot = zero;
+        for (int c = 0; c < count; c++)
+        {
+            __m128 offset = _mm_sub_ps(_mm_loadu_ps(&channels.values[c][i]), _mm_set1_ps(e0[c]));
+            dot = _mm_add_ps(dot, _mm_mul_ps(offset, _mm_set1_ps(direction[c])));
+        }
+        __m128 t = _mm_min_ps(_mm_max_ps(_mm_mul_ps(dot, scaleT), zero), maxT);
+        _mm_storeu_si128((__m128i*)&indices[i], _mm_cvttps_epi32(_mm_add_ps(t, half)));
+    }
+#else
+    for (int i = 0; i < 16; i++)
+    {
+        float dot = 0.0f;
+        for (int c = 0; c < count; c++)
+        {
+            dot += (channels.values[c][i] - e0[c]) * direction[c];
+        }
+        float t = std::clamp(dot * scale, 0.0f, (float)maxIndex);
+        indices[i] = (int32_t)(t + 0.5f);
+    }
+#endif
+}
+
+static uint16_t PackRGB565(const float color[4])
+{
+    int r = (int)(color[0] * 31.0f / 255.0f + 0.5f);
+    int g = (int)(color[1] * 63.0f / 255.0f + 0.5f);
+    int b = (int)(color[2] * 31.0f / 255.0f + 0.5f);
+    return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+static void UnpackRGB565(uint16_t packed, float color[4])
+{
+    int r = (packed >> 11) & 31;
+    int g = (packed >> 5) & 63;
+    int b = packed & 31;
+    color[0] = (float)((r << 3) | (r >> 2));
+    color[1] = (float)((g << 2) | (g >> 4));
+    color[2] = (float)((b << 3) | (b >> 2));
+    color[3] = 255.0f;
+}
+
+// bits are packed from the least significant bit of the first byte
+class BitWriter
+{
+public:
+    BitWriter(uint8_t* out, size_t bytes) : out(out)
+    {
+        memset(out, 0, bytes);
+    }
+
+    void Write(uint32_t value, int bits)
+    {
+        for (int i = 0; i < bits; i++, position++)
+        {
+            if ((value >> i) & 1)
+            {
+                out[position >> 3] |= (uint8_t)(1 << (position & 7));
+            }
+        }
+    }
+
+private:
+    uint8_t* out;
+    uint32_t position = 0;
+};
+
+class BitReader
+{
+public:
+    BitReader(const uint8_t* in) : in(in)
+    {
+    }
+
+    uint32_t Read(int bits)
+    {
+        uint32_t value = 0;
+        for (int i = 0; i < bits; i++, position++)
+        {
+            value |= (uint32_t)((in[position >> 3] >> (position & 7)) & 1) << i;
+        }
+        return value;
+    }
+
+private:
+    const uint8_t* in;
+    uint32_t position = 0;
+};
+
+const char* BlockCompressor::GetName(BlockFormat format)
+{
+    switch (format)
+    {
+    case BlockFormat::BC1: return "BC1";
+    case BlockFormat::BC3: return "BC3";
+    case BlockFormat::BC5: return "BC5";
+    case BlockFormat::BC7: return "BC7";
+    default: return "Unknown";
+    }
+}
+
+VkFormat BlockCompressor::GetVkFormat(BlockFormat format)
+{
+    switch (format)
+    {
+    case BlockFormat::BC1: return VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+    case BlockFormat::BC3: return VK_FORMAT_BC3_UNORM_BLOCK;
+    case BlockFormat::BC5: return VK_FORMAT_BC5_UNORM_BLOCK;
+    case BlockFormat::BC7: return VK_FORMAT_BC7_UNORM_BLOCK;
+    default: return VK_FORMAT_UNDEFINED;
+    }
+}
+
+uint32_t BlockCompressor::GetBlockBytes(BlockFormat format)
+{
+    return format == BlockFormat::BC1 ? 8 : 16;
+}
+
+size_t BlockCompressor::GetCompressedSize(BlockFormat format, uint32_t width, uint32_t height)
+{
+    size_t blocksX = (width + 3) / 4;
+    size_t blocksY = (height + 3) / 4;
+    return blocksX * blocksY * GetBlockBytes(format);
+}
+
+void BlockCompressor::Compress(BlockFormat format, const uint8_t* rgba, uint32_t width, uint32_t height, uint8_t* out)
+{
+    const uint32_t blocksX = (width + 3) / 4;
+    const uint32_t blocksY = (height + 3) / 4;
+    const uint32_t blockBytes = GetBlockBytes(format);
+
+    uint8_t block[64];
+    for (uint32_t by = 0; by < blocksY; by++)
+    {
+        for (uint32_t bx = 0; bx < blocksX; bx++)
+        {
+            for (uint32_t y = 0; y < 4; y++)
+            {
+                uint32_t sy = std::min(by * 4 + y, height - 1);
+                for (uint32_t x = 0; x < 4; x++)
+                {
+                    uint32_t sx = std::min(bx * 4 + x, width - 1);
+                    memcpy(block + (y * 4 + x) * 4, rgba + ((size_t)sy * width + sx) * 4, 4);
+                }
+            }
+
+            uint8_t* dst = out + ((size_t)by * blocksX + bx) * blockBytes;
+            switch (format)
+            {
+            case BlockFormat::BC1: EncodeBC1(block, dst); break;
+            case BlockFormat::BC3: EncodeBC3(block, dst); break;
+            case BlockFormat::BC5: EncodeBC5(block, dst); break;
+            case BlockFormat::BC7: EncodeBC7(block, dst); break;
+            }
+        }
+    }
+}
+
+void BlockCompressor::EncodeBC1(const uint8_t* block, uint8_t* out)
+{
+    BlockChannels channels;
+    Gather(block, channels);
+
+    float e0[4];
+    float e1[4];
+    FitEndpoints(channels, 3, e0, e1);
+
+    // color0 > color1 selects the four color mode, BC3 always uses it
+    uint16_t color0 = PackRGB565(e0);
+    uint16_t color1 = PackRGB565(e1);
+    if (color0 < color1)
+    {
+        std::swap(color0, color1);
+    }
+
+    uint32_t indices = 0;
+    if (color0 != color1)
+    {
+        float q0[4];
+        float q1[4];
+        UnpackRGB565(color0, q0);
+        UnpackRGB565(color1, q1);
+
+        // steps from color0 to color1 in palette order
+        static const uint32_t order[4] = { 0, 2, 3, 1 };
+        int32_t steps[16];
+        Project(channels, 3, q0, q1, 3, steps);
+        for (int i = 0; i < 16; i++)
+        {
+            indices |= order[steps[i]] << (i * 2);
+        }
+    }
+
+    out[0] = (uint8_t)(color0 & 0xFF);
+    out[1] = (uint8_t)(color0 >> 8);
+    out[2] = (uint8_t)(color1 & 0xFF);
+    out[3] = (uint8_t)(color1 >> 8);
+    for (int i = 0; i < 4; i++)
+    {
+        out[4 + i] = (uint8_t)(indices >> (i * 8));
+    }
+}
+
+void BlockCompressor::encodeChannel(const uint8_t* block, int channel, uint8_t* out)
+{
+    BlockChannels channels;
+    int minValue = 255;
+    int maxValue = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        int v = block[i * 4 + channel];
+        channels.values[0][i] = (float)v;
+        minValue = std::min(minValue, v);
+        maxValue = std::max(maxValue, v);
+    }
+
+    // value0 > value1 selects the eight value mode
+    out[0] = (uint8_t)maxValue;
+    out[1] = (uint8_t)minValue;
+
+    uint64_t indices = 0;
+    if (maxValue > minValue)
+    {
+        float e0[4] = { (float)minValue };
+        float e1[4] = { (float)maxValue };
+        int32_t steps[16];
+        Project(channels, 1, e0, e1, 7, steps);
+        for (int i = 0; i < 16; i++)
+        {
+            // index 0 is the max, 1 the min and 2 to 7 step down from the max
+            uint64_t index = steps[i] == 7 ? 0 : steps[i] == 0 ? 1 : 8 - steps[i];
+            indices |= index << (i * 3);
+        }
+    }
+
+    for (int i = 0; i < 6; i++)
+    {
+        out[2 + i] = (uint8_t)(indices >> (i * 8));
+    }
+}
+
+void BlockCompressor::EncodeBC3(const uint8_t* block, uint8_t* out)
+{
+    encodeChannel(block, 3, out);
+    EncodeBC1(block, out + 8);
+}
+
+void BlockCompressor::EncodeBC5(const uint8_t* block, uint8_t* out)
+{
+    encodeChannel(block, 0, out);
+    encodeChannel(block, 1, out + 8);
+}
+
+// 7 bits per channel plus a shared lowest bit, whichever bit is closer
+static void QuantizeBC7Endpoint(const float endpoint[4], int quantized[4], int& pBit)
+{
+    float bestError = FLT_MAX;
+    for (int p = 0; p < 2; p++)
+    {
+        int candidate[4];
+        float error = 0.0f;
+        for (int c = 0; c < 4; c++)
+        {
+            candidate[c] = std::clamp((int)((endpoint[c] - p) * 0.5f + 0.5f), 0, 127);
+            float d = (float)((candidate[c] << 1) | p) - endpoint[c];
+            error += d * d;
+        }
+        if (error < bestError)
+        {
+            bestError = error;
+            pBit = p;
+            memcpy(quantized, candidate, sizeof(candidate));
+        }
+    }
+}
+
+void BlockCompressor::EncodeBC7(const uint8_t* block, uint8_t* out)
+{
+    BlockChannels channels;
+    Gather(block, channels);
+
+    float e0[4];
+    float e1[4];
+    FitEndpoints(channels, 4, e0, e1);
+
+    int q0[4];
+    int q1[4];
+    int p0 = 0;
+    int p1 = 0;
+    QuantizeBC7Endpoint(e0, q0, p0);
+    QuantizeBC7Endpoint(e1, q1, p1);
+
+    float r0[4];
+    float r1[4];
+    for (int c = 0; c < 4; c++)
+    {
+        r0[c] = (float)((q0[c] << 1) | p0);
+        r1[c] = (float)((q1[c] << 1) | p1);
+    }
+
+    // the 4 bit weights are within half a step of i * 64 / 15, so a linear projection picks them
+    int32_t indices[16];
+    Project(channels, 4, r0, r1, 15, indices);
+
+    // the anchor texel stores 3 bits, its index has to be in the lower half
+    if (indices[0] >= 8)
+    {
+        std::swap(q0, q1);
+        std::swap(p0, p1);
+        for (int i = 0; i < 16; i++)
+        {
+            indices[i] = 15 - indices[i];
+        }
+    }
+
+    BitWriter writer(out, 16);
+    writer.Write(1 << 6, 7);
+    for (int c = 0; c < 4; c++)
+    {
+        writer.Write(q0[c], 7);
+        writer.Write(q1[c], 7);
+    }
+    writer.Write(p0, 1);
+    writer.Write(p1, 1);
+    writer.Write(indices[0], 3);
+    for (int i = 1; i < 16; i++)
+    {
+        writer.Write(indices[i], 4);
+    }
+}
+
+void BlockCompressor::Decompress(BlockFormat format, const uint8_t* blocks, uint32_t width, uint32_t height, uint8_t* rgba)
+{
+    const uint32_t blocksX = (width + 3) / 4;
+    const uint32_t blocksY = (height + 3) / 4;
+    const uint32_t blockBytes = GetBlockBytes(format);
+
+    uint8_t block[64];
+    for (uint32_t by = 0; by < blocksY; by++)
+    {
+        for (uint32_t bx = 0; bx < blocksX; bx++)
+        {
+            const uint8_t* src = blocks + ((size_t)by * blocksX + bx) * blockBytes;
+            switch (format)
+            {
+            case BlockFormat::BC1: DecodeBC1(src, block); break;
+            case BlockFormat::BC3: DecodeBC3(src, block); break;
+            case BlockFormat::BC5: DecodeBC5(src, block); break;
+            case BlockFormat::BC7: DecodeBC7(src, block); break;
+            }
+
+            // texels past the edge were padding
+            for (uint32_t y = 0; y < 4 && by * 4 + y < height; y++)
+            {
+                for (uint32_t x = 0; x < 4 && bx * 4 + x < width; x++)
+                {
+                    memcpy(rgba + ((size_t)(by * 4 + y) * width + bx * 4 + x) * 4, block + (y * 4 + x) * 4, 4);
+                }
+            }
+        }
+    }
+}
+
+void BlockCompressor::DecodeBC1(const uint8_t* in, uint8_t* block)
+{
+    const uint16_t color0 = (uint16_t)(in[0] | (in[1] << 8));
+    const uint16_t color1 = (uint16_t)(in[2] | (in[3] << 8));
+    const uint32_t indices = (uint32_t)in[4] | ((uint32_t)in[5] << 8) | ((uint32_t)in[6] << 16) | ((uint32_t)in[7] << 24);
+
+    float palette[4][4];
+    UnpackRGB565(color0, palette[0]);
+    UnpackRGB565(color1, palette[1]);
+    for (int c = 0; c < 3; c++)
+    {
+        if (color0 > color1)
+        {
+            palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+            palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+        }
+        else
+        {
+            // three colors and transparent black
+            palette[2][c] = (palette[0][c] + palette[1][c]) * 0.5f;
+            palette[3][c] = 0.0f;
+        }
+    }
+    palette[2][3] = 255.0f;
+    palette[3][3] = color0 > color1 ? 255.0f : 0.0f;
+
+    for (int i = 0; i < 16; i++)
+    {
+        const float* color = palette[(indices >> (i * 2)) & 3];
+        for (int c = 0; c < 4; c++)
+        {
+            block[i * 4 + c] = (uint8_t)(color[c] + 0.5f);
+        }
+    }
+}
+
+void BlockCompressor::decodeChannel(const uint8_t* in, int channel, uint8_t* block)
+{
+    const int value0 = in[0];
+    const int value1 = in[1];
+    uint64_t indices = 0;
+    for (int i = 0; i < 6; i++)
+    {
+        indices |= (uint64_t)in[2 + i] << (i * 8);
+    }
+
+    int values[8] = { value0, value1 };
+    for (int i = 1; i < 7; i++)
+    {
+        if (value0 > value1)
+        {
+            values[i + 1] = ((7 - i) * value0 + i * value1 + 3) / 7;
+        }
+        else if (i < 5)
+        {
+            values[i + 1] = ((5 - i) * value0 + i * value1 + 2) / 5;
+        }
+    }
+    if (value0 <= value1)
+    {
+        values[6] = 0;
+        values[7] = 255;
+    }
+
+    for (int i = 0; i < 16; i++)
+    {
+        block[i * 4 + channel] = (uint8_t)values[(indices >> (i * 3)) & 7];
+    }
+}
+
+void BlockCompressor::DecodeBC3(const uint8_t* in, uint8_t* block)
+{
+    DecodeBC1(in + 8, block);
+    decodeChannel(in, 3, block);
+}
+
+void BlockCompressor::DecodeBC5(const uint8_t* in, uint8_t* block)
+{
+    decodeChannel(in, 0, block);
+    decodeChannel(in + 8, 1, block);
+    for (int i = 0; i < 16; i++)
+    {
+        block[i * 4 + 2] = 0;
+        block[i * 4 + 3] = 255;
+    }
+}
+
+void BlockCompressor::DecodeBC7(const uint8_t* in, uint8_t* block)
+{
+    BitReader reader(in);
+    // the mode is the number of zero bits before the first one
+    if (reader.Read(7) != 1 << 6)
+    {
+        for (int i = 0; i < 16; i++)
+        {
+            block[i * 4 + 0] = 255;
+            block[i * 4 + 1] = 0;
+            block[i * 4 + 2] = 255;
+            block[i * 4 + 3] = 255;
+        }
+        return;
+    }
+
+    int endpoints[2][4];
+    for (int c = 0; c < 4; c++)
+    {
+        endpoints[0][c] = (int)reader.Read(7);
+        endpoints[1][c] = (int)reader.Read(7);
+    }
+    const int p0 = (int)reader.Read(1);
+    const int p1 = (int)reader.Read(1);
+    for (int c = 0; c < 4; c++)
+    {
+        endpoints[0][c] = (endpoints[0][c] << 1) | p0;
+        endpoints[1][c] = (endpoints[1][c] << 1) | p1;
+    }
+
+    static const int weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+    for (int i = 0; i < 16; i++)
+    {
+        const int weight = weights[reader.Read(i == 0 ? 3 : 4)];
+        for (int c = 0; c < 4; c++)
+        {
+            block[i * 4 + c] = (uint8_t)(((64 - weight) * endpoints[0][c] + weight * endpoints[1][c] + 32) >> 6);
+        }
+    }
+}
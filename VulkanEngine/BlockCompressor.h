@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <cstddef>
+#include <cstdint>
+
+enum class BlockFormat : uint32_t
+{
+    BC1,
+    BC3,
+    BC5,
+    BC7,
+};
+
+// cpu encoders for the BCn formats, every block is 4x4 texels of rgba8 input
+// endpoints are fitted along the principal axis of the block and the texels are projected
+// onto the quantized endpoints to pick their indices, four texels at a time with SSE2
+class BlockCompressor
+{
+public:
+    static const char* GetName(BlockFormat format);
+    static VkFormat GetVkFormat(BlockFormat format);
+    // 8 for BC1, 16 for the others
+    static uint32_t GetBlockBytes(BlockFormat format);
+    static size_t GetCompressedSize(BlockFormat format, uint32_t width, uint32_t height);
+
+    // rgba is width * height * 4 bytes, edge blocks repeat the last row and column
+    static void Compress(BlockFormat format, const uint8_t* rgba, uint32_t width, uint32_t height, uint8_t* out);
+
+    // block is 16 rgba texels in row order
+    static void EncodeBC1(const uint8_t* block, uint8_t* out);
+    static void EncodeBC3(const uint8_t* block, uint8_t* out);
+    // red and green only, for normal maps
+    static void EncodeBC5(const uint8_t* block, uint8_t* out);
+    // mode 6 only, one subset with rgba endpoints and 4 bit indices
+    static void EncodeBC7(const uint8_t* block, uint8_t* out);
+
+    // decoders written from the format specs, independent of the encoders above,
+    // the cooker uses them to measure what the compression lost
+    static void Decompress(BlockFormat format, const uint8_t* blocks, uint32_t width, uint32_t height, uint8_t* rgba);
+    static void DecodeBC1(const uint8_t* in, uint8_t* block);
+    static void DecodeBC3(const uint8_t* in, uint8_t* block);
+    static void DecodeBC5(const uint8_t* in, uint8_t* block);
+    // mode 6 only, the one EncodeBC7 writes, other modes decode to magenta
+    static void DecodeBC7(const uint8_t* in, uint8_t* block);
+
+private:
+    // a BC4 block from one channel, used for BC3 alpha and both BC5 channels
+    static void encodeChannel(const uint8_t* block, int channel, uint8_t* out);
+    static void decodeChannel(const uint8_t* in, int channel, uint8_t* block);
+};
@@ -1,5 +1,7 @@
 #include "BufferManager.h"
 
+#include "UploadManager.h"
+
 void BufferManager::Create(const BufferDescriptor& desc, BufferResource& resource)
 {
     auto device = LogicalDevice::GetVkDevice();
@@ -9,7 +11,7 @@ void BufferManager::Create(const BufferDescriptor& desc, BufferResource& resourc
     bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     bufferInfo.size = desc.size;
     bufferInfo.usage = desc.usage;
-    // only from the graphics queue
+    // uploads on a separate transfer family hand ownership over with barriers
     bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
     auto result = vkCreateBuffer(device, &bufferInfo, allocator, &resource.buffer);
@@ -21,54 +23,72 @@ void BufferManager::Create(const BufferDescriptor& desc, BufferResource& resourc
     VkMemoryRequirements memReq;
     vkGetBufferMemoryRequirements(device, resource.buffer, &memReq);
 
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memReq.size;
-    allocInfo.memoryTypeIndex = PhysicalDevice::FindMemoryType(memReq.memoryTypeBits, desc.properties);
+    MemoryAllocator::Allocate(memReq, desc.properties, true, resource.allocation);
 
-    result = vkAllocateMemory(device, &allocInfo, allocator, &resource.memory);
-    if (result != VK_SUCCESS)
+    vkBindBufferMemory(device, resource.buffer, resource.allocation.memory, resource.allocation.offset);
+
+    resource.mapped = nullptr;
+    if (desc.properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
     {
-        throw std::runtime_error("Failed to allocate buffer memory!");
+        resource.mapped = MemoryAllocator::Map(resource.allocation);
     }
-
-    vkBindBufferMemory(device, resource.buffer, resource.memory, 0);
 }
 
-void BufferManager::CreateStaged(const BufferDescriptor& desc, BufferResource& resource, void* data)
+uint64_t BufferManager::CreateStaged(const BufferDescriptor& desc, BufferResource& resource, const void* data)
 {
-    BufferResource staging;
     BufferManager::Create(desc, resource);
-    CreateStagingBuffer(staging, data, desc.size);
-    BufferManager::Copy(staging.buffer, resource.buffer, desc.size);
-    BufferManager::Destroy(staging);
+    // recorded into the current upload batch, no queue wait here
+    return UploadManager::UploadBuffer(resource.buffer, data, desc.size);
 }
 
 void BufferManager::Destroy(BufferResource& resource)
 {
+    if (resource.mapped != nullptr)
+    {
+        MemoryAllocator::Unmap(resource.allocation);
+        resource.mapped = nullptr;
+    }
     vkDestroyBuffer(LogicalDevice::GetVkDevice(), resource.buffer, Instance::GetAllocator());
-    vkFreeMemory(LogicalDevice::GetVkDevice(), resource.memory, Instance::GetAllocator());
+    MemoryAllocator::Free(resource.allocation);
 }
 
-void BufferManager::Copy(VkBuffer src, VkBuffer dst, VkDeviceSize size)
+uint64_t BufferManager::Copy(VkBuffer src, VkBuffer dst, VkDeviceSize size)
 {
-    auto commandBuffer = LogicalDevice::BeginSingleTimeCommands();
+    return UploadManager::CopyBuffer(src, dst, size);
+}
 
-    VkBufferCopy copyRegion{};
-    copyRegion.srcOffset = 0;
-    copyRegion.dstOffset = 0;
-    copyRegion.size = size;
-    vkCmdCopyBuffer(commandBuffer, src, dst, 1, &copyRegion);
+void BufferManager::Update(BufferResource& resource, const void* data, VkDeviceSize size, VkDeviceSize offset)
+{
+    if (resource.mapped == nullptr)
+    {
+        throw std::runtime_error("Updating a buffer that is not host visible!");
+    }
+    memcpy((char*)resource.mapped + offset, data, size);
+    MemoryAllocator::Flush(resource.allocation, &offset, &size, 1);
+}
+
+void BufferManager::UpdateRegions(BufferResource& resource, const BufferRegion* regions, uint32_t count)
+{
+    if (resource.mapped == nullptr)
+    {
+        throw std::runtime_error("Updating a buffer that is not host visible!");
+    }
 
-    LogicalDevice::EndSingleTimeCommands(commandBuffer);
+    std::vector<VkDeviceSize> offsets(count);
+    std::vector<VkDeviceSize> sizes(count);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        memcpy((char*)resource.mapped + regions[i].offset, regions[i].data, regions[i].size);
+        offsets[i] = regions[i].offset;
+        sizes[i] = regions[i].size;
+    }
+    // one flush call for every region
+    MemoryAllocator::Flush(resource.allocation, offsets.data(), sizes.data(), count);
 }
 
-void BufferManager::Update(BufferResource& resource, void* data, VkDeviceSize size)
+void BufferManager::Flush(BufferResource& resource, VkDeviceSize offset, VkDeviceSize size)
 {
-    void* dst;
-    vkMapMemory(LogicalDevice::GetVkDevice(), resource.memory, 0, size, 0, &dst);
-    memcpy(dst, data, size);
-    vkUnmapMemory(LogicalDevice::GetVkDevice(), resource.memory);
+    MemoryAllocator::Flush(resource.allocation, &offset, &size, 1);
 }
 
 void BufferManager::CreateStagingBuffer(BufferResource& resource, void* data, VkDeviceSize size)
@@ -81,20 +101,20 @@ void BufferManager::CreateStagingBuffer(BufferResource& resource, void* data, Vk
     BufferManager::Update(resource, data, size);
 }
 
-void BufferManager::CreateIndexBuffer(BufferResource& resource, void* data, VkDeviceSize size)
+uint64_t BufferManager::CreateIndexBuffer(BufferResource& resource, const void* data, VkDeviceSize size)
 {
     BufferDescriptor desc;
     desc.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
     desc.properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
     desc.size = size;
-    BufferManager::CreateStaged(desc, resource, data);
+    return BufferManager::CreateStaged(desc, resource, data);
 }
 
-void BufferManager::CreateVertexBuffer(BufferResource& resource, void* data, VkDeviceSize size)
+uint64_t BufferManager::CreateVertexBuffer(BufferResource& resource, const void* data, VkDeviceSize size)
 {
     BufferDescriptor desc;
     desc.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
     desc.properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
     desc.size = size;
-    BufferManager::CreateStaged(desc, resource, data);
+    return BufferManager::CreateStaged(desc, resource, data);
 }
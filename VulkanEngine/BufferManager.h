@@ -5,6 +5,7 @@
 #include "LogicalDevice.h"
 #include "PhysicalDevice.h"
 #include "Instance.h"
+#include "MemoryAllocator.h"
 
 struct BufferDescriptor
 {
@@ -16,21 +17,32 @@ struct BufferDescriptor
 struct BufferResource 
 {
     VkBuffer buffer;
-    VkDeviceMemory memory;
+    MemoryAllocation allocation;
+    // host visible buffers stay mapped for their whole lifetime
+    void* mapped = nullptr;
+};
+
+struct BufferRegion
+{
+    const void* data;
+    VkDeviceSize offset;
+    VkDeviceSize size;
 };
 
 class BufferManager 
 {
 public:
     static void Create(const BufferDescriptor& desc, BufferResource& resource);
-    static void CreateStaged(const BufferDescriptor& desc, BufferResource& resource, void* data);
+    static uint64_t CreateStaged(const BufferDescriptor& desc, BufferResource& resource, const void* data);
     static void Destroy(BufferResource& resource);
 
-    static void Copy(VkBuffer src, VkBuffer dst, VkDeviceSize size);
-    static void Update(BufferResource& resource, void* data, VkDeviceSize size);
+    static uint64_t Copy(VkBuffer src, VkBuffer dst, VkDeviceSize size);
+    static void Update(BufferResource& resource, const void* data, VkDeviceSize size, VkDeviceSize offset = 0);
+    static void UpdateRegions(BufferResource& resource, const BufferRegion* regions, uint32_t count);
+    static void Flush(BufferResource& resource, VkDeviceSize offset, VkDeviceSize size);
 
     static void CreateStagingBuffer(BufferResource& resource, void* data, VkDeviceSize size);
-    static void CreateIndexBuffer(BufferResource& resource, void* data, VkDeviceSize size);
-    static void CreateVertexBuffer(BufferResource& resource, void* data, VkDeviceSize size);
+    static uint64_t CreateIndexBuffer(BufferResource& resource, const void* data, VkDeviceSize size);
+    static uint64_t CreateVertexBuffer(BufferResource& resource, const void* data, VkDeviceSize size);
 };
 
@@ -125,6 +125,19 @@ void Camera::SetExtent(float width, float height)
 	updateProj();
 }
 
+void Camera::SetOrbit(const glm::vec3& center, float pitch, float yaw, float zoom)
+{
+	mode = Control::Orbit;
+	this->center = center;
+	this->zoom = zoom;
+	rotation = glm::vec3(pitch, yaw, 0.0f);
+	updateView();
+	if (type == Type::Orthographic)
+	{
+		updateProj();
+	}
+}
+
 void Camera::OnImgui()
 {
 	const auto totalSpace = ImGui::GetContentRegionAvail();
@@ -13,6 +13,8 @@ public:
     Camera();
     void Update();
     void SetExtent(float width, float height);
+    // switches to orbit control looking at center, angles in degrees
+    void SetOrbit(const glm::vec3& center, float pitch, float yaw, float zoom);
 
     void OnImgui();
 
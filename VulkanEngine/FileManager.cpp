@@ -1,5 +1,21 @@
 #include "FileManager.h"
 
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 std::vector<char> FileManager::ReadRawBytes(const std::string& filename)
 {
     std::ifstream file(filename, std::ios::ate | std::ios::binary);
@@ -18,3 +34,224 @@ std::vector<char> FileManager::ReadRawBytes(const std::string& filename)
 
     return buffer;
 }
+
+bool FileManager::WriteRawBytes(const std::string& filename, const void* data, size_t size)
+{
+    // written to a temporary first so a crash never leaves a truncated file behind
+    std::string tempName = filename + ".tmp";
+    {
+        std::ofstream file(tempName, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+        {
+            return false;
+        }
+        file.write((const char*)data, size);
+        if (!file.good())
+        {
+            return false;
+        }
+    }
+    std::remove(filename.c_str());
+    return std::rename(tempName.c_str(), filename.c_str()) == 0;
+}
+
+int64_t FileManager::GetWriteTime(const std::string& filename)
+{
+    std::error_code error;
+    auto time = std::filesystem::last_write_time(filename, error);
+    if (error)
+    {
+        return 0;
+    }
+    return (int64_t)time.time_since_epoch().count();
+}
+
+uint64_t FileManager::Hash(const void* data, size_t size)
+{
+    const unsigned char* bytes = (const unsigned char*)data;
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static uint32_t Crc32(const uint8_t* data, size_t size, uint32_t crc = 0)
+{
+    static uint32_t table[256];
+    static bool tableReady = false;
+    if (!tableReady)
+    {
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++)
+            {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            table[i] = c;
+        }
+        tableReady = true;
+    }
+
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++)
+    {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static void PushBigEndian(std::vector<uint8_t>& out, uint32_t value)
+{
+    out.push_back((uint8_t)(value >> 24));
+    out.push_back((uint8_t)(value >> 16));
+    out.push_back((uint8_t)(value >> 8));
+    out.push_back((uint8_t)value);
+}
+
+static void PushChunk(std::vector<uint8_t>& out, const char* type, const std::vector<uint8_t>& data)
+{
+    PushBigEndian(out, (uint32_t)data.size());
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    PushBigEndian(out, Crc32(out.data() + start, out.size() - start));
+}
+
+bool FileManager::WritePng(const std::string& filename, uint32_t width, uint32_t height, const uint8_t* rgba)
+{
+    std::vector<uint8_t> header;
+    PushBigEndian(header, width);
+    PushBigEndian(header, height);
+    // 8 bits per channel, rgba, deflate, adaptive filtering, not interlaced
+    header.insert(header.end(), { 8, 6, 0, 0, 0 });
+
+    // every row starts with its filter type, none here
+    const size_t rowSize = (size_t)width * 4;
+    std::vector<uint8_t> raw;
+    raw.reserve((rowSize + 1) * height);
+    for (uint32_t y = 0; y < height; y++)
+    {
+        raw.push_back(0);
+        raw.insert(raw.end(), rgba + y * rowSize, rgba + (y + 1) * rowSize);
+    }
+
+    // zlib stream made of stored deflate blocks
+    std::vector<uint8_t> compressed = { 0x78, 0x01 };
+    size_t offset = 0;
+    do
+    {
+        uint16_t blockSize = (uint16_t)std::min<size_t>(raw.size() - offset, 65535);
+        bool last = offset + blockSize == raw.size();
+        compressed.push_back(last ? 1 : 0);
+        compressed.push_back((uint8_t)blockSize);
+        compressed.push_back((uint8_t)(blockSize >> 8));
+        compressed.push_back((uint8_t)~blockSize);
+        compressed.push_back((uint8_t)(~blockSize >> 8));
+        compressed.insert(compressed.end(), raw.begin() + offset, raw.begin() + offset + blockSize);
+        offset += blockSize;
+    } while (offset < raw.size());
+
+    uint32_t a = 1;
+    uint32_t b = 0;
+    for (uint8_t byte : raw)
+    {
+        a = (a + byte) % 65521;
+        b = (b + a) % 65521;
+    }
+    PushBigEndian(compressed, (b << 16) | a);
+
+    std::vector<uint8_t> png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    PushChunk(png, "IHDR", header);
+    PushChunk(png, "IDAT", compressed);
+    PushChunk(png, "IEND", {});
+    return WriteRawBytes(filename, png.data(), png.size());
+}
+
+std::shared_ptr<MappedFile> MappedFile::Open(const std::string& filename)
+{
+    std::shared_ptr<MappedFile> mapped(new MappedFile());
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return nullptr;
+    }
+    mapped->file = file;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size))
+    {
+        return nullptr;
+    }
+    mapped->size = (size_t)size.QuadPart;
+    if (mapped->size == 0)
+    {
+        return mapped;
+    }
+
+    mapped->mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapped->mapping == nullptr)
+    {
+        return nullptr;
+    }
+    mapped->data = (const char*)MapViewOfFile(mapped->mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+    mapped->file = open(filename.c_str(), O_RDONLY);
+    if (mapped->file == -1)
+    {
+        return nullptr;
+    }
+
+    struct stat info;
+    if (fstat(mapped->file, &info) != 0)
+    {
+        return nullptr;
+    }
+    mapped->size = (size_t)info.st_size;
+    if (mapped->size == 0)
+    {
+        return mapped;
+    }
+
+    void* data = mmap(nullptr, mapped->size, PROT_READ, MAP_PRIVATE, mapped->file, 0);
+    mapped->data = data == MAP_FAILED ? nullptr : (const char*)data;
+#endif
+
+    if (mapped->data == nullptr)
+    {
+        return nullptr;
+    }
+    return mapped;
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef _WIN32
+    if (data != nullptr)
+    {
+        UnmapViewOfFile(data);
+    }
+    if (mapping != nullptr)
+    {
+        CloseHandle(mapping);
+    }
+    if (file != nullptr)
+    {
+        CloseHandle(file);
+    }
+#else
+    if (data != nullptr)
+    {
+        munmap((void*)data, size);
+    }
+    if (file != -1)
+    {
+        close(file);
+    }
+#endif
+}
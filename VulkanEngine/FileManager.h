@@ -3,10 +3,41 @@
 #include <vector>
 #include <string>
 #include <fstream>
+#include <memory>
+#include <cstdint>
+
+// read only view of a whole file mapped into memory, unmapped on destruction
+class MappedFile
+{
+public:
+	static std::shared_ptr<MappedFile> Open(const std::string& filename);
+	~MappedFile();
+
+	inline const char* GetData() const { return data; }
+	inline size_t GetSize() const { return size; }
+
+private:
+	MappedFile() = default;
+
+	const char* data = nullptr;
+	size_t size = 0;
+#ifdef _WIN32
+	void* file = nullptr;
+	void* mapping = nullptr;
+#else
+	int file = -1;
+#endif
+};
 
 class FileManager
 {
 public:
 	static std::vector<char> ReadRawBytes(const std::string& filename);
+	static bool WriteRawBytes(const std::string& filename, const void* data, size_t size);
+	// 64 bit FNV-1a, used to detect changed source files
+	static uint64_t Hash(const void* data, size_t size);
+	// last write time in clock ticks, 0 if the file is missing
+	static int64_t GetWriteTime(const std::string& filename);
+	// 8 bit rgba, uncompressed deflate so no zlib is needed, fine for screenshots
+	static bool WritePng(const std::string& filename, uint32_t width, uint32_t height, const uint8_t* rgba);
 };
-
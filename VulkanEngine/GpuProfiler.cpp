@@ -0,0 +1,309 @@
+#include "GpuProfiler.h"
+
+#include <cstring>
+#include <iostream>
+
+#include "SwapChain.h"
+#include "imgui/imgui.h"
+
+static const char* RegionStr(GpuRegion region)
+{
+    switch (region)
+    {
+    case GpuRegion::Scene: return "Scene";
+    case GpuRegion::Imgui: return "ImGui";
+    default: return "Unknown";
+    }
+}
+
+static const char* statisticNames[] =
+{
+    "Input Vertices",
+    "Input Primitives",
+    "Vertex Invocations",
+    "Clipping Invocations",
+    "Clipping Primitives",
+    "Fragment Invocations",
+};
+
+static constexpr VkQueryPipelineStatisticFlags statisticFlags =
+    VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+void GpuProfiler::Create()
+{
+    const auto& props = PhysicalDevice::GetProperties();
+    uint32_t validBits = PhysicalDevice::GetGraphicsFamilyProperties().timestampValidBits;
+
+    // software rasterizers and some mobile drivers report no valid bits
+    supported = validBits > 0 && props.limits.timestampPeriod > 0.0f;
+    statisticsSupported = PhysicalDevice::GetFeatures().pipelineStatisticsQuery == VK_TRUE;
+    timestampPeriod = props.limits.timestampPeriod;
+    timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+    if (!supported)
+    {
+        std::cout << "GPU timestamps not supported on the graphics queue" << std::endl;
+        return;
+    }
+
+    VkQueryPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    poolInfo.queryCount = UploadSlots * 2;
+    auto res = vkCreateQueryPool(LogicalDevice::GetVkDevice(), &poolInfo, Instance::GetAllocator(), &uploadPool);
+    if (res != VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to create upload query pool!");
+    }
+}
+
+void GpuProfiler::Destroy()
+{
+    destroyFrames();
+    if (uploadPool != VK_NULL_HANDLE)
+    {
+        vkDestroyQueryPool(LogicalDevice::GetVkDevice(), uploadPool, Instance::GetAllocator());
+        uploadPool = VK_NULL_HANDLE;
+    }
+    nextUploadSlot = 0;
+}
+
+void GpuProfiler::createFrames(uint32_t count)
+{
+    auto device = LogicalDevice::GetVkDevice();
+    auto allocator = Instance::GetAllocator();
+
+    frames.resize(count);
+    for (FrameQueries& queries : frames)
+    {
+        VkQueryPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        poolInfo.queryCount = (uint32_t)GpuRegion::Count * 2;
+        auto res = vkCreateQueryPool(device, &poolInfo, allocator, &queries.timestamps);
+        if (res != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create timestamp query pool!");
+        }
+
+        if (statisticsSupported)
+        {
+            poolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+            poolInfo.queryCount = 1;
+            poolInfo.pipelineStatistics = statisticFlags;
+            res = vkCreateQueryPool(device, &poolInfo, allocator, &queries.statistics);
+            if (res != VK_SUCCESS)
+            {
+                throw std::runtime_error("Failed to create pipeline statistics query pool!");
+            }
+        }
+    }
+}
+
+void GpuProfiler::destroyFrames()
+{
+    auto device = LogicalDevice::GetVkDevice();
+    auto allocator = Instance::GetAllocator();
+
+    for (FrameQueries& queries : frames)
+    {
+        vkDestroyQueryPool(device, queries.timestamps, allocator);
+        if (queries.statistics != VK_NULL_HANDLE)
+        {
+            vkDestroyQueryPool(device, queries.statistics, allocator);
+        }
+    }
+    frames.clear();
+}
+
+float GpuProfiler::toMs(uint64_t begin, uint64_t end)
+{
+    uint64_t ticks = ((end & timestampMask) - (begin & timestampMask)) & timestampMask;
+    return (float)((double)ticks * timestampPeriod / 1000000.0);
+}
+
+void GpuProfiler::BeginFrame(VkCommandBuffer commandBuffer, uint32_t frame)
+{
+    if (!supported || !enabled)
+    {
+        return;
+    }
+
+    // the frame count only changes on a swapchain recreation, after the device went idle
+    if (frames.size() != SwapChain::GetFramesInFlight())
+    {
+        destroyFrames();
+        createFrames(SwapChain::GetFramesInFlight());
+    }
+
+    auto device = LogicalDevice::GetVkDevice();
+    FrameQueries& queries = frames[frame];
+
+    // the context's fence has signaled, so unless the driver is lagging these are ready
+    for (int i = 0; i < (int)GpuRegion::Count; i++)
+    {
+        if (!queries.written[i])
+        {
+            continue;
+        }
+        uint64_t values[2];
+        auto res = vkGetQueryPoolResults(device, queries.timestamps, i * 2, 2, sizeof(values), values, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+        if (res == VK_SUCCESS)
+        {
+            float ms = toMs(values[0], values[1]);
+            regionMs[i] = regionMs[i] == 0.0f ? ms : regionMs[i] * 0.9f + ms * 0.1f;
+        }
+        queries.written[i] = false;
+    }
+    if (queries.statisticsWritten)
+    {
+        uint64_t values[StatisticsCount];
+        auto res = vkGetQueryPoolResults(device, queries.statistics, 0, 1, sizeof(values), values, sizeof(values), VK_QUERY_RESULT_64_BIT);
+        if (res == VK_SUCCESS)
+        {
+            memcpy(statistics, values, sizeof(values));
+        }
+        queries.statisticsWritten = false;
+    }
+
+    vkCmdResetQueryPool(commandBuffer, queries.timestamps, 0, (uint32_t)GpuRegion::Count * 2);
+    if (queries.statistics != VK_NULL_HANDLE)
+    {
+        vkCmdResetQueryPool(commandBuffer, queries.statistics, 0, 1);
+    }
+}
+
+void GpuProfiler::BeginRegion(VkCommandBuffer commandBuffer, uint32_t frame, GpuRegion region)
+{
+    if (!supported || !enabled || frame >= frames.size())
+    {
+        return;
+    }
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frames[frame].timestamps, (uint32_t)region * 2);
+}
+
+void GpuProfiler::EndRegion(VkCommandBuffer commandBuffer, uint32_t frame, GpuRegion region)
+{
+    if (!supported || !enabled || frame >= frames.size())
+    {
+        return;
+    }
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frames[frame].timestamps, (uint32_t)region * 2 + 1);
+    frames[frame].written[(int)region] = true;
+}
+
+void GpuProfiler::BeginStatistics(VkCommandBuffer commandBuffer, uint32_t frame)
+{
+    if (!supported || !enabled || frame >= frames.size() || frames[frame].statistics == VK_NULL_HANDLE)
+    {
+        return;
+    }
+    vkCmdBeginQuery(commandBuffer, frames[frame].statistics, 0, 0);
+}
+
+void GpuProfiler::EndStatistics(VkCommandBuffer commandBuffer, uint32_t frame)
+{
+    if (!supported || !enabled || frame >= frames.size() || frames[frame].statistics == VK_NULL_HANDLE)
+    {
+        return;
+    }
+    vkCmdEndQuery(commandBuffer, frames[frame].statistics, 0);
+    frames[frame].statisticsWritten = true;
+}
+
+uint32_t GpuProfiler::BeginUpload(VkCommandBuffer commandBuffer)
+{
+    if (!supported || !enabled)
+    {
+        return InvalidSlot;
+    }
+
+    // a slot is only reused after UploadSlots more batches, far more than are ever pending
+    uint32_t slot = nextUploadSlot;
+    nextUploadSlot = (nextUploadSlot + 1) % UploadSlots;
+
+    vkCmdResetQueryPool(commandBuffer, uploadPool, slot * 2, 2);
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, uploadPool, slot * 2);
+    return slot;
+}
+
+void GpuProfiler::EndUpload(VkCommandBuffer commandBuffer, uint32_t slot)
+{
+    if (slot == InvalidSlot || uploadPool == VK_NULL_HANDLE)
+    {
+        return;
+    }
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, uploadPool, slot * 2 + 1);
+}
+
+void GpuProfiler::ResolveUpload(uint32_t slot)
+{
+    if (slot == InvalidSlot || uploadPool == VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    uint64_t values[2];
+    auto res = vkGetQueryPoolResults(LogicalDevice::GetVkDevice(), uploadPool, slot * 2, 2, sizeof(values), values, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    if (res == VK_SUCCESS)
+    {
+        uploadMs += toMs(values[0], values[1]);
+        uploadSamples++;
+    }
+}
+
+void GpuProfiler::OnImgui()
+{
+    // appends to the cpu profiler window
+    if (ImGui::Begin("Profiler"))
+    {
+        const auto totalSpace = ImGui::GetContentRegionAvail();
+        const float totalWidth = totalSpace.x;
+
+        if (ImGui::CollapsingHeader("GPU"))
+        {
+            if (!supported)
+            {
+                ImGui::TextDisabled("Timestamps not supported on the graphics queue");
+            }
+            else
+            {
+                ImGui::Text("Enabled");
+                ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+                ImGui::PushID("gpuProfilerEnabled");
+                ImGui::Checkbox("", &enabled);
+                ImGui::PopID();
+
+                for (int i = 0; i < (int)GpuRegion::Count; i++)
+                {
+                    ImGui::Text("%s", RegionStr((GpuRegion)i));
+                    ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+                    ImGui::Text("%.3f ms", regionMs[i]);
+                }
+                ImGui::Text("Uploads");
+                ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+                ImGui::Text("%.3f ms total, %u batches", uploadMs, uploadSamples);
+
+                if (statisticsSupported)
+                {
+                    for (uint32_t i = 0; i < StatisticsCount; i++)
+                    {
+                        ImGui::Text("%s", statisticNames[i]);
+                        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+                        ImGui::Text("%llu", (unsigned long long)statistics[i]);
+                    }
+                }
+                else
+                {
+                    ImGui::TextDisabled("Pipeline statistics not supported");
+                }
+            }
+        }
+    }
+    ImGui::End();
+}
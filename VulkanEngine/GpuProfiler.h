@@ -0,0 +1,75 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+
+#include "LogicalDevice.h"
+#include "PhysicalDevice.h"
+
+enum class GpuRegion
+{
+    Scene,
+    Imgui,
+    Count,
+};
+
+// gpu timings from timestamp queries, one query pool per frame context
+// results are read when the context comes around again, so they are framesInFlight frames
+// late and never stall, devices without timestamps on the graphics queue record nothing
+class GpuProfiler
+{
+public:
+    static void Create();
+    static void Destroy();
+    static void OnImgui();
+
+    static inline bool IsSupported() { return supported; }
+
+    // reads the results the context wrote last time and resets its queries,
+    // must be recorded outside a render pass
+    static void BeginFrame(VkCommandBuffer commandBuffer, uint32_t frame);
+    static void BeginRegion(VkCommandBuffer commandBuffer, uint32_t frame, GpuRegion region);
+    static void EndRegion(VkCommandBuffer commandBuffer, uint32_t frame, GpuRegion region);
+    // pipeline statistics can't span secondary command buffers without inheritedQueries,
+    // so they are only recorded around inline draws
+    static void BeginStatistics(VkCommandBuffer commandBuffer, uint32_t frame);
+    static void EndStatistics(VkCommandBuffer commandBuffer, uint32_t frame);
+
+    // upload batches are not tied to a frame context and get slots from their own pool
+    static uint32_t BeginUpload(VkCommandBuffer commandBuffer);
+    static void EndUpload(VkCommandBuffer commandBuffer, uint32_t slot);
+    // called once the batch is known to be complete
+    static void ResolveUpload(uint32_t slot);
+
+private:
+    static constexpr uint32_t InvalidSlot = UINT32_MAX;
+    static constexpr uint32_t UploadSlots = 64;
+    static constexpr uint32_t StatisticsCount = 6;
+
+    struct FrameQueries
+    {
+        VkQueryPool timestamps = VK_NULL_HANDLE;
+        VkQueryPool statistics = VK_NULL_HANDLE;
+        bool written[(int)GpuRegion::Count] = {};
+        bool statisticsWritten = false;
+    };
+
+    static inline bool supported = false;
+    static inline bool statisticsSupported = false;
+    static inline bool enabled = true;
+    static inline float timestampPeriod = 1.0f;
+    static inline uint64_t timestampMask = ~0ull;
+
+    static inline std::vector<FrameQueries> frames;
+    static inline VkQueryPool uploadPool = VK_NULL_HANDLE;
+    static inline uint32_t nextUploadSlot = 0;
+
+    static inline float regionMs[(int)GpuRegion::Count] = {};
+    static inline float uploadMs = 0.0f;
+    static inline uint32_t uploadSamples = 0;
+    static inline uint64_t statistics[StatisticsCount] = {};
+
+    static void createFrames(uint32_t count);
+    static void destroyFrames();
+    static float toMs(uint64_t begin, uint64_t end);
+};
@@ -1,17 +1,24 @@
 #include "GraphicsPipelineManager.h"
 
+#include <chrono>
+
 void GraphicsPipelineManager::Create()
 {
 	auto device = LogicalDevice::GetVkDevice();
 	auto allocator = Instance::GetAllocator();
-	auto numFrames = SwapChain::GetNumFrames();
+	auto numFrames = SwapChain::GetFramesInFlight();
 	//uint32_t sets = static_cast<uint32_t>(numFrames);
 
-	std::array<VkDescriptorPoolSize, 2> poolSizes{};
+	std::array<VkDescriptorPoolSize, 4> poolSizes{};
 	poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 	poolSizes[0].descriptorCount = (uint32_t)(500 * numFrames);
 	poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	poolSizes[1].descriptorCount = (uint32_t)(500 * numFrames);
+	// plus one texture array per frame for the indirect path
+	poolSizes[1].descriptorCount = (uint32_t)((500 + MaxBindlessTextures) * numFrames);
+	poolSizes[2].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	poolSizes[2].descriptorCount = 16;
+	poolSizes[3].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[3].descriptorCount = (uint32_t)(4 * numFrames);
 
 	VkDescriptorPoolCreateInfo poolInfo{};
 	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
@@ -33,53 +40,16 @@ void GraphicsPipelineManager::Destroy()
 }
 
 void GraphicsPipelineManager::CreatePipeline(const GraphicsPipelineDescriptor& desc, GraphicsPipelineResource& resource)
+{
+	createLayouts(desc, resource);
+	BuildPipeline(desc, resource);
+}
+
+void GraphicsPipelineManager::createLayouts(const GraphicsPipelineDescriptor& desc, GraphicsPipelineResource& resource)
 {
 	auto device = LogicalDevice::GetVkDevice();
 	auto allocator = Instance::GetAllocator();
 
-	std::vector<ShaderResource> shaderResources(desc.shaderStages.size());
-	std::vector<VkPipelineShaderStageCreateInfo> shaderStages(desc.shaderStages.size());
-
-	for (int i = 0; i < shaderResources.size(); i++)
-	{
-		Shader::Create(desc.shaderStages[i], shaderResources[i]);
-		shaderStages[i] = shaderResources[i].stageCreateInfo;
-	}
-
-	VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
-	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	vertexInputInfo.vertexBindingDescriptionCount = 1;
-	vertexInputInfo.vertexAttributeDescriptionCount = (uint32_t)(desc.attributesDesc.size());
-	//these points to an array of structs that describe how to load the vertex data
-	vertexInputInfo.pVertexBindingDescriptions = &desc.bindingDesc;
-	vertexInputInfo.pVertexAttributeDescriptions = desc.attributesDesc.data();
-
-	//define the type of input of our pipeline
-	VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
-	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-	//with this parameter true we can break up lines and triangles in _STRIP topology modes
-	inputAssembly.primitiveRestartEnable = VK_FALSE;
-
-	VkViewport viewport{};
-	viewport.x = 0.0f;
-	viewport.y = 0.0f;
-	viewport.width = static_cast<float> (SwapChain::GetExtent().width);
-	viewport.height = static_cast<float> (SwapChain::GetExtent().height);
-	viewport.minDepth = 0.0f;
-	viewport.maxDepth = 1.0f;
-
-	VkRect2D scissor{};
-	scissor.offset = { 0, 0 };
-	scissor.extent = SwapChain::GetExtent();
-
-	VkPipelineViewportStateCreateInfo viewportState{};
-	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-	viewportState.viewportCount = 1;
-	viewportState.pViewports = &viewport;
-	viewportState.scissorCount = 1;
-	viewportState.pScissors = &scissor;
-
 	VkDescriptorSetLayoutCreateInfo descriptorLayoutInfo{};
 	descriptorLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
 	descriptorLayoutInfo.bindingCount = 1;
@@ -124,6 +94,58 @@ void GraphicsPipelineManager::CreatePipeline(const GraphicsPipelineDescriptor& d
 	{
 		throw std::runtime_error("failed to create pipeline layout!");
 	}
+}
+
+void GraphicsPipelineManager::BuildPipeline(const GraphicsPipelineDescriptor& desc, GraphicsPipelineResource& resource)
+{
+	auto device = LogicalDevice::GetVkDevice();
+	auto allocator = Instance::GetAllocator();
+
+	// only the pipeline object is replaced, the layouts and every set allocated from them stay valid
+	if (resource.pipeline != VK_NULL_HANDLE)
+	{
+		vkDestroyPipeline(device, resource.pipeline, allocator);
+		resource.pipeline = VK_NULL_HANDLE;
+	}
+
+	std::vector<ShaderResource> shaderResources(desc.shaderStages.size());
+	std::vector<VkPipelineShaderStageCreateInfo> shaderStages(desc.shaderStages.size());
+
+	for (int i = 0; i < shaderResources.size(); i++)
+	{
+		Shader::Create(desc.shaderStages[i], shaderResources[i]);
+		shaderStages[i] = shaderResources[i].stageCreateInfo;
+	}
+
+	VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	vertexInputInfo.vertexBindingDescriptionCount = 1;
+	vertexInputInfo.vertexAttributeDescriptionCount = (uint32_t)(desc.attributesDesc.size());
+	//these points to an array of structs that describe how to load the vertex data
+	vertexInputInfo.pVertexBindingDescriptions = &desc.bindingDesc;
+	vertexInputInfo.pVertexAttributeDescriptions = desc.attributesDesc.data();
+
+	//define the type of input of our pipeline
+	VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	//with this parameter true we can break up lines and triangles in _STRIP topology modes
+	inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+	// viewport and scissor are set while recording, so a resize does not invalidate the pipeline
+	VkPipelineViewportStateCreateInfo viewportState{};
+	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewportState.viewportCount = 1;
+	viewportState.pViewports = nullptr;
+	viewportState.scissorCount = 1;
+	viewportState.pScissors = nullptr;
+
+	std::array<VkDynamicState, 2> dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+
+	VkPipelineDynamicStateCreateInfo dynamicState{};
+	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicState.dynamicStateCount = (uint32_t)dynamicStates.size();
+	dynamicState.pDynamicStates = dynamicStates.data();
 
 	VkGraphicsPipelineCreateInfo pipelineInfo{};
 	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
@@ -136,7 +158,7 @@ void GraphicsPipelineManager::CreatePipeline(const GraphicsPipelineDescriptor& d
 	pipelineInfo.pMultisampleState = &desc.multisampling;
 	pipelineInfo.pDepthStencilState = &desc.depthStencil;
 	pipelineInfo.pColorBlendState = &desc.colorBlendState;
-	pipelineInfo.pDynamicState = nullptr;
+	pipelineInfo.pDynamicState = &dynamicState;
 	pipelineInfo.layout = resource.layout;
 	pipelineInfo.renderPass = SwapChain::GetRenderPass();
 	pipelineInfo.subpass = 0;
@@ -144,12 +166,36 @@ void GraphicsPipelineManager::CreatePipeline(const GraphicsPipelineDescriptor& d
 	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 	pipelineInfo.basePipelineIndex = -1;
 
-	vkRes = vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, allocator, &resource.pipeline);
+	// reports whether the pipeline came out of the cache
+	VkPipelineCreationFeedbackEXT feedback{};
+	std::vector<VkPipelineCreationFeedbackEXT> stageFeedbacks(shaderStages.size());
+	VkPipelineCreationFeedbackCreateInfoEXT feedbackInfo{};
+	feedbackInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT;
+	feedbackInfo.pPipelineCreationFeedback = &feedback;
+	feedbackInfo.pipelineStageCreationFeedbackCount = (uint32_t)stageFeedbacks.size();
+	feedbackInfo.pPipelineStageCreationFeedbacks = stageFeedbacks.data();
+	if (LogicalDevice::IsExtensionEnabled(VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME))
+	{
+		pipelineInfo.pNext = &feedbackInfo;
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+	auto vkRes = vkCreateGraphicsPipelines(device, PipelineCache::GetVkPipelineCache(), 1, &pipelineInfo, allocator, &resource.pipeline);
+	auto end = std::chrono::high_resolution_clock::now();
 	if (vkRes != VK_SUCCESS)
 	{
 		throw std::runtime_error("failed to create graphics pipeline!");
 	}
 
+	resource.buildMs = std::chrono::duration<float, std::milli>(end - start).count();
+	resource.cacheResult = PipelineCacheResult::Unknown;
+	if (feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT_EXT)
+	{
+		bool hit = feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT_EXT;
+		resource.cacheResult = hit ? PipelineCacheResult::Hit : PipelineCacheResult::Miss;
+	}
+	PipelineCache::Record(desc.name, resource.buildMs, resource.cacheResult);
+
 	for (int i = 0; i < shaderResources.size(); i++)
 	{
 		Shader::Destroy(shaderResources[i]);
@@ -165,6 +211,7 @@ void GraphicsPipelineManager::DestroyPipeline(GraphicsPipelineResource& resource
 	vkDestroyDescriptorSetLayout(LogicalDevice::GetVkDevice(), resource.sceneDescriptorSetLayout, Instance::GetAllocator());
 	vkDestroyDescriptorSetLayout(LogicalDevice::GetVkDevice(), resource.modelDescriptorSetLayout, Instance::GetAllocator());
 	vkDestroyDescriptorSetLayout(LogicalDevice::GetVkDevice(), resource.textureDescriptorSetLayout, Instance::GetAllocator());
+	resource.pipeline = VK_NULL_HANDLE;
 }
 
 void GraphicsPipelineManager::OnImgui(GraphicsPipelineDescriptor& desc, GraphicsPipelineResource& resource)
@@ -177,6 +224,14 @@ void GraphicsPipelineManager::OnImgui(GraphicsPipelineDescriptor& desc, Graphics
 	std::string name = desc.name + " Graphics Pipeline";
 	if (ImGui::CollapsingHeader(name.c_str()))
 	{
+		// last build
+		{
+			const char* cacheStr = resource.cacheResult == PipelineCacheResult::Hit ? "cache hit" :
+				resource.cacheResult == PipelineCacheResult::Miss ? "cache miss" : "cache unknown";
+			ImGui::Text("Last Build");
+			ImGui::SameLine(totalWidth * 3.0 / 5.0f);
+			ImGui::Text("%.3f ms, %s", resource.buildMs, cacheStr);
+		}
 		// polygon mode
 		{
 			if (PhysicalDevice::GetFeatures().fillModeNonSolid)
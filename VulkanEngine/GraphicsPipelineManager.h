@@ -8,6 +8,7 @@
 #include "LogicalDevice.h"
 #include "SwapChain.h"
 #include "Instance.h"
+#include "PipelineCache.h"
 #include "VulkanUtils.h"
 
 struct GraphicsPipelineDescriptor
@@ -32,14 +33,22 @@ struct GraphicsPipelineResource
     VkDescriptorSetLayout modelDescriptorSetLayout = VK_NULL_HANDLE;
     VkDescriptorSetLayout textureDescriptorSetLayout = VK_NULL_HANDLE;
     bool dirty = false;
+    // how long the last vkCreateGraphicsPipelines took and whether the cache served it
+    float buildMs = 0.0f;
+    PipelineCacheResult cacheResult = PipelineCacheResult::Unknown;
 };
 
 class GraphicsPipelineManager
 {
 public:
+    // size of the texture array of the indirect path, fixed in indirect.frag
+    static constexpr uint32_t MaxBindlessTextures = 256;
+
     static void Create();
     static void Destroy();
     static void CreatePipeline(const GraphicsPipelineDescriptor& desc, GraphicsPipelineResource& resource);
+    // replaces only the VkPipeline, for state or render pass changes
+    static void BuildPipeline(const GraphicsPipelineDescriptor& desc, GraphicsPipelineResource& resource);
     static void DestroyPipeline(GraphicsPipelineResource& resource);
     static void OnImgui(GraphicsPipelineDescriptor& desc, GraphicsPipelineResource& resource);
 
@@ -47,5 +56,7 @@ public:
 
 private:
     static inline VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+
+    static void createLayouts(const GraphicsPipelineDescriptor& desc, GraphicsPipelineResource& resource);
 };
 
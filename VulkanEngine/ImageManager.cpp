@@ -1,5 +1,7 @@
 #include "ImageManager.h"
 
+#include "UploadManager.h"
+
 void ImageManager::Create(const ImageDesc& desc, ImageResource& resource)
 {
     auto device = LogicalDevice::GetVkDevice();
@@ -34,18 +36,10 @@ void ImageManager::Create(const ImageDesc& desc, ImageResource& resource)
     VkMemoryRequirements memReq;
     vkGetImageMemoryRequirements(device, resource.image, &memReq);
 
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memReq.size;
-    allocInfo.memoryTypeIndex = PhysicalDevice::FindMemoryType(memReq.memoryTypeBits, desc.properties);
-
-    result = vkAllocateMemory(device, &allocInfo, allocator, &resource.memory);
-    if (result != VK_SUCCESS)
-    {
-        throw std::runtime_error("Failed to allocate image memory!");
-    }
+    // linear tiled images are placed with buffers
+    MemoryAllocator::Allocate(memReq, desc.properties, desc.tiling == VK_IMAGE_TILING_LINEAR, resource.allocation);
 
-    vkBindImageMemory(device, resource.image, resource.memory, 0);
+    vkBindImageMemory(device, resource.image, resource.allocation.memory, resource.allocation.offset);
 
     VkImageViewCreateInfo viewInfo{};
     viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -65,102 +59,42 @@ void ImageManager::Create(const ImageDesc& desc, ImageResource& resource)
     }
 }
 
-void ImageManager::Create(const ImageDesc& desc, ImageResource& resource, BufferResource& buffer)
+uint64_t ImageManager::Create(const ImageDesc& desc, ImageResource& resource, const void* data)
 {
-    auto device = LogicalDevice::GetVkDevice();
-    auto allocator = Instance::GetAllocator();
-
-    VkImageCreateInfo imageInfo{};
-    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-    imageInfo.imageType = VK_IMAGE_TYPE_2D;
-    imageInfo.extent.width = desc.width;
-    imageInfo.extent.height = desc.height;
-    imageInfo.extent.depth = 1;
-    imageInfo.mipLevels = desc.mipLevels;
-    imageInfo.arrayLayers = 1;
-    imageInfo.format = desc.format;
-    imageInfo.tiling = desc.tiling;
-    imageInfo.initialLayout = desc.layout;
-    imageInfo.usage = desc.usage;
-    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    imageInfo.samples = desc.numSamples;
-    imageInfo.flags = 0;
-
-    auto result = vkCreateImage(device, &imageInfo, allocator, &resource.image);
-    if (result != VK_SUCCESS)
-    {
-        throw std::runtime_error("Failed to create image!");
-    }
+    ImageManager::Create(desc, resource);
+    // level 0 is copied from the staging memory and the rest of the chain is blitted
+    return UploadManager::UploadImage(desc, resource, data, desc.size);
+}
 
-    VkMemoryRequirements memReq;
-    vkGetImageMemoryRequirements(device, resource.image, &memReq);
+uint64_t ImageManager::Create(const ImageDesc& desc, ImageResource& resource, const void* data, const std::vector<ImageLevel>& levels)
+{
+    ImageManager::Create(desc, resource);
+    return UploadManager::UploadImageLevels(desc, resource, data, desc.size, levels);
+}
 
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memReq.size;
-    allocInfo.memoryTypeIndex = PhysicalDevice::FindMemoryType(memReq.memoryTypeBits, desc.properties);
+uint64_t ImageManager::Create(const ImageDesc& desc, ImageResource& resource, const ImageResource& src, uint32_t srcFirstMip)
+{
+    ImageManager::Create(desc, resource);
+    return UploadManager::CopyImageLevels(src, srcFirstMip, desc, resource);
+}
 
-    result = vkAllocateMemory(device, &allocInfo, allocator, &resource.memory);
-    if (result != VK_SUCCESS)
+void ImageManager::RecordMipmaps(VkCommandBuffer commandBuffer, const ImageDesc& desc, ImageResource& resource)
+{
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(PhysicalDevice::GetVkPhysicalDevice(), desc.format, &formatProperties);
+    if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)) 
     {
-        throw std::runtime_error("Failed to allocate image memory!");
+        std::cerr << "texture image format does not support linear blitting!" << std::endl;
     }
 
-    vkBindImageMemory(device, resource.image, resource.memory, 0);
-
-    VkCommandBuffer commandBuffer = LogicalDevice::BeginSingleTimeCommands();
-
     VkImageMemoryBarrier barrier{};
     barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-    // if we were transferring queue family ownership
     barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
     barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
     barrier.image = resource.image;
     barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    barrier.subresourceRange.baseMipLevel = 0;
     barrier.subresourceRange.baseArrayLayer = 0;
-    barrier.subresourceRange.levelCount = desc.mipLevels;
     barrier.subresourceRange.layerCount = 1;
-
-    VkPipelineStageFlags sourceStage;
-    VkPipelineStageFlags destinationStage;
-    barrier.srcAccessMask = 0;
-    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-    sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-    destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-
-    vkCmdPipelineBarrier(commandBuffer, sourceStage, destinationStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
-    LogicalDevice::EndSingleTimeCommands(commandBuffer);
-
-    commandBuffer = LogicalDevice::BeginSingleTimeCommands();
-
-    VkBufferImageCopy region{};
-    region.bufferOffset = 0;
-    region.bufferRowLength = 0;
-    region.bufferImageHeight = 0;
-
-    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    region.imageSubresource.mipLevel = 0;
-    region.imageSubresource.baseArrayLayer = 0;
-    region.imageSubresource.layerCount = 1;
-
-    region.imageOffset = { 0, 0, 0 };
-    region.imageExtent = { desc.width, desc.height, 1 };
-
-    vkCmdCopyBufferToImage(commandBuffer, buffer.buffer, resource.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-    LogicalDevice::EndSingleTimeCommands(commandBuffer);
-
-    VkFormatProperties formatProperties;
-    vkGetPhysicalDeviceFormatProperties(PhysicalDevice::GetVkPhysicalDevice(), desc.format, &formatProperties);
-    if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)) 
-    {
-        std::cerr << "texture image format does not support linear blitting!" << std::endl;
-    }
-
-    commandBuffer = LogicalDevice::BeginSingleTimeCommands();
-
     barrier.subresourceRange.levelCount = 1;
 
     int32_t mipWidth = desc.width;
@@ -216,25 +150,6 @@ void ImageManager::Create(const ImageDesc& desc, ImageResource& resource, Buffer
     barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 
     vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
-
-    LogicalDevice::EndSingleTimeCommands(commandBuffer);
-
-    VkImageViewCreateInfo viewInfo{};
-    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-    viewInfo.image = resource.image;
-    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-    viewInfo.format = desc.format;
-    viewInfo.subresourceRange.aspectMask = desc.aspect;
-    viewInfo.subresourceRange.baseMipLevel = 0;
-    viewInfo.subresourceRange.levelCount = desc.mipLevels;
-    viewInfo.subresourceRange.baseArrayLayer = 0;
-    viewInfo.subresourceRange.layerCount = 1;
-
-    result = vkCreateImageView(device, &viewInfo, allocator, &resource.view);
-    if (result != VK_SUCCESS)
-    {
-        throw std::runtime_error("Failed to create image view!");
-    }
 }
 
 void ImageManager::Destroy(ImageResource& resource)
@@ -250,12 +165,12 @@ void ImageManager::Destroy(ImageResource& resource)
     {
         throw std::runtime_error("Null view at ImageManager::Destroy");
     }
-    if (resource.memory == VK_NULL_HANDLE)
+    if (resource.allocation.memory == VK_NULL_HANDLE)
     {
         throw std::runtime_error("Null memory at ImageManager::Destroy");
     }
 
     vkDestroyImageView(device, resource.view, allocator);
     vkDestroyImage(device, resource.image, allocator);
-    vkFreeMemory(device, resource.memory, allocator);
+    MemoryAllocator::Free(resource.allocation);
 }
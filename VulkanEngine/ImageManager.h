@@ -1,5 +1,6 @@
 #pragma once
 #include <vulkan/vulkan.h>
+#include <vector>
 
 #include "BufferManager.h"
 
@@ -7,7 +8,7 @@ struct ImageResource
 {
     VkImage image;
     VkImageView view;
-    VkDeviceMemory memory;
+    MemoryAllocation allocation;
 };
 
 struct ImageDesc 
@@ -26,10 +27,25 @@ struct ImageDesc
     uint32_t mipLevels = 1;
 };
 
+// one mip level of a prebuilt chain, offset is relative to the start of the data
+struct ImageLevel
+{
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    uint32_t width;
+    uint32_t height;
+};
+
 class ImageManager 
 {
 public:
     static void Create(const ImageDesc& desc, ImageResource& resource);
-    static void Create(const ImageDesc& desc, ImageResource& resource, BufferResource& buffer);
+    // returns the upload ticket, the image is usable by later frames right away
+    static uint64_t Create(const ImageDesc& desc, ImageResource& resource, const void* data);
+    // every level is copied as is, nothing is blitted, so block compressed formats work too
+    static uint64_t Create(const ImageDesc& desc, ImageResource& resource, const void* data, const std::vector<ImageLevel>& levels);
+    // every level is copied on the gpu from src, starting at srcFirstMip, nothing is staged
+    static uint64_t Create(const ImageDesc& desc, ImageResource& resource, const ImageResource& src, uint32_t srcFirstMip);
+    static void RecordMipmaps(VkCommandBuffer commandBuffer, const ImageDesc& desc, ImageResource& resource);
     static void Destroy(ImageResource& resource);
 };
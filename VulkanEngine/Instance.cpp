@@ -163,8 +163,11 @@ void Instance::Create()
 
 	setupDebugMessenger();
 
-	createSurface();
-	std::cout << "Created surface" << std::endl;
+	if (!Window::IsHeadless())
+	{
+		createSurface();
+		std::cout << "Created surface" << std::endl;
+	}
 
 	dirty = false;
 }
@@ -179,8 +182,12 @@ void Instance::Destroy()
 		std::cout << "Destroyed debug messenger" << std::endl;
 		debugMessenger = nullptr;
 	}
-	vkDestroySurfaceKHR(instance, surface, allocator);
-	std::cout << "Destroyed surface" << std::endl;
+	if (surface != VK_NULL_HANDLE)
+	{
+		vkDestroySurfaceKHR(instance, surface, allocator);
+		surface = VK_NULL_HANDLE;
+		std::cout << "Destroyed surface" << std::endl;
+	}
 	vkDestroyInstance(instance, allocator);
 	std::cout << "Destroyed instance" << std::endl;
 }
@@ -275,20 +282,40 @@ void Instance::OnImgui()
 
 std::vector<const char*> Instance::getRequiredExtensions()
 {
-	uint32_t glfwExtensionCount = 0;
-	const char** glfwExtensions;
-	glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+	std::vector<const char*> requiredExtensions;
 
-	std::vector<const char*> requiredExtensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+	// surface extensions only matter when there is a window to present to
+	if (!Window::IsHeadless())
+	{
+		uint32_t glfwExtensionCount = 0;
+		const char** glfwExtensions;
+		glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+		requiredExtensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+	}
 
 	if (enableValidationLayers) {
 		requiredExtensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
 		//requiredExtensions.push_back(VK_EXT_DEBUG_REPORT_EXTENSION_NAME);
 	}
 
+	// dependency of optional device extensions like timeline semaphores, only enabled when present
+	requiredExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+
 	return requiredExtensions;
 }
 
+bool Instance::IsExtensionEnabled(const char* name)
+{
+	for (auto ext : activeExtensionsNames)
+	{
+		if (strcmp(ext, name) == 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
 void Instance::setupDebugMessenger()
 {
 	if (!enableValidationLayers) return;
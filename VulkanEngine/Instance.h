@@ -24,6 +24,7 @@ public:
 	static inline bool IsValidationLayersEnabled() { return enableValidationLayers; }
 
 	static inline std::vector<const char*>& GetValidationLayers() { return activeValidationLayersNames; }
+	static bool IsExtensionEnabled(const char* name);
 
 private:
 
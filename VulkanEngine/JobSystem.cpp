@@ -0,0 +1,216 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+
+#include "imgui/imgui.h"
+
+void JobSystem::Create(uint32_t threadCount)
+{
+    if (!workers.empty())
+    {
+        throw std::runtime_error("JobSystem created twice!");
+    }
+
+    if (threadCount == 0)
+    {
+        threadCount = std::max(2u, std::thread::hardware_concurrency()) - 1;
+    }
+
+    running = true;
+    for (uint32_t i = 0; i < threadCount; i++)
+    {
+        workers.emplace_back(workerLoop, i + 1);
+    }
+}
+
+void JobSystem::Destroy()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running = false;
+    }
+    wake.notify_all();
+
+    // workers drain whatever is still queued before leaving
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+    workers.clear();
+}
+
+void JobSystem::Submit(std::function<void()> job, JobCounter* counter, JobPriority priority)
+{
+    if (counter != nullptr)
+    {
+        counter->pending++;
+    }
+
+    if (workers.empty())
+    {
+        Job inlineJob{ std::move(job), counter };
+        run(inlineJob);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs[(size_t)priority].push_back({ std::move(job), counter });
+    }
+    wake.notify_one();
+}
+
+void JobSystem::Wait(JobCounter& counter)
+{
+    while (counter.pending > 0)
+    {
+        Job job;
+        bool found;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            found = pop(&counter, job);
+        }
+        if (found)
+        {
+            run(job);
+        }
+        else
+        {
+            // the rest of the group is running on the workers
+            std::this_thread::yield();
+        }
+    }
+
+    std::exception_ptr exception;
+    {
+        std::lock_guard<std::mutex> lock(counter.exceptionMutex);
+        exception = std::exchange(counter.exception, nullptr);
+    }
+    if (exception != nullptr)
+    {
+        std::rethrow_exception(exception);
+    }
+}
+
+void JobSystem::ParallelFor(uint32_t count, const std::function<void(uint32_t)>& func, JobPriority priority)
+{
+    JobCounter counter;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        Submit([&func, i]() { func(i); }, &counter, priority);
+    }
+    Wait(counter);
+}
+
+void JobSystem::OnImgui()
+{
+    const auto totalSpace = ImGui::GetContentRegionAvail();
+    const float totalWidth = totalSpace.x;
+
+    if (ImGui::CollapsingHeader("Jobs"))
+    {
+        size_t queued[(size_t)JobPriority::Count];
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (size_t i = 0; i < (size_t)JobPriority::Count; i++)
+            {
+                queued[i] = jobs[i].size();
+            }
+        }
+
+        ImGui::Text("Worker Threads");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::Text("%u", GetThreadCount());
+        ImGui::Text("Queued Jobs");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::Text("%zu / %zu / %zu", queued[(size_t)JobPriority::High], queued[(size_t)JobPriority::Normal], queued[(size_t)JobPriority::Background]);
+    }
+}
+
+void JobSystem::workerLoop(uint32_t index)
+{
+    threadIndex = index;
+    while (true)
+    {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, []() { return hasJobs() || !running; });
+            if (!pop(nullptr, job))
+            {
+                return;
+            }
+        }
+        run(job);
+    }
+}
+
+bool JobSystem::hasJobs()
+{
+    for (const std::deque<Job>& queue : jobs)
+    {
+        if (!queue.empty())
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool JobSystem::pop(JobCounter* counter, Job& job)
+{
+    for (std::deque<Job>& queue : jobs)
+    {
+        for (auto it = queue.begin(); it != queue.end(); ++it)
+        {
+            if (counter == nullptr || it->counter == counter)
+            {
+                job = std::move(*it);
+                queue.erase(it);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void JobSystem::run(Job& job)
+{
+    // an exception leaving a worker thread would terminate the process
+    try
+    {
+        job.func();
+    }
+    catch (const std::exception& e)
+    {
+        fail(job, std::current_exception(), e.what());
+    }
+    catch (...)
+    {
+        fail(job, std::current_exception(), "unknown exception");
+    }
+
+    if (job.counter != nullptr)
+    {
+        job.counter->pending--;
+    }
+}
+
+void JobSystem::fail(Job& job, std::exception_ptr exception, const char* what)
+{
+    if (job.counter == nullptr)
+    {
+        // nobody waits on the job, so nobody can rethrow it
+        std::cerr << "Job failed: " << what << std::endl;
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(job.counter->exceptionMutex);
+    if (job.counter->exception == nullptr)
+    {
+        job.counter->exception = exception;
+    }
+}
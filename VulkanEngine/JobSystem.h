@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// counts the jobs of a group that have not finished yet
+struct JobCounter
+{
+    std::atomic<uint32_t> pending = 0;
+    // the first exception thrown by a job of the group, rethrown by Wait
+    std::exception_ptr exception;
+    std::mutex exceptionMutex;
+};
+
+// workers take the highest priority job first, frame work goes ahead of asset loads
+// and long background jobs such as decodes and streaming only run once nothing else waits
+enum class JobPriority
+{
+    High,
+    Normal,
+    Background,
+    Count
+};
+
+// fixed pool of worker threads pulling from one queue per priority
+class JobSystem
+{
+public:
+    // 0 threads picks one less than the number of hardware threads
+    static void Create(uint32_t threadCount = 0);
+    static void Destroy();
+    static void OnImgui();
+
+    static void Submit(std::function<void()> job, JobCounter* counter = nullptr, JobPriority priority = JobPriority::Normal);
+    // the waiting thread runs the queued jobs of its own counter instead of sleeping,
+    // never unrelated ones, so a frame never picks up a texture decode
+    // once every job finished the first exception any of them threw is rethrown here
+    static void Wait(JobCounter& counter);
+    static void ParallelFor(uint32_t count, const std::function<void(uint32_t)>& func, JobPriority priority = JobPriority::Normal);
+
+    static inline uint32_t GetThreadCount() { return (uint32_t)workers.size(); }
+    // 0 on the main thread, 1 to GetThreadCount() on the workers
+    // indexes per thread resources such as command pools
+    static inline uint32_t GetThreadIndex() { return threadIndex; }
+
+private:
+    struct Job
+    {
+        std::function<void()> func;
+        JobCounter* counter = nullptr;
+    };
+
+    static inline std::vector<std::thread> workers;
+    static inline std::deque<Job> jobs[(size_t)JobPriority::Count];
+    static inline std::mutex mutex;
+    static inline std::condition_variable wake;
+    static inline bool running = false;
+    static inline thread_local uint32_t threadIndex = 0;
+
+    static void workerLoop(uint32_t index);
+    static bool hasJobs();
+    // pops the first job of the counter, or of any counter when null
+    static bool pop(JobCounter* counter, Job& job);
+    static void run(Job& job);
+    // keeps the exception on the counter for Wait, or logs it when nothing waits
+    static void fail(Job& job, std::exception_ptr exception, const char* what);
+};
@@ -7,7 +7,8 @@ void LogicalDevice::Create()
 	std::set<uint32_t> uniqueFamilies =
 	{
 		PhysicalDevice::GetPresentFamily(),
-		PhysicalDevice::GetGraphicsFamily()
+		PhysicalDevice::GetGraphicsFamily(),
+		PhysicalDevice::GetTransferFamily()
 	};
 
 	// priority for each type of queue
@@ -33,6 +34,12 @@ void LogicalDevice::Create()
 	if (supportedFeatures.fillModeNonSolid) { features.fillModeNonSolid = VK_TRUE; }
 	if (supportedFeatures.wideLines) { features.wideLines = VK_TRUE; }
 	if (supportedFeatures.depthClamp) { features.depthClamp = VK_TRUE; }
+	// indirect draw path
+	if (supportedFeatures.multiDrawIndirect) { features.multiDrawIndirect = VK_TRUE; }
+	if (supportedFeatures.drawIndirectFirstInstance) { features.drawIndirectFirstInstance = VK_TRUE; }
+	if (supportedFeatures.shaderSampledImageArrayDynamicIndexing) { features.shaderSampledImageArrayDynamicIndexing = VK_TRUE; }
+	if (supportedFeatures.pipelineStatisticsQuery) { features.pipelineStatisticsQuery = VK_TRUE; }
+	if (supportedFeatures.textureCompressionBC) { features.textureCompressionBC = VK_TRUE; }
 
 	auto requiredExtensions = PhysicalDevice::GetRequiredExtensions();
 	auto allExtensions = PhysicalDevice::GetExtensions();
@@ -53,14 +60,40 @@ void LogicalDevice::Create()
 		}
 	}
 
+	enabledExtensions.assign(requiredExtensions.begin(), requiredExtensions.end());
+	for (auto opt : optionalExtensions)
+	{
+		if (strcmp(opt, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME) == 0 && !Instance::IsExtensionEnabled(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME))
+		{
+			continue;
+		}
+		for (size_t i = 0; i < allExtensions.size(); i++)
+		{
+			if (strcmp(allExtensions[i].extensionName, opt) == 0)
+			{
+				enabledExtensions.push_back(opt);
+				break;
+			}
+		}
+	}
+
 	VkDeviceCreateInfo createInfo{};
 	createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 	createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 	createInfo.pQueueCreateInfos = queueCreateInfos.data();
-	createInfo.enabledExtensionCount = static_cast<uint32_t>(requiredExtensions.size());
-	createInfo.ppEnabledExtensionNames = requiredExtensions.data();
+	createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+	createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 	createInfo.pEnabledFeatures = &features;
 
+	// the feature is mandatory for devices exposing the extension
+	VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures{};
+	timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+	timelineFeatures.timelineSemaphore = VK_TRUE;
+	if (IsExtensionEnabled(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME))
+	{
+		createInfo.pNext = &timelineFeatures;
+	}
+
 	// specify the required layers to the device 
 	if (Instance::IsValidationLayersEnabled())
 	{
@@ -79,15 +112,23 @@ void LogicalDevice::Create()
 		throw std::runtime_error("failed to create logical device!");
 	}
 
+	if (IsExtensionEnabled(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME))
+	{
+		waitSemaphores = (PFN_vkWaitSemaphoresKHR)vkGetDeviceProcAddr(device, "vkWaitSemaphoresKHR");
+		getSemaphoreCounterValue = (PFN_vkGetSemaphoreCounterValueKHR)vkGetDeviceProcAddr(device, "vkGetSemaphoreCounterValueKHR");
+	}
+
 	vkGetDeviceQueue(device, PhysicalDevice::GetGraphicsFamily(), 0, &graphicsQueue);
 	vkGetDeviceQueue(device, PhysicalDevice::GetPresentFamily(), 0, &presentQueue);
+	vkGetDeviceQueue(device, PhysicalDevice::GetTransferFamily(), 0, &transferQueue);
 
 	// command pool
 	{
 		VkCommandPoolCreateInfo poolInfo{};
 		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
 		poolInfo.queueFamilyIndex = PhysicalDevice::GetGraphicsFamily();
-		poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+		// only one time commands come from here, frames record from their own pools
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
 
 		res = vkCreateCommandPool(device, &poolInfo, Instance::GetAllocator(), &commandPool);
 		if (res != VK_SUCCESS)
@@ -106,7 +147,23 @@ void LogicalDevice::Destroy()
 	device = VK_NULL_HANDLE;
 	presentQueue = VK_NULL_HANDLE;
 	graphicsQueue = VK_NULL_HANDLE;
+	transferQueue = VK_NULL_HANDLE;
 	commandPool = VK_NULL_HANDLE;
+	enabledExtensions.clear();
+	waitSemaphores = nullptr;
+	getSemaphoreCounterValue = nullptr;
+}
+
+bool LogicalDevice::IsExtensionEnabled(const char* name)
+{
+	for (auto ext : enabledExtensions)
+	{
+		if (strcmp(ext, name) == 0)
+		{
+			return true;
+		}
+	}
+	return false;
 }
 
 void LogicalDevice::OnImgui()
@@ -115,7 +172,7 @@ void LogicalDevice::OnImgui()
 	{
 		if (ImGui::TreeNode("Active Extensions"))
 		{
-			for (auto ext : PhysicalDevice::GetRequiredExtensions())
+			for (auto ext : enabledExtensions)
 			{
 				ImGui::BulletText("%s", ext);
 			}
@@ -124,6 +181,43 @@ void LogicalDevice::OnImgui()
 	}
 }
 
+VkSemaphore LogicalDevice::CreateTimelineSemaphore()
+{
+	VkSemaphoreTypeCreateInfoKHR typeInfo{};
+	typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+	typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+	typeInfo.initialValue = 0;
+
+	VkSemaphoreCreateInfo semaphoreInfo{};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	semaphoreInfo.pNext = &typeInfo;
+
+	VkSemaphore semaphore;
+	auto res = vkCreateSemaphore(device, &semaphoreInfo, Instance::GetAllocator(), &semaphore);
+	if (res != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create timeline semaphore!");
+	}
+	return semaphore;
+}
+
+void LogicalDevice::WaitTimeline(VkSemaphore semaphore, uint64_t value)
+{
+	VkSemaphoreWaitInfoKHR waitInfo{};
+	waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+	waitInfo.semaphoreCount = 1;
+	waitInfo.pSemaphores = &semaphore;
+	waitInfo.pValues = &value;
+	waitSemaphores(device, &waitInfo, UINT64_MAX);
+}
+
+uint64_t LogicalDevice::GetTimelineValue(VkSemaphore semaphore)
+{
+	uint64_t value = 0;
+	getSemaphoreCounterValue(device, semaphore, &value);
+	return value;
+}
+
 VkCommandBuffer LogicalDevice::BeginSingleTimeCommands()
 {
 	VkCommandBufferAllocateInfo allocInfo{};
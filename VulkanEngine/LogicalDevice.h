@@ -1,6 +1,7 @@
 #pragma once
 
 #include <vulkan/vulkan.h>
+#include <vector>
 
 #include "Instance.h"
 #include "PhysicalDevice.h"
@@ -16,8 +17,17 @@ public:
     static inline VkDevice GetVkDevice() { return device; }
     static inline VkQueue GetPresentQueue() { return presentQueue; }
     static inline VkQueue GetGraphicsQueue() { return graphicsQueue; }
+    static inline VkQueue GetTransferQueue() { return transferQueue; }
     static inline bool IsDirty() { return dirty; }
     static inline VkCommandPool GetCommandPool() { return commandPool; }
+    static inline const std::vector<const char*>& GetEnabledExtensions() { return enabledExtensions; }
+    static bool IsExtensionEnabled(const char* name);
+
+    // VK_KHR_timeline_semaphore, loaded at runtime since the instance targets 1.0
+    static inline bool IsTimelineSupported() { return waitSemaphores != nullptr && getSemaphoreCounterValue != nullptr; }
+    static VkSemaphore CreateTimelineSemaphore();
+    static void WaitTimeline(VkSemaphore semaphore, uint64_t value);
+    static uint64_t GetTimelineValue(VkSemaphore semaphore);
 
     static VkCommandBuffer BeginSingleTimeCommands();
     static void EndSingleTimeCommands(VkCommandBuffer& commandBuffer);
@@ -26,8 +36,15 @@ private:
     static inline VkDevice device = VK_NULL_HANDLE;
     static inline VkQueue presentQueue = VK_NULL_HANDLE;
     static inline VkQueue graphicsQueue = VK_NULL_HANDLE;
+    static inline VkQueue transferQueue = VK_NULL_HANDLE;
     static inline bool dirty = true;
     static inline VkCommandPool commandPool = VK_NULL_HANDLE;
 
+    // enabled on top of the required ones when the device has them
+    static inline std::vector<const char*> optionalExtensions = { VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME };
+    static inline std::vector<const char*> enabledExtensions;
+
+    static inline PFN_vkWaitSemaphoresKHR waitSemaphores = nullptr;
+    static inline PFN_vkGetSemaphoreCounterValueKHR getSemaphoreCounterValue = nullptr;
 };
 
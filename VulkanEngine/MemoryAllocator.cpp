@@ -0,0 +1,324 @@
+#include "MemoryAllocator.h"
+
+#include <algorithm>
+
+#include "imgui/imgui.h"
+
+void MemoryAllocator::Create()
+{
+    if (!blocks.empty())
+    {
+        throw std::runtime_error("MemoryAllocator created twice!");
+    }
+}
+
+void MemoryAllocator::Destroy()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (MemoryBlock* block : blocks)
+    {
+        if (block->allocationCount > 0)
+        {
+            std::cerr << "MemoryAllocator destroyed with " << block->allocationCount << " live allocations!" << std::endl;
+        }
+        destroyBlock(block);
+    }
+    blocks.clear();
+}
+
+void MemoryAllocator::Allocate(const VkMemoryRequirements& memReq, VkMemoryPropertyFlags properties, bool linear, MemoryAllocation& allocation)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    uint32_t memoryType = PhysicalDevice::FindMemoryType(memReq.memoryTypeBits, properties);
+    VkDeviceSize blockSize = getBlockSize(memoryType);
+
+    MemoryBlock* block = nullptr;
+    VkDeviceSize offset = RangeAllocator::InvalidOffset;
+
+    // big resources get their own memory so they don't fragment the shared pages
+    if (memReq.size > blockSize / 2)
+    {
+        block = createBlock(memoryType, memReq.size, linear, true);
+        offset = block->ranges.Allocate(memReq.size, memReq.alignment);
+    }
+    else
+    {
+        for (MemoryBlock* candidate : blocks)
+        {
+            if (candidate->dedicated || candidate->memoryType != memoryType || candidate->linear != linear)
+            {
+                continue;
+            }
+            offset = candidate->ranges.Allocate(memReq.size, memReq.alignment);
+            if (offset != RangeAllocator::InvalidOffset)
+            {
+                block = candidate;
+                break;
+            }
+        }
+        if (block == nullptr)
+        {
+            block = createBlock(memoryType, blockSize, linear, false);
+            offset = block->ranges.Allocate(memReq.size, memReq.alignment);
+        }
+    }
+
+    if (offset == RangeAllocator::InvalidOffset)
+    {
+        throw std::runtime_error("Failed to sub-allocate memory!");
+    }
+
+    block->allocationCount++;
+
+    allocation.memory = block->memory;
+    allocation.offset = offset;
+    allocation.size = memReq.size;
+    allocation.block = block;
+}
+
+void MemoryAllocator::Free(MemoryAllocation& allocation)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    MemoryBlock* block = allocation.block;
+    if (block == nullptr)
+    {
+        throw std::runtime_error("Null block at MemoryAllocator::Free");
+    }
+
+    block->ranges.Free(allocation.offset, allocation.size);
+    block->allocationCount--;
+
+    if (block->allocationCount == 0 && !keepEmpty(block))
+    {
+        blocks.erase(std::find(blocks.begin(), blocks.end(), block));
+        destroyBlock(block);
+    }
+
+    allocation = MemoryAllocation{};
+}
+
+bool MemoryAllocator::keepEmpty(const MemoryBlock* block)
+{
+    // one empty shared block per kind is kept, so staging chunks and other short lived
+    // resources freed every frame don't allocate and free device memory every time
+    if (block->dedicated)
+    {
+        return false;
+    }
+    for (const MemoryBlock* other : blocks)
+    {
+        if (other != block && !other->dedicated && other->allocationCount == 0 &&
+            other->memoryType == block->memoryType && other->linear == block->linear)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void* MemoryAllocator::Map(const MemoryAllocation& allocation)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // a VkDeviceMemory can only be mapped once, so the whole block is mapped
+    // and shared by every allocation living in it
+    MemoryBlock* block = allocation.block;
+    if (block->mapCount == 0)
+    {
+        auto res = vkMapMemory(LogicalDevice::GetVkDevice(), block->memory, 0, VK_WHOLE_SIZE, 0, &block->mapped);
+        if (res != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to map memory block!");
+        }
+    }
+    block->mapCount++;
+
+    return (char*)block->mapped + allocation.offset;
+}
+
+void MemoryAllocator::Unmap(const MemoryAllocation& allocation)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    MemoryBlock* block = allocation.block;
+    if (block->mapCount == 0)
+    {
+        throw std::runtime_error("Unmapping a block that is not mapped!");
+    }
+    block->mapCount--;
+    if (block->mapCount == 0)
+    {
+        vkUnmapMemory(LogicalDevice::GetVkDevice(), block->memory);
+        block->mapped = nullptr;
+    }
+}
+
+void MemoryAllocator::Flush(const MemoryAllocation& allocation, const VkDeviceSize* offsets, const VkDeviceSize* sizes, uint32_t count)
+{
+    MemoryBlock* block = allocation.block;
+    if (block->coherent || count == 0)
+    {
+        return;
+    }
+
+    // flushed ranges are relative to the whole VkDeviceMemory and must be
+    // aligned to nonCoherentAtomSize
+    VkDeviceSize atom = PhysicalDevice::GetProperties().limits.nonCoherentAtomSize;
+    VkDeviceSize blockSize = block->ranges.GetSize();
+
+    std::vector<VkMappedMemoryRange> ranges(count);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        VkDeviceSize begin = allocation.offset + offsets[i];
+        VkDeviceSize end = begin + sizes[i];
+        begin = begin / atom * atom;
+        end = (end + atom - 1) / atom * atom;
+
+        ranges[i].sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+        ranges[i].memory = block->memory;
+        ranges[i].offset = begin;
+        ranges[i].size = end >= blockSize ? VK_WHOLE_SIZE : end - begin;
+    }
+
+    vkFlushMappedMemoryRanges(LogicalDevice::GetVkDevice(), count, ranges.data());
+}
+
+MemoryStats MemoryAllocator::GetStats()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    MemoryStats stats{};
+    VkDeviceSize totalFree = 0;
+    VkDeviceSize largestFree = 0;
+    for (MemoryBlock* block : blocks)
+    {
+        stats.blockCount++;
+        stats.dedicatedCount += block->dedicated ? 1 : 0;
+        stats.allocationCount += block->allocationCount;
+        stats.bytesAllocated += block->ranges.GetSize();
+        stats.bytesUsed += block->ranges.GetUsed();
+        if (!block->dedicated)
+        {
+            totalFree += block->ranges.GetFree();
+            largestFree = std::max(largestFree, block->ranges.GetLargestFree());
+        }
+    }
+    if (totalFree > 0)
+    {
+        stats.fragmentation = 1.0f - (float)largestFree / (float)totalFree;
+    }
+    return stats;
+}
+
+void MemoryAllocator::OnImgui()
+{
+    const auto totalSpace = ImGui::GetContentRegionAvail();
+    const float totalWidth = totalSpace.x;
+    const float mb = 1024.0f * 1024.0f;
+
+    if (ImGui::CollapsingHeader("Memory"))
+    {
+        MemoryStats stats = GetStats();
+
+        ImGui::Text("Blocks");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::Text("%zu (%zu dedicated)", stats.blockCount, stats.dedicatedCount);
+        ImGui::Text("Allocations");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::Text("%zu", stats.allocationCount);
+        ImGui::Text("Allocated");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::Text("%.2f MB", stats.bytesAllocated / mb);
+        ImGui::Text("Used");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::Text("%.2f MB", stats.bytesUsed / mb);
+        ImGui::Text("Fragmentation");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::Text("%.1f%%", stats.fragmentation * 100.0f);
+
+        if (ImGui::TreeNode("Blocks"))
+        {
+            ImGuiTableFlags flags = ImGuiTableFlags_RowBg;
+            flags |= ImGuiTableFlags_BordersOuter;
+            flags |= ImGuiTableFlags_BordersV;
+            if (ImGui::BeginTable("blockTable", 5, flags))
+            {
+                ImGui::TableSetupColumn("Type", ImGuiTableColumnFlags_None);
+                ImGui::TableSetupColumn("Kind", ImGuiTableColumnFlags_None);
+                ImGui::TableSetupColumn("Size (MB)", ImGuiTableColumnFlags_None);
+                ImGui::TableSetupColumn("Used (MB)", ImGuiTableColumnFlags_None);
+                ImGui::TableSetupColumn("Free Ranges", ImGuiTableColumnFlags_None);
+                ImGui::TableHeadersRow();
+
+                std::lock_guard<std::mutex> lock(mutex);
+                for (MemoryBlock* block : blocks)
+                {
+                    ImGui::TableNextRow();
+                    ImGui::TableSetColumnIndex(0);
+                    ImGui::Text("%u", block->memoryType);
+                    ImGui::TableSetColumnIndex(1);
+                    ImGui::Text("%s%s", block->linear ? "Linear" : "Optimal", block->dedicated ? " (dedicated)" : "");
+                    ImGui::TableSetColumnIndex(2);
+                    ImGui::Text("%.2f", block->ranges.GetSize() / mb);
+                    ImGui::TableSetColumnIndex(3);
+                    ImGui::Text("%.2f", block->ranges.GetUsed() / mb);
+                    ImGui::TableSetColumnIndex(4);
+                    ImGui::Text("%zu", block->ranges.GetFreeRangeCount());
+                }
+                ImGui::EndTable();
+            }
+            ImGui::TreePop();
+        }
+    }
+}
+
+MemoryBlock* MemoryAllocator::createBlock(uint32_t memoryType, VkDeviceSize size, bool linear, bool dedicated)
+{
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = size;
+    allocInfo.memoryTypeIndex = memoryType;
+
+    MemoryBlock* block = new MemoryBlock();
+    auto result = vkAllocateMemory(LogicalDevice::GetVkDevice(), &allocInfo, Instance::GetAllocator(), &block->memory);
+    if (result != VK_SUCCESS)
+    {
+        delete block;
+        throw std::runtime_error("Failed to allocate memory block!");
+    }
+
+    block->memoryType = memoryType;
+    block->coherent = PhysicalDevice::GetMemoryProperties().memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    block->linear = linear;
+    block->dedicated = dedicated;
+    block->ranges.Init(size);
+
+    blocks.push_back(block);
+    return block;
+}
+
+void MemoryAllocator::destroyBlock(MemoryBlock* block)
+{
+    if (block->mapCount > 0)
+    {
+        vkUnmapMemory(LogicalDevice::GetVkDevice(), block->memory);
+    }
+    vkFreeMemory(LogicalDevice::GetVkDevice(), block->memory, Instance::GetAllocator());
+    delete block;
+}
+
+VkDeviceSize MemoryAllocator::getBlockSize(uint32_t memoryType)
+{
+    const auto& memProperties = PhysicalDevice::GetMemoryProperties();
+    uint32_t heapIndex = memProperties.memoryTypes[memoryType].heapIndex;
+    VkDeviceSize heapSize = memProperties.memoryHeaps[heapIndex].size;
+
+    // small heaps (integrated or host visible BAR memory) get smaller pages
+    if (heapSize <= 1024ull * 1024 * 1024)
+    {
+        return std::min(preferredBlockSize, heapSize / 8);
+    }
+    return preferredBlockSize;
+}
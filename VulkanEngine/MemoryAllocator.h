@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <mutex>
+
+#include "LogicalDevice.h"
+#include "PhysicalDevice.h"
+#include "Instance.h"
+#include "RangeAllocator.h"
+
+// one VkDeviceMemory page, sub-allocated by many resources
+struct MemoryBlock
+{
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    uint32_t memoryType = 0;
+    bool coherent = true;
+    // buffers and optimal images live in separate blocks so we never
+    // have to care about bufferImageGranularity between neighbours
+    bool linear = true;
+    bool dedicated = false;
+    RangeAllocator ranges;
+    uint32_t allocationCount = 0;
+    void* mapped = nullptr;
+    uint32_t mapCount = 0;
+};
+
+struct MemoryAllocation
+{
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    MemoryBlock* block = nullptr;
+};
+
+struct MemoryStats
+{
+    size_t blockCount = 0;
+    size_t dedicatedCount = 0;
+    size_t allocationCount = 0;
+    VkDeviceSize bytesAllocated = 0;
+    VkDeviceSize bytesUsed = 0;
+    // 1 - largest free range / total free, 0 means all free space is contiguous
+    float fragmentation = 0.0f;
+};
+
+class MemoryAllocator
+{
+public:
+    static void Create();
+    static void Destroy();
+    static void OnImgui();
+
+    static void Allocate(const VkMemoryRequirements& memReq, VkMemoryPropertyFlags properties, bool linear, MemoryAllocation& allocation);
+    static void Free(MemoryAllocation& allocation);
+    static void* Map(const MemoryAllocation& allocation);
+    static void Unmap(const MemoryAllocation& allocation);
+    static void Flush(const MemoryAllocation& allocation, const VkDeviceSize* offsets, const VkDeviceSize* sizes, uint32_t count);
+
+    static MemoryStats GetStats();
+
+private:
+    static inline std::vector<MemoryBlock*> blocks;
+    static inline std::mutex mutex;
+    static inline VkDeviceSize preferredBlockSize = 64ull * 1024 * 1024;
+
+    static MemoryBlock* createBlock(uint32_t memoryType, VkDeviceSize size, bool linear, bool dedicated);
+    static void destroyBlock(MemoryBlock* block);
+    // whether an empty block stays around for the next allocation of its kind
+    static bool keepEmpty(const MemoryBlock* block);
+    static VkDeviceSize getBlockSize(uint32_t memoryType);
+};
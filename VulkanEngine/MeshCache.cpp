@@ -0,0 +1,221 @@
+#include "MeshCache.h"
+
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+std::filesystem::path MeshCache::GetCachePath(const std::filesystem::path& source)
+{
+    std::filesystem::path cachePath = source;
+    cachePath += ".mesh";
+    return cachePath;
+}
+
+bool MeshCache::Load(const std::filesystem::path& source, CookedObj& obj)
+{
+    std::shared_ptr<MappedFile> file = MappedFile::Open(GetCachePath(source).string());
+    if (file == nullptr || file->GetSize() < sizeof(Header))
+    {
+        return false;
+    }
+
+    Header header;
+    memcpy(&header, file->GetData(), sizeof(Header));
+    if (memcmp(header.magic, magic, sizeof(magic)) != 0 || header.version != version)
+    {
+        return false;
+    }
+
+    // a missing source is fine, the cooked file can ship on its own
+    std::error_code error;
+    if (std::filesystem::exists(source, error))
+    {
+        if (std::filesystem::file_size(source, error) != header.sourceSize)
+        {
+            return false;
+        }
+        // the write time changes on copies and checkouts, only then pay for hashing
+        const int64_t sourceTime = FileManager::GetWriteTime(source.string());
+        if (sourceTime != header.sourceTime)
+        {
+            std::shared_ptr<MappedFile> sourceFile = MappedFile::Open(source.string());
+            if (sourceFile == nullptr || FileManager::Hash(sourceFile->GetData(), sourceFile->GetSize()) != header.sourceHash)
+            {
+                return false;
+            }
+            sourceFile.reset();
+
+            // same content, store the new time so the next load skips the hash again
+            // the mapping is closed first, it does not share write access
+            file.reset();
+            refreshSourceTime(source, sourceTime);
+            file = MappedFile::Open(GetCachePath(source).string());
+            if (file == nullptr || file->GetSize() < sizeof(Header))
+            {
+                return false;
+            }
+        }
+    }
+
+    const char* data = file->GetData();
+    const size_t size = file->GetSize();
+
+    size_t cursor = sizeof(Header);
+    auto read = [&](void* dst, size_t bytes)
+    {
+        if (cursor + bytes > size)
+        {
+            return false;
+        }
+        memcpy(dst, data + cursor, bytes);
+        cursor += bytes;
+        return true;
+    };
+
+    CookedObj cooked;
+    cooked.flags = header.flags;
+    cooked.textures.resize(header.materialCount);
+    for (uint32_t i = 0; i < header.materialCount; i++)
+    {
+        uint32_t length;
+        if (!read(&length, sizeof(length)) || cursor + length > size)
+        {
+            return false;
+        }
+        cooked.textures[i].assign(data + cursor, length);
+        cursor += length;
+    }
+
+    cooked.meshes.resize(header.meshCount);
+    for (uint32_t i = 0; i < header.meshCount; i++)
+    {
+        MeshEntry entry;
+        if (!read(&entry, sizeof(entry)) || cursor + entry.nameLength > size)
+        {
+            return false;
+        }
+        if (entry.vertexOffset + (uint64_t)entry.vertexCount * sizeof(MeshVertex) > size ||
+            entry.indexOffset + (uint64_t)entry.indexCount * sizeof(uint32_t) > size)
+        {
+            return false;
+        }
+
+        CookedMesh& mesh = cooked.meshes[i];
+        mesh.name.assign(data + cursor, entry.nameLength);
+        cursor += entry.nameLength;
+        mesh.materialId = entry.materialId;
+
+        mesh.desc = new MeshDescriptor();
+        mesh.desc->source = file;
+        mesh.desc->sourceVertices = (const MeshVertex*)(data + entry.vertexOffset);
+        mesh.desc->sourceIndices = (const uint32_t*)(data + entry.indexOffset);
+        mesh.desc->sourceVertexCount = entry.vertexCount;
+        mesh.desc->sourceIndexCount = entry.indexCount;
+
+        mesh.stats.name = mesh.name;
+        mesh.stats.triangles = entry.indexCount / 3;
+        mesh.stats.vertices = entry.vertexCount;
+        mesh.stats.acmrBefore = entry.acmrBefore;
+        mesh.stats.acmrAfter = entry.acmrAfter;
+        mesh.stats.atvrBefore = entry.atvrBefore;
+        mesh.stats.atvrAfter = entry.atvrAfter;
+    }
+
+    obj = std::move(cooked);
+    return true;
+}
+
+void MeshCache::refreshSourceTime(const std::filesystem::path& source, int64_t sourceTime)
+{
+    // patched in place, the rest of the cache is unchanged
+    std::fstream file(GetCachePath(source), std::ios::binary | std::ios::in | std::ios::out);
+    if (!file.is_open())
+    {
+        return;
+    }
+    file.seekp(offsetof(Header, sourceTime));
+    file.write((const char*)&sourceTime, sizeof(sourceTime));
+}
+
+bool MeshCache::Save(const std::filesystem::path& source, const CookedObj& obj)
+{
+    std::shared_ptr<MappedFile> sourceFile = MappedFile::Open(source.string());
+    if (sourceFile == nullptr)
+    {
+        return false;
+    }
+
+    Header header{};
+    memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    header.sourceSize = sourceFile->GetSize();
+    header.sourceTime = FileManager::GetWriteTime(source.string());
+    header.sourceHash = FileManager::Hash(sourceFile->GetData(), sourceFile->GetSize());
+    header.flags = obj.flags;
+    header.materialCount = (uint32_t)obj.textures.size();
+    header.meshCount = (uint32_t)obj.meshes.size();
+
+    std::vector<char> out;
+    auto write = [&out](const void* src, size_t bytes)
+    {
+        out.insert(out.end(), (const char*)src, (const char*)src + bytes);
+    };
+    auto align = [&out]()
+    {
+        out.resize((out.size() + 15) / 16 * 16, 0);
+    };
+
+    write(&header, sizeof(header));
+    for (const std::string& texture : obj.textures)
+    {
+        uint32_t length = (uint32_t)texture.size();
+        write(&length, sizeof(length));
+        write(texture.data(), length);
+    }
+
+    // the table is written with placeholder offsets and patched once the blobs are placed
+    std::vector<size_t> entryPositions(obj.meshes.size());
+    for (size_t i = 0; i < obj.meshes.size(); i++)
+    {
+        const CookedMesh& mesh = obj.meshes[i];
+
+        MeshEntry entry{};
+        entry.materialId = mesh.materialId;
+        entry.nameLength = (uint32_t)mesh.name.size();
+        entry.vertexCount = (uint32_t)mesh.desc->GetVertexCount();
+        entry.indexCount = (uint32_t)mesh.desc->GetIndexCount();
+        entry.acmrBefore = mesh.stats.acmrBefore;
+        entry.acmrAfter = mesh.stats.acmrAfter;
+        entry.atvrBefore = mesh.stats.atvrBefore;
+        entry.atvrAfter = mesh.stats.atvrAfter;
+
+        entryPositions[i] = out.size();
+        write(&entry, sizeof(entry));
+        write(mesh.name.data(), mesh.name.size());
+    }
+
+    for (size_t i = 0; i < obj.meshes.size(); i++)
+    {
+        const MeshDescriptor* desc = obj.meshes[i].desc;
+
+        MeshEntry entry;
+        memcpy(&entry, out.data() + entryPositions[i], sizeof(entry));
+
+        align();
+        entry.vertexOffset = out.size();
+        write(desc->GetVertices(), desc->GetVertexCount() * sizeof(MeshVertex));
+        align();
+        entry.indexOffset = out.size();
+        write(desc->GetIndices(), desc->GetIndexCount() * sizeof(uint32_t));
+
+        memcpy(out.data() + entryPositions[i], &entry, sizeof(entry));
+    }
+
+    if (!FileManager::WriteRawBytes(GetCachePath(source).string(), out.data(), out.size()))
+    {
+        std::cerr << "Failed to write mesh cache for " << source.string() << std::endl;
+        return false;
+    }
+    return true;
+}
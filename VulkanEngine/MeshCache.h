@@ -0,0 +1,81 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "FileManager.h"
+#include "MeshManager.h"
+#include "MeshOptimizer.h"
+
+// one material range of a source file, ready for MeshManager::CreateMesh
+struct CookedMesh
+{
+    std::string name;
+    int materialId = -1;
+    MeshDescriptor* desc = nullptr;
+    // measured when the mesh was built, cached so a load from the cache reports it too
+    MeshOptimizerStats stats;
+};
+
+enum CookFlags : uint32_t
+{
+    CookOptimized = 1 << 0,
+};
+
+struct CookedObj
+{
+    // CookFlags the meshes were built with
+    uint32_t flags = 0;
+    // diffuse texture of each material, relative to the source file, empty if none
+    std::vector<std::string> textures;
+    std::vector<CookedMesh> meshes;
+};
+
+// binary cache written next to a source mesh as "<source>.mesh"
+// layout: header, material table, mesh table, then 16 byte aligned vertex and index blobs
+// the cache is keyed on the size, write time and hash of the source file
+class MeshCache
+{
+public:
+    static std::filesystem::path GetCachePath(const std::filesystem::path& source);
+
+    // false when there is no cache or the source changed since it was cooked
+    // cooked descriptors reference the mapped file instead of copying it
+    static bool Load(const std::filesystem::path& source, CookedObj& obj);
+    static bool Save(const std::filesystem::path& source, const CookedObj& obj);
+
+private:
+    static constexpr char magic[4] = { 'V', 'E', 'M', 'C' };
+    // 3 keeps the optimizer stats of every mesh
+    static constexpr uint32_t version = 3;
+
+    struct Header
+    {
+        char magic[4];
+        uint32_t version;
+        uint64_t sourceSize;
+        int64_t sourceTime;
+        uint64_t sourceHash;
+        uint32_t flags;
+        uint32_t materialCount;
+        uint32_t meshCount;
+    };
+
+    struct MeshEntry
+    {
+        int32_t materialId;
+        uint32_t nameLength;
+        uint32_t vertexCount;
+        uint32_t indexCount;
+        float acmrBefore;
+        float acmrAfter;
+        float atvrBefore;
+        float atvrAfter;
+        uint64_t vertexOffset;
+        uint64_t indexOffset;
+    };
+
+    // rewrites the write time in the header of a cache whose source only got touched
+    static void refreshSourceTime(const std::filesystem::path& source, int64_t sourceTime);
+};
@@ -1,14 +1,39 @@
 #include "MeshManager.h"
 
+#include <algorithm>
+#include <cmath>
+
 #include <tiny_obj_loader.h>
 
+#include "SwapChain.h"
+#include "UploadManager.h"
+#include "imgui/imgui.h"
+
+// transfer src so a full buffer can be copied into its replacement when growing
+static constexpr VkBufferUsageFlags vertexUsage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+static constexpr VkBufferUsageFlags indexUsage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
 void MeshManager::Create()
 {
     if (meshes.size() != descs.size())
     {
         throw std::runtime_error("Number of mesh descs is different than number of meshes!");
     }
-    for (int i = 0; i < meshes.size(); i++) 
+
+    // size the shared buffers for everything that is already loaded
+    VkDeviceSize vertexTotal = 0;
+    VkDeviceSize indexTotal = 0;
+    for (MeshDescriptor* desc : descs)
+    {
+        vertexTotal += desc->GetVertexCount();
+        indexTotal += desc->GetIndexCount();
+    }
+    vertexRanges.Init(std::max<VkDeviceSize>(minVertexCapacity, vertexTotal));
+    indexRanges.Init(std::max<VkDeviceSize>(minIndexCapacity, indexTotal));
+    createBuffer(vertexBuffer, vertexRanges.GetSize() * sizeof(MeshVertex), vertexUsage);
+    createBuffer(indexBuffer, indexRanges.GetSize() * sizeof(uint32_t), indexUsage);
+
+    for (int i = 0; i < meshes.size(); i++)
     {
         SetupMesh(descs[i], meshes[i]);
     }
@@ -16,38 +41,258 @@ void MeshManager::Create()
 
 void MeshManager::Destroy()
 {
-    for (MeshResource* mesh : meshes)
+    // the device is idle here, nothing is waiting on the deferred releases
+    for (RetiredMeshBuffer& retired : retiredBuffers)
+    {
+        BufferManager::Destroy(retired.buffer);
+    }
+    retiredBuffers.clear();
+    pendingFrees.clear();
+
+    if (vertexBuffer.buffer != VK_NULL_HANDLE)
+    {
+        BufferManager::Destroy(vertexBuffer);
+        vertexBuffer.buffer = VK_NULL_HANDLE;
+    }
+    if (indexBuffer.buffer != VK_NULL_HANDLE)
     {
-        BufferManager::Destroy(mesh->vertexBuffer);
-        BufferManager::Destroy(mesh->indexBuffer);
+        BufferManager::Destroy(indexBuffer);
+        indexBuffer.buffer = VK_NULL_HANDLE;
     }
+    vertexRanges.Init(0);
+    indexRanges.Init(0);
 }
 
 void MeshManager::Finish()
 {
-    for (MeshDescriptor* desc : descs) 
+    for (MeshDescriptor* desc : descs)
     {
         delete desc;
     }
-    for (MeshResource* mesh : meshes) 
+    for (MeshResource* mesh : meshes)
     {
         delete mesh;
     }
+    descs.clear();
     meshes.clear();
 }
 
+void MeshManager::Update()
+{
+    frame++;
+
+    // every frame recorded before the release has had its fence waited on by then
+    const uint64_t safeFrames = SwapChain::GetFramesInFlight() + 1;
+
+    for (size_t i = 0; i < retiredBuffers.size();)
+    {
+        RetiredMeshBuffer& retired = retiredBuffers[i];
+        if (frame >= retired.frame + safeFrames && UploadManager::IsComplete(retired.ticket))
+        {
+            BufferManager::Destroy(retired.buffer);
+            retiredBuffers.erase(retiredBuffers.begin() + i);
+        }
+        else
+        {
+            i++;
+        }
+    }
+
+    for (size_t i = 0; i < pendingFrees.size();)
+    {
+        PendingMeshFree& pending = pendingFrees[i];
+        if (frame >= pending.frame + safeFrames)
+        {
+            vertexRanges.Free((VkDeviceSize)pending.vertexOffset, pending.vertexCount);
+            indexRanges.Free(pending.firstIndex, pending.indexCount);
+            pendingFrees.erase(pendingFrees.begin() + i);
+        }
+        else
+        {
+            i++;
+        }
+    }
+}
+
+void MeshManager::OnImgui()
+{
+    const auto totalSpace = ImGui::GetContentRegionAvail();
+    const float totalWidth = totalSpace.x;
+
+    if (ImGui::CollapsingHeader("Meshes"))
+    {
+        ImGui::Text("Meshes");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::Text("%zu", meshes.size());
+        ImGui::Text("Vertices");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::Text("%llu / %llu", (unsigned long long)vertexRanges.GetUsed(), (unsigned long long)vertexRanges.GetSize());
+        ImGui::Text("Indices");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::Text("%llu / %llu", (unsigned long long)indexRanges.GetUsed(), (unsigned long long)indexRanges.GetSize());
+        ImGui::Text("Free Ranges");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::Text("%zu vertex, %zu index", vertexRanges.GetFreeRangeCount(), indexRanges.GetFreeRangeCount());
+        ImGui::Text("Buffer Size");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::Text("%.2f MB", (vertexRanges.GetSize() * sizeof(MeshVertex) + indexRanges.GetSize() * sizeof(uint32_t)) / (1024.0f * 1024.0f));
+        ImGui::Text("Grows");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::Text("%u", growCount);
+        ImGui::Text("Pending Releases");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::Text("%zu", pendingFrees.size() + retiredBuffers.size());
+    }
+}
+
 MeshResource* MeshManager::CreateMesh(MeshDescriptor* desc)
 {
     MeshResource* mesh = new MeshResource();
+    computeBounds(desc, mesh);
     MeshManager::SetupMesh(desc, mesh);
     meshes.push_back(mesh);
     descs.push_back(desc);
     return mesh;
 }
 
+void MeshManager::DestroyMesh(MeshResource* mesh)
+{
+    auto it = std::find(meshes.begin(), meshes.end(), mesh);
+    if (it == meshes.end())
+    {
+        throw std::runtime_error("Destroying a mesh not owned by MeshManager!");
+    }
+
+    size_t index = it - meshes.begin();
+    delete descs[index];
+    descs.erase(descs.begin() + index);
+    meshes.erase(it);
+
+    // frames in flight may still draw from the range
+    pendingFrees.push_back({ mesh->firstIndex, mesh->indexCount, mesh->vertexOffset, mesh->vertexCount, frame });
+    delete mesh;
+}
+
+void MeshManager::computeBounds(const MeshDescriptor* desc, MeshResource* resource)
+{
+    const MeshVertex* vertices = desc->GetVertices();
+    const uint32_t* indices = desc->GetIndices();
+    const size_t vertexCount = desc->GetVertexCount();
+    const size_t indexCount = desc->GetIndexCount();
+    if (vertexCount == 0)
+    {
+        return;
+    }
+
+    glm::vec3 minimum = vertices[0].pos;
+    glm::vec3 maximum = vertices[0].pos;
+    for (size_t i = 1; i < vertexCount; i++)
+    {
+        minimum = glm::min(minimum, vertices[i].pos);
+        maximum = glm::max(maximum, vertices[i].pos);
+    }
+    resource->center = (minimum + maximum) * 0.5f;
+    resource->radius = glm::length(maximum - minimum) * 0.5f;
+
+    // the ratio of the uv and the surface areas, tiled textures get a higher density
+    double surfaceArea = 0.0;
+    double uvArea = 0.0;
+    for (size_t i = 0; i + 2 < indexCount; i += 3)
+    {
+        const MeshVertex& a = vertices[indices[i + 0]];
+        const MeshVertex& b = vertices[indices[i + 1]];
+        const MeshVertex& c = vertices[indices[i + 2]];
+        surfaceArea += glm::length(glm::cross(b.pos - a.pos, c.pos - a.pos)) * 0.5;
+        glm::vec2 ab = b.texCoord - a.texCoord;
+        glm::vec2 ac = c.texCoord - a.texCoord;
+        uvArea += std::abs(ab.x * ac.y - ab.y * ac.x) * 0.5;
+    }
+    if (surfaceArea > 0.0 && uvArea > 0.0)
+    {
+        resource->uvDensity = (float)std::sqrt(uvArea / surfaceArea);
+    }
+    else if (resource->radius > 0.0f)
+    {
+        // no usable uvs, assume the texture covers the mesh once
+        resource->uvDensity = 0.5f / resource->radius;
+    }
+}
+
+void MeshManager::Bind(VkCommandBuffer commandBuffer)
+{
+    VkBuffer vertexBuffers[] = { vertexBuffer.buffer };
+    VkDeviceSize offsets[] = { 0 };
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+    vkCmdBindIndexBuffer(commandBuffer, indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+}
+
 void MeshManager::SetupMesh(MeshDescriptor* desc, MeshResource* resource)
 {
-    resource->indexCount = desc->indices.size();
-    BufferManager::CreateVertexBuffer(resource->vertexBuffer, desc->vertices.data(), sizeof(desc->vertices[0]) * desc->vertices.size());
-    BufferManager::CreateIndexBuffer(resource->indexBuffer, desc->indices.data(), sizeof(desc->indices[0]) * desc->indices.size());
+    resource->vertexCount = (uint32_t)desc->GetVertexCount();
+    resource->indexCount = (uint32_t)desc->GetIndexCount();
+
+    VkDeviceSize vertexOffset = allocate(vertexBuffer, vertexRanges, sizeof(MeshVertex), vertexUsage, resource->vertexCount);
+    VkDeviceSize firstIndex = allocate(indexBuffer, indexRanges, sizeof(uint32_t), indexUsage, resource->indexCount);
+    resource->vertexOffset = (int32_t)vertexOffset;
+    resource->firstIndex = (uint32_t)firstIndex;
+
+    if (resource->vertexCount > 0)
+    {
+        UploadManager::UploadBuffer(vertexBuffer.buffer, desc->GetVertices(), sizeof(MeshVertex) * resource->vertexCount, vertexOffset * sizeof(MeshVertex));
+    }
+    if (resource->indexCount > 0)
+    {
+        UploadManager::UploadBuffer(indexBuffer.buffer, desc->GetIndices(), sizeof(uint32_t) * resource->indexCount, firstIndex * sizeof(uint32_t));
+    }
+}
+
+void MeshManager::createBuffer(BufferResource& resource, VkDeviceSize size, VkBufferUsageFlags usage)
+{
+    BufferDescriptor desc{};
+    desc.size = size;
+    desc.usage = usage;
+    desc.properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    BufferManager::Create(desc, resource);
+}
+
+void MeshManager::grow(BufferResource& resource, RangeAllocator& ranges, VkDeviceSize elementSize, VkBufferUsageFlags usage, VkDeviceSize required)
+{
+    // doubling keeps the number of copies logarithmic, the new tail always fits the request
+    VkDeviceSize oldCount = ranges.GetSize();
+    VkDeviceSize newCount = std::max(oldCount * 2, oldCount + required);
+
+    BufferResource larger{};
+    createBuffer(larger, newCount * elementSize, usage);
+
+    if (resource.buffer != VK_NULL_HANDLE)
+    {
+        uint64_t ticket = UploadManager::CopyBuffer(resource.buffer, larger.buffer, oldCount * elementSize);
+        // the copy has to reach the queue before any frame drawing from the new buffer
+        UploadManager::Submit();
+        retiredBuffers.push_back({ resource, ticket, frame });
+        growCount++;
+    }
+
+    resource = larger;
+    ranges.Grow(newCount);
+}
+
+VkDeviceSize MeshManager::allocate(BufferResource& resource, RangeAllocator& ranges, VkDeviceSize elementSize, VkBufferUsageFlags usage, VkDeviceSize count)
+{
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    VkDeviceSize offset = ranges.Allocate(count, 1);
+    if (offset == RangeAllocator::InvalidOffset)
+    {
+        grow(resource, ranges, elementSize, usage, count);
+        offset = ranges.Allocate(count, 1);
+        if (offset == RangeAllocator::InvalidOffset)
+        {
+            throw std::runtime_error("Failed to allocate mesh range after growing!");
+        }
+    }
+    return offset;
 }
@@ -8,6 +8,8 @@
 #include <vulkan/vulkan.h>
 
 #include "BufferManager.h"
+#include "FileManager.h"
+#include "RangeAllocator.h"
 
 
 struct MeshVertex 
@@ -73,27 +75,93 @@ struct MeshDescriptor
 {
     std::vector<MeshVertex> vertices;
     std::vector<uint32_t> indices;
+
+    // cooked meshes point straight into a mapped cache file instead of owning the data
+    std::shared_ptr<MappedFile> source;
+    const MeshVertex* sourceVertices = nullptr;
+    const uint32_t* sourceIndices = nullptr;
+    uint32_t sourceVertexCount = 0;
+    uint32_t sourceIndexCount = 0;
+
+    inline const MeshVertex* GetVertices() const { return source ? sourceVertices : vertices.data(); }
+    inline const uint32_t* GetIndices() const { return source ? sourceIndices : indices.data(); }
+    inline size_t GetVertexCount() const { return source ? sourceVertexCount : vertices.size(); }
+    inline size_t GetIndexCount() const { return source ? sourceIndexCount : indices.size(); }
 };
 
+// a range of the shared vertex and index buffers, indices are relative to vertexOffset
 struct MeshResource
 {
     std::string name;
-    BufferResource vertexBuffer;
-    BufferResource indexBuffer;
+    uint32_t indexCount = 0;
+    uint32_t firstIndex = 0;
+    uint32_t vertexCount = 0;
+    int32_t vertexOffset = 0;
+
+    // object space bounding sphere and uv units per object space unit, for texture streaming
+    glm::vec3 center = glm::vec3(0.0f);
+    float radius = 0.0f;
+    float uvDensity = 0.0f;
+};
+
+// a shared buffer replaced by a larger copy, kept until no frame can still read it
+struct RetiredMeshBuffer
+{
+    BufferResource buffer;
+    uint64_t ticket;
+    uint64_t frame;
+};
+
+// a freed mesh range, only returned to the allocator once no frame can still read it
+struct PendingMeshFree
+{
+    uint32_t firstIndex;
     uint32_t indexCount;
+    int32_t vertexOffset;
+    uint32_t vertexCount;
+    uint64_t frame;
 };
 
+// every mesh lives in one vertex buffer and one index buffer so draws only bind them once,
+// ranges are handed out by a RangeAllocator and the buffers grow by copying on the gpu
 class MeshManager
 {
 public:
     static void Create();
     static void Destroy();
     static void Finish();
+    // once per frame, releases freed ranges and retired buffers
+    static void Update();
+    static void OnImgui();
+
     static MeshResource* CreateMesh(MeshDescriptor* desc);
+    // the mesh must no longer be referenced by any model
+    static void DestroyMesh(MeshResource* mesh);
+
+    // binds the shared buffers for every draw recorded after it
+    static void Bind(VkCommandBuffer commandBuffer);
 
 private:
     static inline std::vector<MeshDescriptor*> descs;
     static inline std::vector<MeshResource*> meshes;
 
+    static inline BufferResource vertexBuffer{};
+    static inline BufferResource indexBuffer{};
+    // both in elements, not bytes
+    static inline RangeAllocator vertexRanges;
+    static inline RangeAllocator indexRanges;
+
+    static inline uint32_t minVertexCapacity = 1u << 20;
+    static inline uint32_t minIndexCapacity = 1u << 22;
+
+    static inline uint64_t frame = 0;
+    static inline std::vector<RetiredMeshBuffer> retiredBuffers;
+    static inline std::vector<PendingMeshFree> pendingFrees;
+    static inline uint32_t growCount = 0;
+
     static void SetupMesh(MeshDescriptor* desc, MeshResource* resource);
+    static void computeBounds(const MeshDescriptor* desc, MeshResource* resource);
+    static void createBuffer(BufferResource& resource, VkDeviceSize size, VkBufferUsageFlags usage);
+    static void grow(BufferResource& resource, RangeAllocator& ranges, VkDeviceSize elementSize, VkBufferUsageFlags usage, VkDeviceSize required);
+    static VkDeviceSize allocate(BufferResource& resource, RangeAllocator& ranges, VkDeviceSize elementSize, VkBufferUsageFlags usage, VkDeviceSize count);
 };
\ No newline at end of file
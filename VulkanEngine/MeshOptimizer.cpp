@@ -0,0 +1,400 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "imgui/imgui.h"
+
+MeshOptimizerStats MeshOptimizer::Optimize(const std::string& name, std::vector<MeshVertex>& vertices, std::vector<uint32_t>& indices, bool optimize)
+{
+    MeshOptimizerStats result;
+    result.name = name;
+    result.triangles = (uint32_t)(indices.size() / 3);
+    AnalyzeVertexCache(indices, vertices.size(), result.acmrBefore, result.atvrBefore);
+
+    if (optimize && indices.size() >= 3)
+    {
+        OptimizeVertexCache(indices, vertices.size());
+        OptimizeOverdraw(indices, vertices);
+        OptimizeVertexFetch(vertices, indices);
+    }
+
+    result.vertices = (uint32_t)vertices.size();
+    AnalyzeVertexCache(indices, vertices.size(), result.acmrAfter, result.atvrAfter);
+
+    AddStats(result);
+    return result;
+}
+
+void MeshOptimizer::OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount)
+{
+    const int cacheSize = 32;
+    const size_t triangleCount = indices.size() / 3;
+
+    // vertex score from the cache position and the number of triangles still using it
+    auto vertexScore = [](int cachePosition, uint32_t liveTriangles)
+    {
+        if (liveTriangles == 0)
+        {
+            return -1.0f;
+        }
+        float score = 0.0f;
+        if (cachePosition >= 0)
+        {
+            // the last triangle's vertices get a fixed score so it isn't just reused
+            if (cachePosition < 3)
+            {
+                score = 0.75f;
+            }
+            else
+            {
+                score = std::pow(1.0f - (float)(cachePosition - 3) / (cacheSize - 3), 1.5f);
+            }
+        }
+        // favour vertices with few triangles left so they leave the working set
+        score += 2.0f / std::sqrt((float)liveTriangles);
+        return score;
+    };
+
+    // triangle adjacency of every vertex, compacted as triangles are emitted
+    std::vector<uint32_t> liveTriangles(vertexCount, 0);
+    for (uint32_t index : indices)
+    {
+        liveTriangles[index]++;
+    }
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++)
+    {
+        adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+    }
+    std::vector<uint32_t> adjacency(indices.size());
+    std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            uint32_t v = indices[t * 3 + k];
+            adjacency[fill[v]++] = (uint32_t)t;
+        }
+    }
+
+    std::vector<float> vertexScores(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+    {
+        vertexScores[v] = vertexScore(-1, liveTriangles[v]);
+    }
+
+    std::vector<bool> emitted(triangleCount, false);
+
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+
+    std::vector<uint32_t> cache;
+    std::vector<uint32_t> newCache;
+    cache.reserve(cacheSize + 3);
+    newCache.reserve(cacheSize + 3);
+
+    size_t scanCursor = 0;
+    int64_t bestTriangle = -1;
+
+    for (size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++)
+    {
+        // nothing useful in the cache, take the next triangle in input order
+        if (bestTriangle < 0)
+        {
+            while (emitted[scanCursor])
+            {
+                scanCursor++;
+            }
+            bestTriangle = (int64_t)scanCursor;
+        }
+
+        const uint32_t* triangle = &indices[bestTriangle * 3];
+        output.insert(output.end(), triangle, triangle + 3);
+        emitted[bestTriangle] = true;
+
+        // remove the triangle from its vertices' adjacency
+        for (int k = 0; k < 3; k++)
+        {
+            uint32_t v = triangle[k];
+            uint32_t* begin = &adjacency[adjacencyOffsets[v]];
+            uint32_t* end = begin + liveTriangles[v];
+            uint32_t* it = std::find(begin, end, (uint32_t)bestTriangle);
+            if (it != end)
+            {
+                std::swap(*it, *(end - 1));
+                liveTriangles[v]--;
+            }
+        }
+
+        // the triangle's vertices move to the front of the LRU cache
+        newCache.clear();
+        newCache.insert(newCache.end(), triangle, triangle + 3);
+        for (uint32_t v : cache)
+        {
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+            {
+                newCache.push_back(v);
+            }
+        }
+        for (size_t i = cacheSize; i < newCache.size(); i++)
+        {
+            vertexScores[newCache[i]] = vertexScore(-1, liveTriangles[newCache[i]]);
+        }
+        if (newCache.size() > (size_t)cacheSize)
+        {
+            newCache.resize(cacheSize);
+        }
+        std::swap(cache, newCache);
+
+        for (size_t i = 0; i < cache.size(); i++)
+        {
+            uint32_t v = cache[i];
+            vertexScores[v] = vertexScore((int)i, liveTriangles[v]);
+        }
+
+        // rescore the triangles touching the cache and keep the best one
+        bestTriangle = -1;
+        float bestScore = -1.0f;
+        for (uint32_t v : cache)
+        {
+            uint32_t begin = adjacencyOffsets[v];
+            for (uint32_t i = 0; i < liveTriangles[v]; i++)
+            {
+                uint32_t t = adjacency[begin + i];
+                float score = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+                if (score > bestScore)
+                {
+                    bestScore = score;
+                    bestTriangle = t;
+                }
+            }
+        }
+    }
+
+    indices.swap(output);
+}
+
+void MeshOptimizer::OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<MeshVertex>& vertices)
+{
+    const size_t triangleCount = indices.size() / 3;
+
+    // split the cache optimised order where a triangle misses on all three
+    // vertices, reordering whole clusters keeps the cache locality inside them
+    std::vector<uint32_t> clusterStarts;
+    std::vector<uint32_t> fifo(analyzeCacheSize, ~0u);
+    uint32_t fifoHead = 0;
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        int misses = 0;
+        for (int k = 0; k < 3; k++)
+        {
+            uint32_t v = indices[t * 3 + k];
+            if (std::find(fifo.begin(), fifo.end(), v) == fifo.end())
+            {
+                fifo[fifoHead] = v;
+                fifoHead = (fifoHead + 1) % analyzeCacheSize;
+                misses++;
+            }
+        }
+        if (t == 0 || misses == 3)
+        {
+            clusterStarts.push_back((uint32_t)t);
+        }
+    }
+    clusterStarts.push_back((uint32_t)triangleCount);
+
+    glm::vec3 meshCentroid(0.0f);
+    for (uint32_t index : indices)
+    {
+        meshCentroid += vertices[index].pos;
+    }
+    meshCentroid /= (float)indices.size();
+
+    struct Cluster
+    {
+        uint32_t start;
+        uint32_t end;
+        float sortKey;
+    };
+    std::vector<Cluster> clusters(clusterStarts.size() - 1);
+    for (size_t c = 0; c + 1 < clusterStarts.size(); c++)
+    {
+        glm::vec3 centroid(0.0f);
+        glm::vec3 normal(0.0f);
+        float area = 0.0f;
+        for (uint32_t t = clusterStarts[c]; t < clusterStarts[c + 1]; t++)
+        {
+            const glm::vec3& a = vertices[indices[t * 3 + 0]].pos;
+            const glm::vec3& b = vertices[indices[t * 3 + 1]].pos;
+            const glm::vec3& p = vertices[indices[t * 3 + 2]].pos;
+            // area weighted, the cross product length is twice the area
+            glm::vec3 n = glm::cross(b - a, p - a);
+            float triangleArea = glm::length(n);
+            centroid += (a + b + p) / 3.0f * triangleArea;
+            normal += n;
+            area += triangleArea;
+        }
+        if (area > 0.0f)
+        {
+            centroid /= area;
+        }
+        float normalLength = glm::length(normal);
+        if (normalLength > 0.0f)
+        {
+            normal /= normalLength;
+        }
+
+        // clusters facing away from the centre are likely in front of the rest
+        clusters[c].start = clusterStarts[c];
+        clusters[c].end = clusterStarts[c + 1];
+        clusters[c].sortKey = glm::dot(centroid - meshCentroid, normal);
+    }
+
+    std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+    for (const Cluster& cluster : clusters)
+    {
+        output.insert(output.end(), indices.begin() + cluster.start * 3, indices.begin() + cluster.end * 3);
+    }
+    indices.swap(output);
+}
+
+void MeshOptimizer::OptimizeVertexFetch(std::vector<MeshVertex>& vertices, std::vector<uint32_t>& indices)
+{
+    std::vector<uint32_t> remap(vertices.size(), ~0u);
+    std::vector<MeshVertex> output;
+    output.reserve(vertices.size());
+
+    for (uint32_t& index : indices)
+    {
+        if (remap[index] == ~0u)
+        {
+            remap[index] = (uint32_t)output.size();
+            output.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices.swap(output);
+}
+
+void MeshOptimizer::AnalyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, float& acmr, float& atvr)
+{
+    acmr = 0.0f;
+    atvr = 0.0f;
+    if (indices.empty() || vertexCount == 0)
+    {
+        return;
+    }
+
+    // a vertex is in the FIFO if it was pushed less than cacheSize misses ago
+    std::vector<uint32_t> timestamps(vertexCount, 0);
+    uint32_t time = analyzeCacheSize + 1;
+    uint32_t misses = 0;
+    for (uint32_t index : indices)
+    {
+        if (time - timestamps[index] > analyzeCacheSize)
+        {
+            timestamps[index] = time++;
+            misses++;
+        }
+    }
+
+    acmr = (float)misses / (float)(indices.size() / 3);
+    atvr = (float)misses / (float)vertexCount;
+}
+
+void MeshOptimizer::ClearStats()
+{
+    std::lock_guard<std::mutex> lock(statsMutex);
+    stats.clear();
+}
+
+void MeshOptimizer::AddStats(const MeshOptimizerStats& result)
+{
+    std::lock_guard<std::mutex> lock(statsMutex);
+    stats.push_back(result);
+}
+
+void MeshOptimizer::PrintReport()
+{
+    std::lock_guard<std::mutex> lock(statsMutex);
+
+    uint64_t triangles = 0;
+    double missesBefore = 0.0;
+    double missesAfter = 0.0;
+    for (const MeshOptimizerStats& mesh : stats)
+    {
+        std::cout << mesh.name << ": " << mesh.triangles << " triangles, " << mesh.vertices << " vertices"
+            << ", ACMR " << mesh.acmrBefore << " -> " << mesh.acmrAfter
+            << ", ATVR " << mesh.atvrBefore << " -> " << mesh.atvrAfter << std::endl;
+        triangles += mesh.triangles;
+        missesBefore += mesh.acmrBefore * mesh.triangles;
+        missesAfter += mesh.acmrAfter * mesh.triangles;
+    }
+    if (triangles > 0)
+    {
+        std::cout << "total: " << stats.size() << " meshes, " << triangles << " triangles"
+            << ", ACMR " << missesBefore / triangles << " -> " << missesAfter / triangles << std::endl;
+    }
+}
+
+void MeshOptimizer::OnImgui()
+{
+    const auto totalSpace = ImGui::GetContentRegionAvail();
+    const float totalWidth = totalSpace.x;
+
+    if (ImGui::CollapsingHeader("Mesh Optimizer"))
+    {
+        ImGui::Text("Enabled");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::PushID("meshOptimizerEnabled");
+        bool optimize = enabled;
+        if (ImGui::Checkbox("", &optimize))
+        {
+            enabled = optimize;
+        }
+        ImGui::PopID();
+
+        std::lock_guard<std::mutex> lock(statsMutex);
+
+        ImGui::Text("Optimized Meshes");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::Text("%zu", stats.size());
+
+        if (ImGui::TreeNode("Per Mesh"))
+        {
+            ImGuiTableFlags flags = ImGuiTableFlags_ScrollY;
+            flags |= ImGuiTableFlags_RowBg;
+            flags |= ImGuiTableFlags_BordersOuter;
+            flags |= ImGuiTableFlags_BordersV;
+            if (ImGui::BeginTable("meshOptimizerTable", 4, flags, ImVec2(0.0f, 300.0f)))
+            {
+                ImGui::TableSetupScrollFreeze(0, 1);
+                ImGui::TableSetupColumn("Mesh", ImGuiTableColumnFlags_None);
+                ImGui::TableSetupColumn("Triangles", ImGuiTableColumnFlags_None);
+                ImGui::TableSetupColumn("ACMR", ImGuiTableColumnFlags_None);
+                ImGui::TableSetupColumn("ATVR", ImGuiTableColumnFlags_None);
+                ImGui::TableHeadersRow();
+
+                for (const MeshOptimizerStats& mesh : stats)
+                {
+                    ImGui::TableNextRow();
+                    ImGui::TableSetColumnIndex(0);
+                    ImGui::Text("%s", mesh.name.c_str());
+                    ImGui::TableSetColumnIndex(1);
+                    ImGui::Text("%u", mesh.triangles);
+                    ImGui::TableSetColumnIndex(2);
+                    ImGui::Text("%.3f -> %.3f", mesh.acmrBefore, mesh.acmrAfter);
+                    ImGui::TableSetColumnIndex(3);
+                    ImGui::Text("%.3f -> %.3f", mesh.atvrBefore, mesh.atvrAfter);
+                }
+                ImGui::EndTable();
+            }
+            ImGui::TreePop();
+        }
+    }
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "MeshManager.h"
+
+struct MeshOptimizerStats
+{
+    std::string name;
+    uint32_t triangles = 0;
+    uint32_t vertices = 0;
+    // average cache miss ratio, misses per triangle, 0.5 is the ideal for large grids
+    float acmrBefore = 0.0f;
+    float acmrAfter = 0.0f;
+    // average transformed vertex ratio, misses per vertex, 1.0 is ideal
+    float atvrBefore = 0.0f;
+    float atvrAfter = 0.0f;
+};
+
+// runs between import and upload, reorders the index and vertex buffers of a mesh
+// for the post transform cache, for less overdraw and for vertex fetch locality
+class MeshOptimizer
+{
+public:
+    static void OnImgui();
+    static void PrintReport();
+    // the stats describe one load, cleared when the next one starts
+    static void ClearStats();
+    // for meshes loaded from the cache, Optimize adds its own
+    static void AddStats(const MeshOptimizerStats& result);
+
+    // optimize is the IsEnabled snapshot the load took, the toggle may change meanwhile
+    static MeshOptimizerStats Optimize(const std::string& name, std::vector<MeshVertex>& vertices, std::vector<uint32_t>& indices, bool optimize);
+
+    // triangle order from Tom Forsyth's linear speed vertex cache optimisation
+    static void OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount);
+    // sorts cache friendly triangle clusters so the outward facing ones are drawn first
+    static void OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<MeshVertex>& vertices);
+    // renumbers vertices in order of first use, unused vertices are dropped
+    static void OptimizeVertexFetch(std::vector<MeshVertex>& vertices, std::vector<uint32_t>& indices);
+
+    // simulates a FIFO post transform cache, returns misses per triangle and per vertex
+    static void AnalyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, float& acmr, float& atvr);
+
+    static inline bool IsEnabled() { return enabled; }
+
+private:
+    // toggled from the ui while loads read it on worker threads
+    static inline std::atomic<bool> enabled = true;
+    static inline uint32_t analyzeCacheSize = 16;
+
+    static inline std::vector<MeshOptimizerStats> stats;
+    static inline std::mutex statsMutex;
+};
@@ -0,0 +1,536 @@
+#include "MipGenerator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+#include "AssetManager.h"
+#include "JobSystem.h"
+#include "MipGeneratorAvx2.h"
+#include "Profiler.h"
+#include "TextureCache.h"
+#include "imgui/imgui.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MIP_SSE 1
+#include <emmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define MIP_NEON 1
+#include <arm_neon.h>
+#endif
+
+// one rgba texel in float lanes
+#if defined(MIP_SSE)
+#define MIP_SIMD 1
+typedef __m128 Vec4;
+static inline Vec4 Load4(const float* p) { return _mm_loadu_ps(p); }
+static inline void Store4(float* p, Vec4 v) { _mm_storeu_ps(p, v); }
+static inline Vec4 Add4(Vec4 a, Vec4 b) { return _mm_add_ps(a, b); }
+static inline Vec4 Mul4(Vec4 a, Vec4 b) { return _mm_mul_ps(a, b); }
+static inline Vec4 Set4(float v) { return _mm_set1_ps(v); }
+#elif defined(MIP_NEON)
+#define MIP_SIMD 1
+typedef float32x4_t Vec4;
+static inline Vec4 Load4(const float* p) { return vld1q_f32(p); }
+static inline void Store4(float* p, Vec4 v) { vst1q_f32(p, v); }
+static inline Vec4 Add4(Vec4 a, Vec4 b) { return vaddq_f32(a, b); }
+static inline Vec4 Mul4(Vec4 a, Vec4 b) { return vmulq_f32(a, b); }
+static inline Vec4 Set4(float v) { return vdupq_n_f32(v); }
+#endif
+
+static constexpr int KaiserTaps = 6;
+
+// sRGB transfer functions, the encode table has 4096 steps so dark values keep their precision
+struct ColorTables
+{
+    float toLinear[256];
+    float unorm[256];
+    uint8_t fromLinear[4096];
+
+    ColorTables()
+    {
+        for (int i = 0; i < 256; i++)
+        {
+            float c = i / 255.0f;
+            toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+            unorm[i] = c;
+        }
+        for (int i = 0; i < 4096; i++)
+        {
+            float l = i / 4095.0f;
+            float s = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+            fromLinear[i] = (uint8_t)(std::clamp(s, 0.0f, 1.0f) * 255.0f + 0.5f);
+        }
+    }
+};
+
+// half band windowed sinc, the taps sit at -2.5 to 2.5 source texels from the output center
+struct KaiserKernel
+{
+    float weights[KaiserTaps];
+
+    KaiserKernel()
+    {
+        const float alpha = 4.0f;
+        const float radius = 1.5f;
+        const float pi = 3.14159265f;
+
+        auto besselI0 = [](float x)
+        {
+            float sum = 1.0f;
+            float term = 1.0f;
+            for (int k = 1; k < 16; k++)
+            {
+                term *= (x / (2.0f * k)) * (x / (2.0f * k));
+                sum += term;
+            }
+            return sum;
+        };
+
+        float total = 0.0f;
+        for (int i = 0; i < KaiserTaps; i++)
+        {
+            // distance in destination texels
+            float t = (i - 2.5f) * 0.5f;
+            float sinc = std::sin(pi * t) / (pi * t);
+            float x = t / radius;
+            float window = besselI0(alpha * std::sqrt(std::max(0.0f, 1.0f - x * x))) / besselI0(alpha);
+            weights[i] = sinc * window;
+            total += weights[i];
+        }
+        for (int i = 0; i < KaiserTaps; i++)
+        {
+            weights[i] /= total;
+        }
+    }
+};
+
+static const ColorTables& GetColorTables()
+{
+    static ColorTables tables;
+    return tables;
+}
+
+static const KaiserKernel& GetKaiserKernel()
+{
+    static KaiserKernel kernel;
+    return kernel;
+}
+
+bool MipGenerator::hasAvx2()
+{
+#if defined(MIP_SSE) && defined(_MSC_VER)
+    static const bool supported = []()
+    {
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7)
+        {
+            return false;
+        }
+        // the os has to save the ymm registers as well
+        __cpuid(info, 1);
+        const int osxsave = 1 << 27;
+        const int avx = 1 << 28;
+        if ((info[2] & osxsave) == 0 || (info[2] & avx) == 0 || (_xgetbv(0) & 6) != 6)
+        {
+            return false;
+        }
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+    }();
+    return supported;
+#elif defined(MIP_SSE)
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+void MipGenerator::forRows(uint32_t rows, uint32_t band, const std::function<void(uint32_t, uint32_t)>& func)
+{
+    const uint32_t bands = (rows + band - 1) / band;
+    if (bands <= 1)
+    {
+        func(0, rows);
+        return;
+    }
+    JobSystem::ParallelFor(bands, [&](uint32_t i)
+    {
+        uint32_t first = i * band;
+        func(first, std::min(band, rows - first));
+    });
+}
+
+void MipGenerator::boxRows(const float* src, uint32_t srcWidth, uint32_t srcHeight, float* dst, uint32_t dstWidth, uint32_t first, uint32_t count, bool useSimd)
+{
+    const bool avx2 = useSimd && hasAvx2();
+
+    for (uint32_t y = first; y < first + count; y++)
+    {
+        const float* row0 = src + (size_t)std::min(y * 2, srcHeight - 1) * srcWidth * 4;
+        const float* row1 = src + (size_t)std::min(y * 2 + 1, srcHeight - 1) * srcWidth * 4;
+        float* out = dst + (size_t)y * dstWidth * 4;
+
+        uint32_t x = 0;
+        if (avx2)
+        {
+            x = BoxRowAvx2(row0, row1, srcWidth, out, dstWidth);
+        }
+        if (useSimd)
+        {
+#if defined(MIP_SIMD)
+            const Vec4 quarter = Set4(0.25f);
+            for (; x < dstWidth && x * 2 + 1 < srcWidth; x++)
+            {
+                Vec4 top = Add4(Load4(row0 + x * 8), Load4(row0 + x * 8 + 4));
+                Vec4 bottom = Add4(Load4(row1 + x * 8), Load4(row1 + x * 8 + 4));
+                Store4(out + x * 4, Mul4(Add4(top, bottom), quarter));
+            }
+#endif
+        }
+
+        // odd edges and the scalar path repeat the last texel
+        for (; x < dstWidth; x++)
+        {
+            uint32_t x0 = std::min(x * 2, srcWidth - 1) * 4;
+            uint32_t x1 = std::min(x * 2 + 1, srcWidth - 1) * 4;
+            for (int c = 0; c < 4; c++)
+            {
+                out[x * 4 + c] = (row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c]) * 0.25f;
+            }
+        }
+    }
+}
+
+void MipGenerator::kaiserRowsX(const float* src, uint32_t srcWidth, float* temp, uint32_t dstWidth, uint32_t first, uint32_t count, bool useSimd)
+{
+    const float* weights = GetKaiserKernel().weights;
+
+    for (uint32_t y = first; y < first + count; y++)
+    {
+        const float* row = src + (size_t)y * srcWidth * 4;
+        float* out = temp + (size_t)y * dstWidth * 4;
+
+        for (uint32_t x = 0; x < dstWidth; x++)
+        {
+            int firstTap = (int)x * 2 - 2;
+#if defined(MIP_SIMD)
+            if (useSimd && firstTap >= 0 && firstTap + KaiserTaps <= (int)srcWidth)
+            {
+                Vec4 sum = Mul4(Load4(row + firstTap * 4), Set4(weights[0]));
+                for (int k = 1; k < KaiserTaps; k++)
+                {
+                    sum = Add4(sum, Mul4(Load4(row + (firstTap + k) * 4), Set4(weights[k])));
+                }
+                Store4(out + x * 4, sum);
+                continue;
+            }
+#endif
+            float sum[4] = {};
+            for (int k = 0; k < KaiserTaps; k++)
+            {
+                const float* texel = row + std::clamp(firstTap + k, 0, (int)srcWidth - 1) * 4;
+                for (int c = 0; c < 4; c++)
+                {
+                    sum[c] += texel[c] * weights[k];
+                }
+            }
+            memcpy(out + x * 4, sum, sizeof(sum));
+        }
+    }
+}
+
+void MipGenerator::kaiserRowsY(const float* temp, uint32_t dstWidth, uint32_t srcHeight, float* dst, uint32_t first, uint32_t count, bool useSimd)
+{
+    const float* weights = GetKaiserKernel().weights;
+    const size_t rowFloats = (size_t)dstWidth * 4;
+
+    for (uint32_t y = first; y < first + count; y++)
+    {
+        const float* rows[KaiserTaps];
+        for (int k = 0; k < KaiserTaps; k++)
+        {
+            rows[k] = temp + std::clamp((int)y * 2 - 2 + k, 0, (int)srcHeight - 1) * rowFloats;
+        }
+        float* out = dst + y * rowFloats;
+
+        // every lane of the row is independent here
+        size_t i = 0;
+#if defined(MIP_SIMD)
+        if (useSimd)
+        {
+            for (; i < rowFloats; i += 4)
+            {
+                Vec4 sum = Mul4(Load4(rows[0] + i), Set4(weights[0]));
+                for (int k = 1; k < KaiserTaps; k++)
+                {
+                    sum = Add4(sum, Mul4(Load4(rows[k] + i), Set4(weights[k])));
+                }
+                Store4(out + i, sum);
+            }
+        }
+#endif
+        for (; i < rowFloats; i++)
+        {
+            float sum = 0.0f;
+            for (int k = 0; k < KaiserTaps; k++)
+            {
+                sum += rows[k][i] * weights[k];
+            }
+            out[i] = sum;
+        }
+    }
+}
+
+void MipGenerator::Generate(const uint8_t* rgba, uint32_t width, uint32_t height, bool srgb, MipChain& chain)
+{
+    PROFILE_FUNCTION();
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // the ui may change these while a decode job is in here, every level uses the same
+    const bool useSimd = simd;
+    const MipFilter useFilter = filter;
+    const uint32_t band = (uint32_t)std::max(1, rowsPerJob.load());
+
+    const uint32_t levelCount = (uint32_t)(std::floor(std::log2(std::max(width, height)))) + 1;
+
+    chain.levels.resize(levelCount);
+    VkDeviceSize offset = 0;
+    for (uint32_t i = 0; i < levelCount; i++)
+    {
+        ImageLevel& level = chain.levels[i];
+        level.width = std::max(1u, width >> i);
+        level.height = std::max(1u, height >> i);
+        level.offset = (offset + 15) / 16 * 16;
+        level.size = (VkDeviceSize)level.width * level.height * 4;
+        offset = level.offset + level.size;
+    }
+    chain.data.resize((size_t)offset);
+    memcpy(chain.data.data(), rgba, (size_t)chain.levels[0].size);
+
+    const ColorTables& tables = GetColorTables();
+    const float* toFloat = srgb ? tables.toLinear : tables.unorm;
+
+    // levels are filtered from the float level above, never from the quantized one
+    std::vector<float> src((size_t)width * height * 4);
+    std::vector<float> dst;
+    std::vector<float> temp;
+
+    forRows(height, band, [&](uint32_t first, uint32_t count)
+    {
+        for (size_t i = (size_t)first * width * 4; i < (size_t)(first + count) * width * 4; i += 4)
+        {
+            src[i + 0] = toFloat[rgba[i + 0]];
+            src[i + 1] = toFloat[rgba[i + 1]];
+            src[i + 2] = toFloat[rgba[i + 2]];
+            src[i + 3] = tables.unorm[rgba[i + 3]];
+        }
+    });
+
+    for (uint32_t i = 1; i < levelCount; i++)
+    {
+        const ImageLevel& above = chain.levels[i - 1];
+        const ImageLevel& level = chain.levels[i];
+        dst.resize((size_t)level.width * level.height * 4);
+
+        if (useFilter == MipFilter::Kaiser)
+        {
+            temp.resize((size_t)level.width * above.height * 4);
+            forRows(above.height, band, [&](uint32_t first, uint32_t count)
+            {
+                kaiserRowsX(src.data(), above.width, temp.data(), level.width, first, count, useSimd);
+            });
+            forRows(level.height, band, [&](uint32_t first, uint32_t count)
+            {
+                kaiserRowsY(temp.data(), level.width, above.height, dst.data(), first, count, useSimd);
+            });
+        }
+        else
+        {
+            forRows(level.height, band, [&](uint32_t first, uint32_t count)
+            {
+                boxRows(src.data(), above.width, above.height, dst.data(), level.width, first, count, useSimd);
+            });
+        }
+
+        uint8_t* out = chain.data.data() + level.offset;
+        forRows(level.height, band, [&](uint32_t first, uint32_t count)
+        {
+            for (size_t t = (size_t)first * level.width * 4; t < (size_t)(first + count) * level.width * 4; t += 4)
+            {
+                for (int c = 0; c < 3; c++)
+                {
+                    float v = std::clamp(dst[t + c], 0.0f, 1.0f);
+                    out[t + c] = srgb ? tables.fromLinear[(int)(v * 4095.0f + 0.5f)] : (uint8_t)(v * 255.0f + 0.5f);
+                }
+                out[t + 3] = (uint8_t)(std::clamp(dst[t + 3], 0.0f, 1.0f) * 255.0f + 0.5f);
+            }
+        });
+
+        std::swap(src, dst);
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+    microseconds += (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+    texelsGenerated += (uint64_t)width * height;
+    chainsGenerated++;
+}
+
+void MipGenerator::OnImgui()
+{
+    const auto totalSpace = ImGui::GetContentRegionAvail();
+    const float totalWidth = totalSpace.x;
+
+    if (ImGui::CollapsingHeader("Mip Generation"))
+    {
+        ImGui::Text("CPU Mips");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::PushID("mipEnabled");
+        bool generate = enabled;
+        if (ImGui::Checkbox("", &generate))
+        {
+            enabled = generate;
+        }
+        ImGui::PopID();
+
+        ImGui::Text("SIMD");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::PushID("mipSimd");
+        bool useSimd = simd;
+        if (ImGui::Checkbox("", &useSimd))
+        {
+            simd = useSimd;
+        }
+        ImGui::PopID();
+
+        ImGui::Text("AVX2");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::Text(hasAvx2() ? "Yes" : "No");
+
+        ImGui::Text("Filter");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::PushID("mipFilter");
+        int filterIndex = (int)filter.load();
+        if (ImGui::Combo("", &filterIndex, "Box\0Kaiser\0"))
+        {
+            filter = (MipFilter)filterIndex;
+        }
+        ImGui::PopID();
+
+        ImGui::Text("Rows per Job");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::PushID("mipRowsPerJob");
+        int rows = rowsPerJob;
+        if (ImGui::SliderInt("", &rows, 4, 256))
+        {
+            rowsPerJob = rows;
+        }
+        ImGui::PopID();
+
+        uint64_t chains = chainsGenerated;
+        uint64_t texels = texelsGenerated;
+        float ms = microseconds / 1000.0f;
+        ImGui::Text("Chains Generated");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::Text("%llu", (unsigned long long)chains);
+        ImGui::Text("Generation Time");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::Text("%.2f ms, %.1f Mtexel/s", ms, ms > 0.0f ? texels / (ms * 1000.0f) : 0.0f);
+    }
+}
+
+std::vector<DecodedImage> MipGenerator::DecodeImages(const std::filesystem::path& directory)
+{
+    std::vector<DecodedImage> images;
+    for (const std::filesystem::path& path : TextureCache::FindImages(directory))
+    {
+        DecodedImage image;
+        image.pixels = AssetManager::DecodeImageFile(path, image.width, image.height);
+        image.srgb = !TextureCache::IsNormalMap(path);
+        if (image.pixels != nullptr)
+        {
+            images.push_back(image);
+        }
+    }
+    if (images.empty())
+    {
+        std::cerr << "No images to benchmark under " << directory.string() << std::endl;
+    }
+    return images;
+}
+
+void MipGenerator::FreeImages(std::vector<DecodedImage>& images)
+{
+    for (const DecodedImage& image : images)
+    {
+        AssetManager::FreeImage(image.pixels);
+    }
+    images.clear();
+}
+
+void MipGenerator::Benchmark(const std::filesystem::path& directory)
+{
+    std::vector<DecodedImage> images = DecodeImages(directory);
+    if (images.empty())
+    {
+        return;
+    }
+    uint64_t texels = 0;
+    for (const DecodedImage& image : images)
+    {
+        texels += (uint64_t)image.width * image.height;
+    }
+
+    auto run = [&](const char* label)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        for (const DecodedImage& image : images)
+        {
+            MipChain chain;
+            Generate(image.pixels, image.width, image.height, image.srgb, chain);
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        float ms = std::chrono::duration<float, std::milli>(end - start).count();
+        std::cout << "mips " << label << ": " << ms << " ms, " << texels / (ms * 1000.0f) << " Mtexel/s"
+            << " (" << images.size() << " images, " << texels / 1000000.0f << " Mtexel)" << std::endl;
+    };
+
+    const bool wasSimd = simd;
+    const MipFilter wasFilter = filter;
+    const uint32_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    for (MipFilter benchFilter : { MipFilter::Box, MipFilter::Kaiser })
+    {
+        filter = benchFilter;
+        const char* filterName = benchFilter == MipFilter::Box ? "box" : "kaiser";
+
+        simd = false;
+        run((std::string(filterName) + " scalar, 1 thread").c_str());
+        simd = true;
+        // doubling, then every hardware thread even when that is not a power of two
+        for (uint32_t threads = 1; threads <= maxThreads; threads = threads < maxThreads ? std::min(threads * 2, maxThreads) : threads + 1)
+        {
+            // the calling thread also runs jobs, so one thread means no workers
+            if (threads > 1)
+            {
+                JobSystem::Create(threads - 1);
+            }
+            run((std::string(filterName) + " simd, " + std::to_string(threads) + (threads == 1 ? " thread" : " threads")).c_str());
+            if (threads > 1)
+            {
+                JobSystem::Destroy();
+            }
+        }
+    }
+    simd = wasSimd;
+    filter = wasFilter;
+
+    FreeImages(images);
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <vector>
+
+#include "ImageManager.h"
+
+enum class MipFilter
+{
+    Box,
+    // windowed sinc over 6 texels, sharper than the box with less aliasing
+    Kaiser,
+};
+
+// every level of an rgba8 chain back to back, 16 byte aligned, ready for one upload copy
+struct MipChain
+{
+    std::vector<uint8_t> data;
+    std::vector<ImageLevel> levels;
+};
+
+// an rgba8 image decoded for a benchmark
+struct DecodedImage
+{
+    unsigned char* pixels = nullptr;
+    int width = 0;
+    int height = 0;
+    bool srgb = true;
+};
+
+// builds mip chains on the cpu, so no format needs linear blit support and the whole chain
+// is uploaded with a single copy, sRGB colors are filtered in linear light
+// every level is split in row bands over the JobSystem, each texel is filtered as 4 float
+// lanes with SSE or NEON, and the box filter does 2 texels at once where the cpu has AVX2
+class MipGenerator
+{
+public:
+    static void OnImgui();
+
+    // srgb when the colors are sRGB encoded, alpha is always linear, level 0 is copied as is
+    static void Generate(const uint8_t* rgba, uint32_t width, uint32_t height, bool srgb, MipChain& chain);
+
+    // over the images under a directory, scalar against simd and with 1 to N threads
+    static void Benchmark(const std::filesystem::path& directory);
+    // every image under the directory that decodes, with its color space by name
+    static std::vector<DecodedImage> DecodeImages(const std::filesystem::path& directory);
+    static void FreeImages(std::vector<DecodedImage>& images);
+
+    static inline bool IsEnabled() { return enabled; }
+
+private:
+    // set from the ui, read by decode and streaming jobs, Generate reads them once per chain
+    static inline std::atomic<bool> enabled = true;
+    static inline std::atomic<bool> simd = true;
+    static inline std::atomic<MipFilter> filter = MipFilter::Box;
+    static inline std::atomic<int> rowsPerJob = 32;
+
+    static inline std::atomic<uint64_t> chainsGenerated = 0;
+    static inline std::atomic<uint64_t> texelsGenerated = 0;
+    static inline std::atomic<uint64_t> microseconds = 0;
+
+    // checked once with cpuid, the kernel lives in its own file built for AVX2
+    static bool hasAvx2();
+    // the dst rows from first to first + count
+    static void boxRows(const float* src, uint32_t srcWidth, uint32_t srcHeight, float* dst, uint32_t dstWidth, uint32_t first, uint32_t count, bool useSimd);
+    // separable, horizontal from src rows into temp rows, then vertical from temp into dst rows
+    static void kaiserRowsX(const float* src, uint32_t srcWidth, float* temp, uint32_t dstWidth, uint32_t first, uint32_t count, bool useSimd);
+    static void kaiserRowsY(const float* temp, uint32_t dstWidth, uint32_t srcHeight, float* dst, uint32_t first, uint32_t count, bool useSimd);
+    static void forRows(uint32_t rows, uint32_t band, const std::function<void(uint32_t, uint32_t)>& func);
+};
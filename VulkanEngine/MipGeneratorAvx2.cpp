@@ -0,0 +1,34 @@
+#include "MipGeneratorAvx2.h"
+
+// built with /arch:AVX2, the only file that is
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define MIP_AVX2 1
+#include <immintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define MIP_AVX2_TARGET __attribute__((target("avx2")))
+#else
+#define MIP_AVX2_TARGET
+#endif
+#endif
+
+#if defined(MIP_AVX2)
+MIP_AVX2_TARGET uint32_t BoxRowAvx2(const float* row0, const float* row1, uint32_t srcWidth, float* out, uint32_t dstWidth)
+{
+    // two output texels from four source texels of each row
+    const __m256 quarter = _mm256_set1_ps(0.25f);
+    uint32_t x = 0;
+    for (; x + 1 < dstWidth && x * 2 + 3 < srcWidth; x += 2)
+    {
+        __m256 a = _mm256_add_ps(_mm256_loadu_ps(row0 + x * 8), _mm256_loadu_ps(row1 + x * 8));
+        __m256 b = _mm256_add_ps(_mm256_loadu_ps(row0 + x * 8 + 8), _mm256_loadu_ps(row1 + x * 8 + 8));
+        __m256 sum = _mm256_add_ps(_mm256_permute2f128_ps(a, b, 0x20), _mm256_permute2f128_ps(a, b, 0x31));
+        _mm256_storeu_ps(out + x * 4, _mm256_mul_ps(sum, quarter));
+    }
+    return x;
+}
+#else
+uint32_t BoxRowAvx2(const float* row0, const float* row1, uint32_t srcWidth, float* out, uint32_t dstWidth)
+{
+    return 0;
+}
+#endif
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <cstdint>
+
+// box filter of one dst row, 2 texels at once, returns how many texels it covered
+// the rest is left to the 4 lane path, only call it when the cpu supports AVX2
+// kept apart from other headers, inline code compiled for AVX2 must not be shared with other files
+uint32_t BoxRowAvx2(const float* row0, const float* row1, uint32_t srcWidth, float* out, uint32_t dstWidth);
@@ -19,7 +19,6 @@ struct Model
     MeshResource* mesh = nullptr;
     TextureResource* texture = nullptr;
     ModelUBO ubo;
-    std::vector<VkDescriptorSet> descriptors;
-    std::vector<BufferResource> buffers;
-    std::vector<VkDescriptorSet> materialDescriptors;
+    // material set of the current texture, shared with every model using it
+    VkDescriptorSet materialDescriptor = VK_NULL_HANDLE;
 };
\ No newline at end of file
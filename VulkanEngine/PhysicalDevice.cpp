@@ -13,6 +13,12 @@ void PhysicalDevice::Create()
 	std::vector<VkPhysicalDevice> devices(deviceCount);
 	vkEnumeratePhysicalDevices(Instance::GetInstance(), &deviceCount, devices.data());
 
+	// offscreen rendering needs neither a swapchain nor a queue that can present
+	if (Window::IsHeadless())
+	{
+		requiredExtensions.clear();
+	}
+
 
 	for (const auto& currVkDevice : devices)
 	{
@@ -42,7 +48,14 @@ void PhysicalDevice::Create()
 			}
 
 			VkBool32 present = false;
-			vkGetPhysicalDeviceSurfaceSupportKHR(currVkDevice, i, Instance::GetSurface(), &present);
+			if (Window::IsHeadless())
+			{
+				present = (family.queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0;
+			}
+			else
+			{
+				vkGetPhysicalDeviceSurfaceSupportKHR(currVkDevice, i, Instance::GetSurface(), &present);
+			}
 			if (present)
 			{
 				currDevice.presentFamily = i;
@@ -54,6 +67,26 @@ void PhysicalDevice::Create()
 			}
 		}
 
+		// a family with transfer but no graphics is usually backed by a DMA engine
+		// and can copy in parallel with rendering
+		for (int i = 0; i < currDevice.families.size(); i++)
+		{
+			const auto& family = currDevice.families[i];
+			if ((family.queueFlags & VK_QUEUE_TRANSFER_BIT) && !(family.queueFlags & VK_QUEUE_GRAPHICS_BIT))
+			{
+				currDevice.transferFamily = i;
+				// prefer one without compute too
+				if (!(family.queueFlags & VK_QUEUE_COMPUTE_BIT))
+				{
+					break;
+				}
+			}
+		}
+		if (currDevice.transferFamily == -1)
+		{
+			currDevice.transferFamily = currDevice.graphicsFamily;
+		}
+
 		//max samples
 		vkGetPhysicalDeviceProperties(currVkDevice, &currDevice.properties);
 		vkGetPhysicalDeviceMemoryProperties(currVkDevice, &currDevice.memoryProperties);
@@ -103,6 +136,11 @@ void PhysicalDevice::Destroy()
 
 void PhysicalDevice::OnSurfaceUpdate()
 {
+	if (Window::IsHeadless())
+	{
+		return;
+	}
+
 	auto surface = Instance::GetSurface();
 
 	for (auto& currDevice : allDevices)
@@ -241,6 +279,9 @@ void PhysicalDevice::OnImgui()
                 ImGui::Dummy(ImVec2(5.0f, .0f));
                 ImGui::SameLine();
                 ImGui::Text("Present Family: %d", d.presentFamily);
+                ImGui::Dummy(ImVec2(5.0f, .0f));
+                ImGui::SameLine();
+                ImGui::Text("Transfer Family: %d", d.transferFamily);
                 ImGui::Separator();
                 if (ImGui::TreeNode("Extensions")) 
                 {
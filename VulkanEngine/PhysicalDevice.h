@@ -21,8 +21,13 @@ public:
     static inline bool IsDirty() { return dirty; }
     static inline VkPhysicalDevice GetVkPhysicalDevice() { return device->vkDevice; }
     static inline VkPhysicalDeviceFeatures GetFeatures() { return device->features; }
+    static inline const VkPhysicalDeviceProperties& GetProperties() { return device->properties; }
+    static inline const VkPhysicalDeviceMemoryProperties& GetMemoryProperties() { return device->memoryProperties; }
     static inline uint32_t GetPresentFamily() { return device->presentFamily; }
     static inline uint32_t GetGraphicsFamily() { return device->graphicsFamily; }
+    static inline uint32_t GetTransferFamily() { return device->transferFamily; }
+    static inline const VkQueueFamilyProperties& GetGraphicsFamilyProperties() { return device->families[device->graphicsFamily]; }
+    static inline bool HasDedicatedTransfer() { return device->transferFamily != device->graphicsFamily; }
     static inline VkSampleCountFlags GetSampleCounts() { return device->sampleCounts; }
     static inline VkSampleCountFlagBits GetMaxSamples() { return device->maxSamples; }
     static inline VkSurfaceCapabilitiesKHR GetCapabilities() { return device->capabilities; }
@@ -41,6 +46,8 @@ private:
     bool suitable = false;
     int presentFamily = -1;
     int graphicsFamily = -1;
+    // falls back to the graphics family when there is no transfer only family
+    int transferFamily = -1;
 
     VkPhysicalDevice vkDevice = VK_NULL_HANDLE;
     VkSampleCountFlagBits maxSamples = VK_SAMPLE_COUNT_1_BIT;
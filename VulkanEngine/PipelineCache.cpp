@@ -0,0 +1,201 @@
+#include "PipelineCache.h"
+
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+#include "FileManager.h"
+#include "imgui/imgui.h"
+
+static const char* ResultStr(PipelineCacheResult result)
+{
+    switch (result)
+    {
+    case PipelineCacheResult::Hit: return "Hit";
+    case PipelineCacheResult::Miss: return "Miss";
+    default: return "Unknown";
+    }
+}
+
+void PipelineCache::Create()
+{
+    auto device = LogicalDevice::GetVkDevice();
+    auto allocator = Instance::GetAllocator();
+
+    std::vector<char> data;
+    bool loaded = load(data);
+
+    VkPipelineCacheCreateInfo cacheInfo{};
+    cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    cacheInfo.initialDataSize = loaded ? data.size() : 0;
+    cacheInfo.pInitialData = loaded ? data.data() : nullptr;
+
+    auto result = vkCreatePipelineCache(device, &cacheInfo, allocator, &cache);
+    if (result != VK_SUCCESS && loaded)
+    {
+        // the driver can still refuse data that passed our checks, start cold instead
+        loadStatus = "Rejected by driver";
+        loadedBytes = 0;
+        cacheInfo.initialDataSize = 0;
+        cacheInfo.pInitialData = nullptr;
+        result = vkCreatePipelineCache(device, &cacheInfo, allocator, &cache);
+    }
+    if (result != VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to create pipeline cache!");
+    }
+
+    std::cout << "Pipeline cache: " << loadStatus << std::endl;
+}
+
+void PipelineCache::Destroy()
+{
+    if (cache == VK_NULL_HANDLE)
+    {
+        return;
+    }
+    save();
+    vkDestroyPipelineCache(LogicalDevice::GetVkDevice(), cache, Instance::GetAllocator());
+    cache = VK_NULL_HANDLE;
+}
+
+bool PipelineCache::load(std::vector<char>& data)
+{
+    loadedBytes = 0;
+    if (!std::filesystem::exists(path))
+    {
+        loadStatus = "No file";
+        return false;
+    }
+
+    std::vector<char> file = FileManager::ReadRawBytes(path);
+    if (file.size() < sizeof(Header))
+    {
+        loadStatus = "Truncated";
+        return false;
+    }
+
+    Header header;
+    memcpy(&header, file.data(), sizeof(Header));
+    if (memcmp(header.magic, magic, sizeof(magic)) != 0 || header.version != version)
+    {
+        loadStatus = "Unknown format";
+        return false;
+    }
+
+    // a cache from another device or driver is at best useless and at worst crashes the driver
+    const auto& props = PhysicalDevice::GetProperties();
+    if (header.vendorID != props.vendorID || header.deviceID != props.deviceID)
+    {
+        loadStatus = "Different device";
+        return false;
+    }
+    if (header.driverVersion != props.driverVersion)
+    {
+        loadStatus = "Different driver";
+        return false;
+    }
+    if (memcmp(header.pipelineCacheUUID, props.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+    {
+        loadStatus = "Different cache UUID";
+        return false;
+    }
+
+    if (header.dataSize != file.size() - sizeof(Header) ||
+        FileManager::Hash(file.data() + sizeof(Header), header.dataSize) != header.dataHash)
+    {
+        loadStatus = "Corrupted";
+        return false;
+    }
+
+    data.assign(file.begin() + sizeof(Header), file.end());
+    loadedBytes = data.size();
+    loadStatus = "Loaded";
+    return true;
+}
+
+void PipelineCache::save()
+{
+    auto device = LogicalDevice::GetVkDevice();
+
+    size_t size = 0;
+    if (vkGetPipelineCacheData(device, cache, &size, nullptr) != VK_SUCCESS || size == 0)
+    {
+        return;
+    }
+
+    std::vector<char> out(sizeof(Header) + size);
+    if (vkGetPipelineCacheData(device, cache, &size, out.data() + sizeof(Header)) != VK_SUCCESS)
+    {
+        return;
+    }
+    out.resize(sizeof(Header) + size);
+
+    const auto& props = PhysicalDevice::GetProperties();
+
+    Header header{};
+    memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    header.vendorID = props.vendorID;
+    header.deviceID = props.deviceID;
+    header.driverVersion = props.driverVersion;
+    memcpy(header.pipelineCacheUUID, props.pipelineCacheUUID, VK_UUID_SIZE);
+    header.dataSize = size;
+    header.dataHash = FileManager::Hash(out.data() + sizeof(Header), size);
+    memcpy(out.data(), &header, sizeof(Header));
+
+    if (!FileManager::WriteRawBytes(path, out.data(), out.size()))
+    {
+        std::cerr << "Failed to write pipeline cache " << path << std::endl;
+        return;
+    }
+    savedBytes = size;
+}
+
+void PipelineCache::Record(const std::string& name, float ms, PipelineCacheResult result)
+{
+    counts[(int)result]++;
+    totalMs[(int)result] += ms;
+    lastName = name;
+    lastMs = ms;
+    lastResult = result;
+}
+
+void PipelineCache::OnImgui()
+{
+    const auto totalSpace = ImGui::GetContentRegionAvail();
+    const float totalWidth = totalSpace.x;
+
+    if (ImGui::CollapsingHeader("Pipeline Cache"))
+    {
+        ImGui::Text("File");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::Text("%s", path.c_str());
+        ImGui::Text("Load");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::Text("%s (%.1f KB)", loadStatus.c_str(), loadedBytes / 1024.0f);
+        ImGui::Text("Last Save");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::Text("%.1f KB", savedBytes / 1024.0f);
+
+        const PipelineCacheResult results[] = { PipelineCacheResult::Hit, PipelineCacheResult::Miss, PipelineCacheResult::Unknown };
+        for (PipelineCacheResult result : results)
+        {
+            uint32_t count = counts[(int)result];
+            ImGui::Text("%s", ResultStr(result));
+            ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+            ImGui::Text("%u, avg %.3f ms", count, count > 0 ? totalMs[(int)result] / count : 0.0f);
+        }
+
+        if (!lastName.empty())
+        {
+            ImGui::Text("Last Pipeline");
+            ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+            ImGui::Text("%s, %s, %.3f ms", lastName.c_str(), ResultStr(lastResult), lastMs);
+        }
+        if (!LogicalDevice::IsExtensionEnabled(VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME))
+        {
+            ImGui::TextDisabled("No creation feedback, hits are not reported");
+        }
+    }
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <string>
+
+#include "LogicalDevice.h"
+#include "PhysicalDevice.h"
+
+enum class PipelineCacheResult
+{
+    Unknown,
+    Hit,
+    Miss,
+};
+
+// process wide VkPipelineCache, loaded from disk on Create and written back on Destroy
+// the file is only used by the exact device and driver that wrote it
+class PipelineCache
+{
+public:
+    static void Create();
+    static void Destroy();
+    static void OnImgui();
+
+    // called after every pipeline creation, the result comes from VK_EXT_pipeline_creation_feedback
+    static void Record(const std::string& name, float ms, PipelineCacheResult result);
+
+    static inline VkPipelineCache GetVkPipelineCache() { return cache; }
+
+private:
+    static constexpr char magic[4] = { 'V', 'E', 'P', 'C' };
+    static constexpr uint32_t version = 1;
+
+    struct Header
+    {
+        char magic[4];
+        uint32_t version;
+        uint32_t vendorID;
+        uint32_t deviceID;
+        uint32_t driverVersion;
+        uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+        uint64_t dataSize;
+        uint64_t dataHash;
+    };
+
+    static inline std::string path = "pipeline.cache";
+    static inline VkPipelineCache cache = VK_NULL_HANDLE;
+
+    static inline std::string loadStatus = "Not loaded";
+    static inline size_t loadedBytes = 0;
+    static inline size_t savedBytes = 0;
+
+    static inline uint32_t counts[3] = { 0, 0, 0 };
+    static inline float totalMs[3] = { 0.0f, 0.0f, 0.0f };
+    static inline std::string lastName;
+    static inline float lastMs = 0.0f;
+    static inline PipelineCacheResult lastResult = PipelineCacheResult::Unknown;
+
+    static bool load(std::vector<char>& data);
+    static void save();
+};
@@ -0,0 +1,259 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+#include "imgui/imgui.h"
+
+void Profiler::Create()
+{
+    origin = std::chrono::high_resolution_clock::now();
+    currentFrameStart = 0;
+}
+
+void Profiler::Destroy()
+{
+    // threads keep a pointer to their buffer, so buffers live until exit
+    enabled = false;
+    frameEvents.clear();
+    captureEvents.clear();
+    captureLeft = 0;
+}
+
+ProfileThreadBuffer* Profiler::getThreadBuffer()
+{
+    if (threadBuffer == nullptr)
+    {
+        // once per thread, every later zone only touches its own buffer
+        threadBuffer = new ProfileThreadBuffer();
+        std::lock_guard<std::mutex> lock(threadsMutex);
+        threadBuffer->thread = (uint32_t)threads.size();
+        threads.push_back(threadBuffer);
+    }
+    return threadBuffer;
+}
+
+uint32_t Profiler::Begin()
+{
+    return getThreadBuffer()->depth++;
+}
+
+void Profiler::End(const char* name, uint64_t start, uint32_t depth)
+{
+    uint64_t end = Now();
+    ProfileThreadBuffer* buffer = getThreadBuffer();
+    buffer->depth = depth;
+
+    uint32_t head = buffer->head.load(std::memory_order_relaxed);
+    uint32_t tail = buffer->tail.load(std::memory_order_acquire);
+    if (head - tail >= ProfileThreadBuffer::Capacity)
+    {
+        buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    ProfileEvent& event = buffer->events[head % ProfileThreadBuffer::Capacity];
+    event.name = name;
+    event.start = start;
+    event.end = end;
+    event.depth = depth;
+    event.thread = buffer->thread;
+    buffer->head.store(head + 1, std::memory_order_release);
+}
+
+void Profiler::BeginFrame()
+{
+    uint64_t now = Now();
+
+    std::vector<ProfileEvent> events;
+    {
+        std::lock_guard<std::mutex> lock(threadsMutex);
+        for (ProfileThreadBuffer* buffer : threads)
+        {
+            uint32_t tail = buffer->tail.load(std::memory_order_relaxed);
+            uint32_t head = buffer->head.load(std::memory_order_acquire);
+            for (; tail != head; tail++)
+            {
+                events.push_back(buffer->events[tail % ProfileThreadBuffer::Capacity]);
+            }
+            buffer->tail.store(tail, std::memory_order_release);
+        }
+    }
+
+    if (!paused && IsEnabled())
+    {
+        frameEvents = events;
+        frameStart = currentFrameStart;
+        frameEnd = now;
+    }
+
+    if (captureLeft > 0)
+    {
+        captureEvents.insert(captureEvents.end(), events.begin(), events.end());
+        captureLeft--;
+        if (captureLeft == 0)
+        {
+            bool written = WriteTrace(tracePath);
+            traceStatus = written ? "Wrote " + std::to_string(captureEvents.size()) + " zones to " + tracePath : "Failed to write " + tracePath;
+            std::cout << traceStatus << std::endl;
+            captureEvents.clear();
+        }
+    }
+
+    currentFrameStart = now;
+}
+
+bool Profiler::WriteTrace(const std::string& path)
+{
+    std::ofstream file(path, std::ios::trunc);
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    // complete events, timestamps in microseconds
+    file << "{\"traceEvents\":[\n";
+    for (size_t i = 0; i < captureEvents.size(); i++)
+    {
+        const ProfileEvent& event = captureEvents[i];
+        char line[512];
+        snprintf(line, sizeof(line), "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}%s\n",
+            event.name, event.thread, event.start / 1000.0, (event.end - event.start) / 1000.0, i + 1 < captureEvents.size() ? "," : "");
+        file << line;
+    }
+    file << "],\"displayTimeUnit\":\"ms\"}\n";
+    return file.good();
+}
+
+void Profiler::drawFlame(float width)
+{
+    const float rowHeight = ImGui::GetTextLineHeight() + 4.0f;
+    const double frameLength = (double)std::max<uint64_t>(1, frameEnd - frameStart);
+
+    // one band per thread, as deep as its deepest zone
+    uint32_t threadCount = 0;
+    for (const ProfileEvent& event : frameEvents)
+    {
+        threadCount = std::max(threadCount, event.thread + 1);
+    }
+    std::vector<uint32_t> threadDepth(threadCount, 0);
+    for (const ProfileEvent& event : frameEvents)
+    {
+        threadDepth[event.thread] = std::max(threadDepth[event.thread], event.depth + 1);
+    }
+    std::vector<float> threadOffset(threadCount, 0.0f);
+    float height = 0.0f;
+    for (uint32_t i = 0; i < threadCount; i++)
+    {
+        threadOffset[i] = height;
+        height += threadDepth[i] > 0 ? (threadDepth[i] + 0.5f) * rowHeight : 0.0f;
+    }
+
+    ImDrawList* drawList = ImGui::GetWindowDrawList();
+    const ImVec2 origin = ImGui::GetCursorScreenPos();
+    ImGui::InvisibleButton("flame", ImVec2(width, std::max(height, rowHeight)));
+    const bool hovered = ImGui::IsItemHovered();
+    const ImVec2 mouse = ImGui::GetMousePos();
+
+    for (const ProfileEvent& event : frameEvents)
+    {
+        if (event.end < frameStart)
+        {
+            continue;
+        }
+        float x0 = origin.x + (float)((double)(std::max(event.start, frameStart) - frameStart) / frameLength * width);
+        float x1 = origin.x + (float)((double)(event.end - frameStart) / frameLength * width);
+        x1 = std::max(x1, x0 + 1.0f);
+        float y0 = origin.y + threadOffset[event.thread] + event.depth * rowHeight;
+        float y1 = y0 + rowHeight - 1.0f;
+
+        // stable color per zone name
+        size_t hash = std::hash<const void*>()(event.name);
+        ImU32 color = IM_COL32(80 + hash % 150, 80 + (hash >> 8) % 150, 80 + (hash >> 16) % 150, 255);
+        drawList->AddRectFilled(ImVec2(x0, y0), ImVec2(x1, y1), color);
+
+        const ImVec2 textSize = ImGui::CalcTextSize(event.name);
+        if (x1 - x0 > textSize.x + 4.0f)
+        {
+            drawList->AddText(ImVec2(x0 + 2.0f, y0 + 2.0f), IM_COL32(0, 0, 0, 255), event.name);
+        }
+
+        if (hovered && mouse.x >= x0 && mouse.x < x1 && mouse.y >= y0 && mouse.y < y1)
+        {
+            ImGui::SetTooltip("%s\n%.3f ms\nthread %u", event.name, (event.end - event.start) / 1000000.0, event.thread);
+        }
+    }
+}
+
+void Profiler::OnImgui()
+{
+    if (ImGui::Begin("Profiler"))
+    {
+        const auto totalSpace = ImGui::GetContentRegionAvail();
+        const float totalWidth = totalSpace.x;
+
+        ImGui::Text("Enabled");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::PushID("profilerEnabled");
+        bool on = IsEnabled();
+        if (ImGui::Checkbox("", &on))
+        {
+            enabled = on;
+        }
+        ImGui::PopID();
+        ImGui::Text("Pause");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::PushID("profilerPaused");
+        ImGui::Checkbox("", &paused);
+        ImGui::PopID();
+
+        uint32_t dropped = 0;
+        size_t threadCount = 0;
+        {
+            std::lock_guard<std::mutex> lock(threadsMutex);
+            threadCount = threads.size();
+            for (ProfileThreadBuffer* buffer : threads)
+            {
+                dropped += buffer->dropped.load(std::memory_order_relaxed);
+            }
+        }
+        ImGui::Text("Threads");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::Text("%zu", threadCount);
+        ImGui::Text("Dropped Zones");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::Text("%u", dropped);
+
+        ImGui::Text("Capture Frames");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::SetNextItemWidth(totalWidth * 2.0f / 5.0f);
+        ImGui::PushID("captureFrames");
+        ImGui::InputInt("", &captureFrames);
+        captureFrames = std::max(captureFrames, 1);
+        ImGui::PopID();
+        ImGui::Text("Chrome Trace");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::PushID("captureTrace");
+        if (ImGui::Button(captureLeft > 0 ? "Capturing..." : "Capture") && captureLeft == 0)
+        {
+            enabled = true;
+            captureEvents.clear();
+            captureLeft = captureFrames;
+        }
+        ImGui::PopID();
+        if (!traceStatus.empty())
+        {
+            ImGui::TextWrapped("%s", traceStatus.c_str());
+        }
+
+        if (IsEnabled() && !frameEvents.empty())
+        {
+            ImGui::Separator();
+            ImGui::Text("Frame %.3f ms", (frameEnd - frameStart) / 1000000.0);
+            drawFlame(totalWidth);
+        }
+    }
+    ImGui::End();
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// one closed zone, times are nanoseconds since the profiler was created
+struct ProfileEvent
+{
+    const char* name = nullptr;
+    uint64_t start = 0;
+    uint64_t end = 0;
+    uint32_t depth = 0;
+    uint32_t thread = 0;
+};
+
+// single producer single consumer ring, the owning thread pushes closed zones
+// and the main thread drains them once per frame, no locks on either side
+struct ProfileThreadBuffer
+{
+    static constexpr uint32_t Capacity = 1 << 14;
+
+    ProfileEvent events[Capacity];
+    std::atomic<uint32_t> head = 0;
+    std::atomic<uint32_t> tail = 0;
+    std::atomic<uint32_t> dropped = 0;
+    uint32_t thread = 0;
+    uint32_t depth = 0;
+};
+
+// hierarchical cpu profiler, zones are recorded with PROFILE_ZONE and shown per frame
+// as a flame view, a few frames can be captured to a chrome trace json (chrome://tracing, perfetto)
+class Profiler
+{
+public:
+    static void Create();
+    static void Destroy();
+    // closes the previous frame and collects the zones every thread recorded during it
+    static void BeginFrame();
+    static void OnImgui();
+
+    static inline bool IsEnabled() { return enabled.load(std::memory_order_relaxed); }
+    static inline uint64_t Now() { return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - origin).count(); }
+
+    static uint32_t Begin();
+    static void End(const char* name, uint64_t start, uint32_t depth);
+
+    // writes the captured frames as chrome trace events
+    static bool WriteTrace(const std::string& path);
+
+private:
+    static inline std::atomic<bool> enabled = false;
+    static inline std::chrono::high_resolution_clock::time_point origin;
+
+    static inline std::mutex threadsMutex;
+    static inline std::vector<ProfileThreadBuffer*> threads;
+    static inline thread_local ProfileThreadBuffer* threadBuffer = nullptr;
+
+    // the last complete frame, kept while paused
+    static inline std::vector<ProfileEvent> frameEvents;
+    static inline uint64_t frameStart = 0;
+    static inline uint64_t frameEnd = 0;
+    static inline uint64_t currentFrameStart = 0;
+    static inline bool paused = false;
+
+    static inline std::vector<ProfileEvent> captureEvents;
+    static inline int captureFrames = 60;
+    static inline int captureLeft = 0;
+    static inline std::string tracePath = "profile.json";
+    static inline std::string traceStatus;
+
+    static ProfileThreadBuffer* getThreadBuffer();
+    static void drawFlame(float width);
+};
+
+// closes its zone when it goes out of scope, costs a relaxed load when disabled
+class ProfileZone
+{
+public:
+    inline ProfileZone(const char* name)
+    {
+        if (Profiler::IsEnabled())
+        {
+            this->name = name;
+            depth = Profiler::Begin();
+            start = Profiler::Now();
+        }
+    }
+
+    inline ~ProfileZone()
+    {
+        if (name != nullptr)
+        {
+            Profiler::End(name, start, depth);
+        }
+    }
+
+    ProfileZone(const ProfileZone&) = delete;
+    ProfileZone& operator=(const ProfileZone&) = delete;
+
+private:
+    const char* name = nullptr;
+    uint64_t start = 0;
+    uint32_t depth = 0;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+// the name must outlive the frame, use string literals
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_ZONE(__FUNCTION__)
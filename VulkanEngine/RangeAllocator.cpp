@@ -0,0 +1,112 @@
+#include "RangeAllocator.h"
+
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+
+void RangeAllocator::Init(VkDeviceSize size)
+{
+    this->size = size;
+    used = 0;
+    freeRanges.clear();
+    if (size > 0)
+    {
+        freeRanges[0] = size;
+    }
+}
+
+VkDeviceSize RangeAllocator::Allocate(VkDeviceSize size, VkDeviceSize alignment)
+{
+    if (alignment == 0)
+    {
+        alignment = 1;
+    }
+
+    for (auto it = freeRanges.begin(); it != freeRanges.end(); it++)
+    {
+        VkDeviceSize rangeOffset = it->first;
+        VkDeviceSize rangeSize = it->second;
+        VkDeviceSize aligned = (rangeOffset + alignment - 1) / alignment * alignment;
+        VkDeviceSize padding = aligned - rangeOffset;
+
+        if (padding + size > rangeSize)
+        {
+            continue;
+        }
+
+        freeRanges.erase(it);
+
+        // keep the alignment padding and the tail as free ranges
+        if (padding > 0)
+        {
+            freeRanges[rangeOffset] = padding;
+        }
+        VkDeviceSize tail = rangeSize - padding - size;
+        if (tail > 0)
+        {
+            freeRanges[aligned + size] = tail;
+        }
+
+        used += size;
+        return aligned;
+    }
+
+    return InvalidOffset;
+}
+
+void RangeAllocator::Free(VkDeviceSize offset, VkDeviceSize size)
+{
+    if (size == 0)
+    {
+        return;
+    }
+    if (offset + size > this->size || size > used)
+    {
+        throw std::runtime_error("Freeing range outside of RangeAllocator!");
+    }
+
+    used -= size;
+
+    auto next = freeRanges.lower_bound(offset);
+    // merge with the following free range
+    if (next != freeRanges.end() && next->first == offset + size)
+    {
+        size += next->second;
+        next = freeRanges.erase(next);
+    }
+    // merge with the preceding free range
+    if (next != freeRanges.begin())
+    {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == offset)
+        {
+            prev->second += size;
+            return;
+        }
+    }
+    freeRanges[offset] = size;
+}
+
+void RangeAllocator::Grow(VkDeviceSize newSize)
+{
+    if (newSize <= size)
+    {
+        return;
+    }
+    VkDeviceSize oldSize = size;
+    VkDeviceSize extra = newSize - oldSize;
+    size = newSize;
+    // the new tail goes through Free so it merges with a free range at the old end
+    used += extra;
+    Free(oldSize, extra);
+}
+
+VkDeviceSize RangeAllocator::GetLargestFree() const
+{
+    VkDeviceSize largest = 0;
+    for (const auto& range : freeRanges)
+    {
+        largest = std::max(largest, range.second);
+    }
+    return largest;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <map>
+
+// first-fit free list over a linear range [0, size)
+// free neighbours are merged back together on Free
+class RangeAllocator
+{
+public:
+    static constexpr VkDeviceSize InvalidOffset = ~0ull;
+
+    void Init(VkDeviceSize size);
+    VkDeviceSize Allocate(VkDeviceSize size, VkDeviceSize alignment);
+    void Free(VkDeviceSize offset, VkDeviceSize size);
+    // extends the range, existing allocations keep their offsets
+    void Grow(VkDeviceSize newSize);
+    VkDeviceSize GetLargestFree() const;
+
+    inline VkDeviceSize GetSize() const { return size; }
+    inline VkDeviceSize GetUsed() const { return used; }
+    inline VkDeviceSize GetFree() const { return size - used; }
+    inline size_t GetFreeRangeCount() const { return freeRanges.size(); }
+    inline bool IsEmpty() const { return used == 0; }
+
+private:
+    VkDeviceSize size = 0;
+    VkDeviceSize used = 0;
+    // offset -> size of every free range
+    std::map<VkDeviceSize, VkDeviceSize> freeRanges;
+};
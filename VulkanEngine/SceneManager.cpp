@@ -8,20 +8,27 @@
 #include "LogicalDevice.h"
 #include "Camera.h"
 
+#include <algorithm>
+#include <cmath>
+#include <unordered_set>
+
 void SceneManager::Setup() 
 {
-    std::vector<Model*> newModels;
+    // loaded together so the files are parsed in parallel
+    std::vector<std::vector<Model*>> newModels = AssetManager::LoadObjFiles(
+    {
+        "assets/viking_room.obj",
+        "assets/Converse.obj",
+        "assets/sponza/sponza.obj"
+    });
 
-    newModels = AssetManager::LoadObjFile("assets/viking_room.obj");
-    //SceneManager::SetTexture(newModels[0], AssetManager::LoadImageFile("assets/viking_room.png"));
-    SceneManager::AddModel(newModels[0]);
+    //SceneManager::SetTexture(newModels[0][0], AssetManager::LoadImageFile("assets/viking_room.png"));
+    SceneManager::AddModel(newModels[0][0]);
 
-    newModels = AssetManager::LoadObjFile("assets/Converse.obj");
-    //SceneManager::SetTexture(newModels[0], AssetManager::LoadImageFile("assets/Converse.jpg"));
-    SceneManager::AddModel(newModels[0]);
+    //SceneManager::SetTexture(newModels[1][0], AssetManager::LoadImageFile("assets/Converse.jpg"));
+    SceneManager::AddModel(newModels[1][0]);
 
-    newModels = AssetManager::LoadObjFile("assets/sponza/sponza.obj");
-    for (Model* model : newModels) 
+    for (Model* model : newModels[2]) 
     {
         model->ubo.model = glm::scale(glm::vec3(0.1));
         SceneManager::AddModel(model);
@@ -29,79 +36,328 @@ void SceneManager::Setup()
 
 }
 
-void CreateModelDescriptors(Model* model) 
+void SceneManager::createModelBuffer(uint32_t capacity)
 {
-    auto numFrames = SwapChain::GetNumFrames();
+    auto numFrames = SwapChain::GetFramesInFlight();
     auto device = LogicalDevice::GetVkDevice();
-    auto allocator = Instance::GetAllocator();
     auto unlitGPO = UnlitGraphicsPipeline::GetResource();
 
-    std::vector<VkDescriptorSetLayout> layouts(numFrames, unlitGPO.modelDescriptorSetLayout);
+    // dynamic offsets must be multiples of minUniformBufferOffsetAlignment
+    VkDeviceSize alignment = PhysicalDevice::GetProperties().limits.minUniformBufferOffsetAlignment;
+    modelStride = (sizeof(ModelUBO) + alignment - 1) / alignment * alignment;
+    modelCapacity = capacity;
 
-    VkDescriptorSetAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    allocInfo.descriptorPool = GraphicsPipelineManager::GetDescriptorPool();
-    allocInfo.descriptorSetCount = static_cast<uint32_t>(numFrames);
-    allocInfo.pSetLayouts = layouts.data();
+    BufferDescriptor uniformDesc;
+    uniformDesc.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+    uniformDesc.properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    uniformDesc.size = modelStride * modelCapacity * numFrames;
 
-    model->descriptors.resize(numFrames);
-    auto vkRes = vkAllocateDescriptorSets(device, &allocInfo, model->descriptors.data());
-    if (vkRes != VK_SUCCESS)
+    BufferManager::Create(uniformDesc, modelBuffer);
+
+    if (modelDescriptor == VK_NULL_HANDLE)
     {
-        throw std::runtime_error("Failed to allocate transform descriptor sets!");
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = GraphicsPipelineManager::GetDescriptorPool();
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &unlitGPO.modelDescriptorSetLayout;
+
+        auto vkRes = vkAllocateDescriptorSets(device, &allocInfo, &modelDescriptor);
+        if (vkRes != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to allocate transform descriptor set!");
+        }
     }
 
-    std::vector<VkDescriptorSetLayout> matLayouts(numFrames, unlitGPO.textureDescriptorSetLayout);
-
-    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    allocInfo.descriptorPool = GraphicsPipelineManager::GetDescriptorPool();
-    allocInfo.descriptorSetCount = static_cast<uint32_t>(numFrames);
-    allocInfo.pSetLayouts = matLayouts.data();
+    VkDescriptorBufferInfo bufferInfo{};
+    bufferInfo.buffer = modelBuffer.buffer;
+    bufferInfo.offset = 0;
+    // the range seen by the shader, the dynamic offset selects the model
+    bufferInfo.range = sizeof(ModelUBO);
+
+    VkWriteDescriptorSet descriptorWrite{};
+    descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrite.dstSet = modelDescriptor;
+    descriptorWrite.dstBinding = 0;
+    descriptorWrite.dstArrayElement = 0;
+    descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.pBufferInfo = &bufferInfo;
+
+    vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+}
 
-    model->materialDescriptors.resize(numFrames);
-    vkRes = vkAllocateDescriptorSets(device, &allocInfo, model->materialDescriptors.data());
-    if (vkRes != VK_SUCCESS)
+void SceneManager::destroyModelBuffer()
+{
+    if (modelBuffer.mapped != nullptr)
     {
-        throw std::runtime_error("Failed to allocate texture descriptor sets!");
+        BufferManager::Destroy(modelBuffer);
     }
+    modelCapacity = 0;
+}
 
-    for (size_t i = 0; i < numFrames; i++) 
+void SceneManager::createIndirectBuffers(uint32_t capacity)
+{
+    auto numFrames = SwapChain::GetFramesInFlight();
+    auto device = LogicalDevice::GetVkDevice();
+    auto indirectGPO = UnlitGraphicsPipeline::GetIndirectResource();
+
+    // every frame binds its own slice, so slices start on the storage buffer alignment
+    VkDeviceSize alignment = PhysicalDevice::GetProperties().limits.minStorageBufferOffsetAlignment;
+    objectCapacity = capacity;
+    objectFrameStride = (sizeof(ObjectData) * capacity + alignment - 1) / alignment * alignment;
+
+    BufferDescriptor objectDesc;
+    objectDesc.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    objectDesc.properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    objectDesc.size = objectFrameStride * numFrames;
+    BufferManager::Create(objectDesc, objectBuffer);
+
+    BufferDescriptor commandDesc;
+    commandDesc.usage = VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+    commandDesc.properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    commandDesc.size = sizeof(VkDrawIndexedIndirectCommand) * capacity * numFrames;
+    BufferManager::Create(commandDesc, indirectBuffer);
+
+    if (objectDescriptors.empty())
     {
-        model->buffers.resize(numFrames);
+        std::vector<VkDescriptorSetLayout> layouts(numFrames, indirectGPO.modelDescriptorSetLayout);
 
-        BufferDescriptor uniformDesc;
-        uniformDesc.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
-        uniformDesc.properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-        uniformDesc.size = sizeof(ModelUBO);
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = GraphicsPipelineManager::GetDescriptorPool();
+        allocInfo.descriptorSetCount = static_cast<uint32_t>(numFrames);
+        allocInfo.pSetLayouts = layouts.data();
 
-        BufferManager::Create(uniformDesc, model->buffers[i]);
+        objectDescriptors.resize(numFrames);
+        auto vkRes = vkAllocateDescriptorSets(device, &allocInfo, objectDescriptors.data());
+        if (vkRes != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to allocate object descriptor sets!");
+        }
     }
 
-    for (size_t i = 0; i < numFrames; i++) 
+    for (size_t i = 0; i < numFrames; i++)
     {
         VkDescriptorBufferInfo bufferInfo{};
-        bufferInfo.buffer = model->buffers[i].buffer;
-        bufferInfo.offset = 0;
-        bufferInfo.range = sizeof(ModelUBO);
+        bufferInfo.buffer = objectBuffer.buffer;
+        bufferInfo.offset = i * objectFrameStride;
+        bufferInfo.range = sizeof(ObjectData) * capacity;
+
+        VkWriteDescriptorSet descriptorWrite{};
+        descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrite.dstSet = objectDescriptors[i];
+        descriptorWrite.dstBinding = 0;
+        descriptorWrite.dstArrayElement = 0;
+        descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptorWrite.descriptorCount = 1;
+        descriptorWrite.pBufferInfo = &bufferInfo;
+
+        vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+    }
+}
 
-        std::array<VkWriteDescriptorSet, 1> descriptorWrites{};
+void SceneManager::destroyIndirectBuffers()
+{
+    if (objectBuffer.mapped != nullptr)
+    {
+        BufferManager::Destroy(objectBuffer);
+        BufferManager::Destroy(indirectBuffer);
+    }
+    objectCapacity = 0;
+}
 
-        descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrites[0].dstSet = model->descriptors[i];
-        descriptorWrites[0].dstBinding = 0;
-        // in the case of our descriptors being arrays, we specify the index
-        descriptorWrites[0].dstArrayElement = 0;
-        descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        descriptorWrites[0].descriptorCount = 1;
-        descriptorWrites[0].pBufferInfo = &bufferInfo;
+uint32_t SceneManager::getTextureSlot(TextureResource* texture)
+{
+    auto it = textureSlots.find(texture);
+    if (it != textureSlots.end())
+    {
+        return it->second;
+    }
 
-        vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+    if (slotTextures.size() >= GraphicsPipelineManager::MaxBindlessTextures)
+    {
+        std::cerr << "Texture array is full, " << texture->path.string() << " uses the default texture" << std::endl;
+        textureSlots[texture] = 0;
+        return 0;
+    }
+
+    if (!freeSlots.empty())
+    {
+        uint32_t slot = freeSlots.back();
+        freeSlots.pop_back();
+        textureSlots[texture] = slot;
+        slotTextures[slot] = texture;
+        lowerWrittenSlots(slot);
+        return slot;
+    }
+
+    uint32_t slot = (uint32_t)slotTextures.size();
+    textureSlots[texture] = slot;
+    slotTextures.push_back(texture);
+    return slot;
+}
+
+void SceneManager::lowerWrittenSlots(uint32_t slot)
+{
+    // each frame rewrites the slot the next time its context records
+    for (uint32_t& written : writtenSlots)
+    {
+        written = std::min(written, slot);
+    }
+}
+
+void SceneManager::writeTextureSlots(uint32_t frameIndex, uint32_t firstSlot, uint32_t count)
+{
+    TextureResource* defaultTexture = TextureManager::GetDefaultTexture();
+
+    std::vector<VkDescriptorImageInfo> imageInfos(count);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint32_t slot = firstSlot + i;
+        TextureResource* texture = slot < slotTextures.size() ? slotTextures[slot] : defaultTexture;
+        imageInfos[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        imageInfos[i].imageView = texture->image.view;
+        imageInfos[i].sampler = texture->sampler;
+    }
+
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = textureArrayDescriptors[frameIndex];
+    write.dstBinding = 0;
+    write.dstArrayElement = firstSlot;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.descriptorCount = count;
+    write.pImageInfo = imageInfos.data();
+
+    vkUpdateDescriptorSets(LogicalDevice::GetVkDevice(), 1, &write, 0, nullptr);
+}
+
+void SceneManager::updateIndirect(uint32_t frameIndex)
+{
+    if (models.size() > objectCapacity)
+    {
+        vkDeviceWaitIdle(LogicalDevice::GetVkDevice());
+        uint32_t capacity = std::max(objectCapacity * 2, (uint32_t)models.size());
+        destroyIndirectBuffers();
+        createIndirectBuffers(capacity);
+    }
+
+    TextureResource* defaultTexture = TextureManager::GetDefaultTexture();
+    ObjectData* objects = (ObjectData*)((char*)objectBuffer.mapped + frameIndex * objectFrameStride);
+    VkDrawIndexedIndirectCommand* commands = (VkDrawIndexedIndirectCommand*)indirectBuffer.mapped + (size_t)frameIndex * objectCapacity;
+
+    uint32_t drawCount = 0;
+    for (Model* model : models)
+    {
+        if (model->mesh == nullptr)
+        {
+            continue;
+        }
+
+        ObjectData& object = objects[drawCount];
+        object.model = model->ubo.model;
+        object.textureIndex = getTextureSlot(model->texture != nullptr ? model->texture : defaultTexture);
+
+        // firstInstance is the object index the vertex shader reads through gl_InstanceIndex
+        VkDrawIndexedIndirectCommand& command = commands[drawCount];
+        command.indexCount = model->mesh->indexCount;
+        command.instanceCount = 1;
+        command.firstIndex = model->mesh->firstIndex;
+        command.vertexOffset = model->mesh->vertexOffset;
+        command.firstInstance = drawCount;
+
+        drawCount++;
+    }
+    drawCounts[frameIndex] = drawCount;
+
+    // slots handed out since this frame's array was last written
+    if (writtenSlots[frameIndex] < slotTextures.size())
+    {
+        writeTextureSlots(frameIndex, writtenSlots[frameIndex], (uint32_t)slotTextures.size() - writtenSlots[frameIndex]);
+        writtenSlots[frameIndex] = (uint32_t)slotTextures.size();
+    }
+
+    if (drawCount > 0)
+    {
+        BufferManager::Flush(objectBuffer, frameIndex * objectFrameStride, drawCount * sizeof(ObjectData));
+        BufferManager::Flush(indirectBuffer, (VkDeviceSize)frameIndex * objectCapacity * sizeof(VkDrawIndexedIndirectCommand), drawCount * sizeof(VkDrawIndexedIndirectCommand));
+    }
+}
+
+void SceneManager::DrawIndirect(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+{
+    uint32_t drawCount = drawCounts[frameIndex];
+    const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+    VkDeviceSize offset = (VkDeviceSize)frameIndex * objectCapacity * stride;
+
+    if (PhysicalDevice::GetFeatures().multiDrawIndirect)
+    {
+        uint32_t maxCount = PhysicalDevice::GetProperties().limits.maxDrawIndirectCount;
+        for (uint32_t first = 0; first < drawCount; first += maxCount)
+        {
+            vkCmdDrawIndexedIndirect(commandBuffer, indirectBuffer.buffer, offset + (VkDeviceSize)first * stride, std::min(maxCount, drawCount - first), stride);
+        }
+    }
+    else
+    {
+        for (uint32_t i = 0; i < drawCount; i++)
+        {
+            vkCmdDrawIndexedIndirect(commandBuffer, indirectBuffer.buffer, offset + (VkDeviceSize)i * stride, 1, stride);
+        }
+    }
+}
+
+void SceneManager::UpdateModels(uint32_t frameIndex)
+{
+    frame++;
+    const uint64_t safeFrames = SwapChain::GetFramesInFlight() + 1;
+    for (size_t i = 0; i < retiredDescriptors.size();)
+    {
+        if (frame >= retiredDescriptors[i].frame + safeFrames)
+        {
+            vkFreeDescriptorSets(LogicalDevice::GetVkDevice(), GraphicsPipelineManager::GetDescriptorPool(), 1, &retiredDescriptors[i].set);
+            retiredDescriptors.erase(retiredDescriptors.begin() + i);
+        }
+        else
+        {
+            i++;
+        }
+    }
+
+    if (models.size() > modelCapacity)
+    {
+        // the buffer is shared by all frames in flight, so growing it needs an idle device
+        vkDeviceWaitIdle(LogicalDevice::GetVkDevice());
+        uint32_t capacity = std::max(modelCapacity * 2, (uint32_t)models.size());
+        destroyModelBuffer();
+        createModelBuffer(capacity);
+    }
+
+    VkDeviceSize frameOffset = (VkDeviceSize)frameIndex * modelCapacity * modelStride;
+    char* frameData = (char*)modelBuffer.mapped + frameOffset;
+    for (size_t i = 0; i < models.size(); i++)
+    {
+        memcpy(frameData + i * modelStride, &models[i]->ubo, sizeof(ModelUBO));
+
+        TextureResource* texture = models[i]->texture != nullptr ? models[i]->texture : TextureManager::GetDefaultTexture();
+        models[i]->materialDescriptor = getMaterialDescriptor(texture);
+    }
+    // a zero sized range is invalid
+    if (!models.empty())
+    {
+        BufferManager::Flush(modelBuffer, frameOffset, models.size() * modelStride);
+    }
+
+    if (UnlitGraphicsPipeline::UseIndirect())
+    {
+        updateIndirect(frameIndex);
     }
 }
 
 void SceneManager::Create()
 {
-    auto numFrames = SwapChain::GetNumFrames();
+    auto numFrames = SwapChain::GetFramesInFlight();
     auto device = LogicalDevice::GetVkDevice();
     auto allocator = Instance::GetAllocator();
     auto unlitGPO = UnlitGraphicsPipeline::GetResource();
@@ -154,12 +410,31 @@ void SceneManager::Create()
         vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
     }
 
-    for (Model* model : models) 
+    createModelBuffer(std::max((uint32_t)models.size(), 64u));
+
+    if (UnlitGraphicsPipeline::IsIndirectSupported())
     {
-        CreateModelDescriptors(model);
-        if (model->texture) 
+        createIndirectBuffers(std::max((uint32_t)models.size(), 64u));
+
+        std::vector<VkDescriptorSetLayout> arrayLayouts(numFrames, UnlitGraphicsPipeline::GetIndirectResource().textureDescriptorSetLayout);
+        allocInfo.descriptorSetCount = static_cast<uint32_t>(numFrames);
+        allocInfo.pSetLayouts = arrayLayouts.data();
+
+        textureArrayDescriptors.resize(numFrames);
+        vkRes = vkAllocateDescriptorSets(device, &allocInfo, textureArrayDescriptors.data());
+        if (vkRes != VK_SUCCESS)
         {
-            SceneManager::SetTexture(model, model->texture);
+            throw std::runtime_error("Failed to allocate texture array descriptor sets!");
+        }
+
+        getTextureSlot(TextureManager::GetDefaultTexture());
+        drawCounts.assign(numFrames, 0);
+        writtenSlots.assign(numFrames, (uint32_t)slotTextures.size());
+
+        // the shader statically uses the whole array, so unused slots hold the default texture
+        for (uint32_t i = 0; i < numFrames; i++)
+        {
+            writeTextureSlots(i, 0, GraphicsPipelineManager::MaxBindlessTextures);
         }
     }
 }
@@ -173,14 +448,25 @@ void SceneManager::Destroy()
     sceneBuffers.clear();
     sceneDescriptors.clear();
 
+    destroyModelBuffer();
+    modelDescriptor = VK_NULL_HANDLE;
+
+    destroyIndirectBuffers();
+    objectDescriptors.clear();
+    textureArrayDescriptors.clear();
+    drawCounts.clear();
+    writtenSlots.clear();
+
+    // the sets die with the descriptor pool
+    for (TextureResource* texture : describedTextures)
+    {
+        texture->materialDescriptor = VK_NULL_HANDLE;
+    }
+    describedTextures.clear();
+    retiredDescriptors.clear();
     for (Model* model : models) 
     {
-        for (BufferResource& buffer : model->buffers) 
-        {
-            BufferManager::Destroy(buffer);
-        }
-        model->buffers.clear();
-        model->descriptors.clear();
+        model->materialDescriptor = VK_NULL_HANDLE;
     }
 }
 
@@ -190,41 +476,183 @@ void SceneManager::Finish()
     {
         delete model;
     }
+    models.clear();
+    spawnedModels.clear();
 }
 
 void SceneManager::SetTexture(Model* model, TextureResource* texture) 
 {
-    std::array<VkWriteDescriptorSet, 1> writes{};
+    // the model binds the material set of the new texture from the next recorded frame,
+    // frames in flight keep the old set which is never rewritten
+    TextureManager::Acquire(texture);
+    TextureManager::Release(model->texture);
+    model->texture = texture;
+}
+
+void SceneManager::ForgetTexture(TextureResource* texture)
+{
+    // frames in flight may still bind the set
+    if (texture->materialDescriptor != VK_NULL_HANDLE)
+    {
+        retiredDescriptors.push_back({ texture->materialDescriptor, frame });
+        texture->materialDescriptor = VK_NULL_HANDLE;
+        describedTextures.erase(std::remove(describedTextures.begin(), describedTextures.end(), texture), describedTextures.end());
+    }
+
+    auto it = textureSlots.find(texture);
+    if (it == textureSlots.end())
+    {
+        return;
+    }
+    uint32_t slot = it->second;
+    textureSlots.erase(it);
+
+    // slot 0 is shared by textures that didn't fit in the array
+    if (slot != 0)
+    {
+        slotTextures[slot] = TextureManager::GetDefaultTexture();
+        freeSlots.push_back(slot);
+        lowerWrittenSlots(slot);
+    }
+}
+
+void SceneManager::RewriteTextureDescriptors()
+{
+    auto device = LogicalDevice::GetVkDevice();
+
+    // material sets are allocated again on the next UpdateModels
+    for (TextureResource* texture : describedTextures)
+    {
+        vkFreeDescriptorSets(device, GraphicsPipelineManager::GetDescriptorPool(), 1, &texture->materialDescriptor);
+        texture->materialDescriptor = VK_NULL_HANDLE;
+    }
+    describedTextures.clear();
+
+    for (uint32_t i = 0; i < textureArrayDescriptors.size(); i++)
+    {
+        writeTextureSlots(i, 0, GraphicsPipelineManager::MaxBindlessTextures);
+    }
+}
+
+void SceneManager::OnTextureImageChanged(TextureResource* texture)
+{
+    // the material set is never rewritten, the next UpdateModels allocates one for the new view
+    if (texture->materialDescriptor != VK_NULL_HANDLE)
+    {
+        retiredDescriptors.push_back({ texture->materialDescriptor, frame });
+        texture->materialDescriptor = VK_NULL_HANDLE;
+        describedTextures.erase(std::remove(describedTextures.begin(), describedTextures.end(), texture), describedTextures.end());
+    }
+
+    // each frame's array is rewritten from the slot when that frame records next
+    auto it = textureSlots.find(texture);
+    if (it != textureSlots.end() && it->second != 0)
+    {
+        lowerWrittenSlots(it->second);
+    }
+}
+
+VkDescriptorSet SceneManager::getMaterialDescriptor(TextureResource* texture)
+{
+    if (texture->materialDescriptor != VK_NULL_HANDLE)
+    {
+        return texture->materialDescriptor;
+    }
+
+    auto device = LogicalDevice::GetVkDevice();
+    auto unlitGPO = UnlitGraphicsPipeline::GetResource();
+
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = GraphicsPipelineManager::GetDescriptorPool();
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &unlitGPO.textureDescriptorSetLayout;
+
+    auto vkRes = vkAllocateDescriptorSets(device, &allocInfo, &texture->materialDescriptor);
+    if (vkRes != VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to allocate texture descriptor set!");
+    }
 
     VkDescriptorImageInfo imageInfo{};
     imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
     imageInfo.imageView = texture->image.view;
     imageInfo.sampler = texture->sampler;
 
-    for (size_t i = 0; i < SwapChain::GetNumFrames(); i++) 
-    {
-        writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        writes[0].dstSet = model->materialDescriptors[i];
-        writes[0].dstBinding = 0;
-        writes[0].dstArrayElement = 0;
-        writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        writes[0].descriptorCount = 1;
-        writes[0].pImageInfo = &imageInfo;
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = texture->materialDescriptor;
+    write.dstBinding = 0;
+    write.dstArrayElement = 0;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.descriptorCount = 1;
+    write.pImageInfo = &imageInfo;
 
-        vkUpdateDescriptorSets(LogicalDevice::GetVkDevice(), (uint32_t)(writes.size()), writes.data(), 0, nullptr);
-    }
+    vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
 
-    model->texture = texture;
+    describedTextures.push_back(texture);
+    return texture->materialDescriptor;
 }
 
 Model* SceneManager::CreateModel() 
 {
     Model* model = new Model();
     model->name = "Default";
-    CreateModelDescriptors(model);
     return model;
 }
 
+void SceneManager::SpawnModels(uint32_t count)
+{
+    Model* source = selectedModel != nullptr && selectedModel->mesh != nullptr ? selectedModel : nullptr;
+    for (size_t i = 0; i < models.size() && source == nullptr; i++)
+    {
+        if (models[i]->mesh != nullptr)
+        {
+            source = models[i];
+        }
+    }
+    if (source == nullptr)
+    {
+        return;
+    }
+
+    uint32_t side = (uint32_t)std::ceil(std::sqrt((float)count));
+    for (uint32_t i = 0; i < count; i++)
+    {
+        glm::vec3 offset((float)(i % side) * spawnSpacing, 0.0f, (float)(i / side) * spawnSpacing);
+
+        Model* model = CreateModel();
+        model->name = source->name + " " + std::to_string(spawnedModels.size());
+        model->mesh = source->mesh;
+        SetTexture(model, source->texture);
+        model->ubo.model = glm::translate(offset) * source->ubo.model;
+        AddModel(model);
+        spawnedModels.push_back(model);
+    }
+}
+
+void SceneManager::ClearSpawnedModels(size_t keep)
+{
+    if (keep >= spawnedModels.size())
+    {
+        return;
+    }
+
+    // nothing on the gpu points at a Model, its per frame data is rewritten every frame
+    std::unordered_set<Model*> spawned(spawnedModels.begin() + keep, spawnedModels.end());
+    models.erase(std::remove_if(models.begin(), models.end(), [&](Model* model) { return spawned.count(model) != 0; }), models.end());
+    if (spawned.count(selectedModel) != 0)
+    {
+        selectedModel = nullptr;
+    }
+    for (Model* model : spawned)
+    {
+        TextureManager::Release(model->texture);
+        delete model;
+    }
+    spawnedModels.resize(keep);
+}
+
 void DirOnImgui(std::filesystem::path path) 
 {
     if (ImGui::TreeNode(path.filename().string().c_str()))
@@ -261,6 +689,36 @@ void SceneManager::OnImgui()
                 }
             }
         }
+        if (ImGui::CollapsingHeader("Stress"))
+        {
+            ImGui::Text("Models");
+            ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+            ImGui::Text("%zu (%zu spawned)", models.size(), spawnedModels.size());
+            ImGui::Text("Spawn Count");
+            ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+            ImGui::SetNextItemWidth(totalWidth * 2.0f / 5.0f);
+            ImGui::PushID("spawnCount");
+            if (ImGui::InputInt("", &spawnCount) && spawnCount < 0)
+            {
+                spawnCount = 0;
+            }
+            ImGui::PopID();
+            ImGui::Text("Spacing");
+            ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+            ImGui::SetNextItemWidth(totalWidth * 2.0f / 5.0f);
+            ImGui::PushID("spawnSpacing");
+            ImGui::DragFloat("", &spawnSpacing, 0.1f, 0.0f, 100.0f);
+            ImGui::PopID();
+            if (ImGui::Button("Spawn"))
+            {
+                SpawnModels((uint32_t)spawnCount);
+            }
+            ImGui::SameLine();
+            if (ImGui::Button("Clear"))
+            {
+                ClearSpawnedModels();
+            }
+        }
         ImGui::Text("Path");
         ImGui::SameLine(totalWidth * 3.0f / 5.0);
         ImGui::Text(path.string().c_str());
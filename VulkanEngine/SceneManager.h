@@ -1,6 +1,7 @@
 #pragma once
 
 #include <filesystem>
+#include <unordered_map>
 
 #include "Model.h"
 
@@ -11,6 +12,14 @@ struct SceneUBO
     glm::mat4 proj;
 };
 
+// per object data of the indirect path, std430 layout of ObjectData in indirect.vert
+struct ObjectData
+{
+    glm::mat4 model;
+    uint32_t textureIndex;
+    uint32_t padding[3];
+};
+
 class SceneManager 
 {
 private:
@@ -22,9 +31,60 @@ private:
     static inline std::vector<BufferResource> sceneBuffers;
     static inline std::vector<VkDescriptorSet> sceneDescriptors;
 
+    // one persistently mapped buffer holding every ModelUBO for every frame,
+    // frame i owns the slice [i * modelCapacity, (i + 1) * modelCapacity) of slots
+    static inline BufferResource modelBuffer{};
+    static inline VkDescriptorSet modelDescriptor = VK_NULL_HANDLE;
+    static inline uint32_t modelCapacity = 0;
+    static inline VkDeviceSize modelStride = 0;
+
+    // indirect path, object data and draw commands of frame i start at i * objectCapacity
+    static inline BufferResource objectBuffer{};
+    static inline BufferResource indirectBuffer{};
+    static inline std::vector<VkDescriptorSet> objectDescriptors;
+    static inline std::vector<VkDescriptorSet> textureArrayDescriptors;
+    static inline std::vector<uint32_t> drawCounts;
+    static inline uint32_t objectCapacity = 0;
+    static inline VkDeviceSize objectFrameStride = 0;
+
+    // slot of every texture in the texture array, slot 0 is the default texture,
+    // each frame's array is only written up to the slots it has already seen
+    static inline std::unordered_map<TextureResource*, uint32_t> textureSlots;
+    static inline std::vector<TextureResource*> slotTextures;
+    static inline std::vector<uint32_t> writtenSlots;
+    // slots of destroyed textures, reset to the default texture until handed out again
+    static inline std::vector<uint32_t> freeSlots;
+
+    // textures that own a material descriptor from the current pool
+    static inline std::vector<TextureResource*> describedTextures;
+    // material sets of replaced images, freed once no frame in flight can bind them
+    struct RetiredDescriptor
+    {
+        VkDescriptorSet set;
+        uint64_t frame;
+    };
+    static inline std::vector<RetiredDescriptor> retiredDescriptors;
+    static inline uint64_t frame = 0;
+
     static inline std::vector<Model*> models;
     static inline Model* selectedModel = nullptr;
 
+    // copies of an existing model used to stress the scene
+    static inline std::vector<Model*> spawnedModels;
+    static inline int spawnCount = 5000;
+    static inline float spawnSpacing = 2.0f;
+
+    static void createModelBuffer(uint32_t capacity);
+    static void destroyModelBuffer();
+    static VkDescriptorSet getMaterialDescriptor(TextureResource* texture);
+
+    static void createIndirectBuffers(uint32_t capacity);
+    static void destroyIndirectBuffers();
+    static void updateIndirect(uint32_t frameIndex);
+    static uint32_t getTextureSlot(TextureResource* texture);
+    static void lowerWrittenSlots(uint32_t slot);
+    static void writeTextureSlots(uint32_t frameIndex, uint32_t firstSlot, uint32_t count);
+
 public:
     static void Setup();
     static void Create();
@@ -32,11 +92,31 @@ public:
     static void Finish();
     static void OnImgui();
     static Model* CreateModel();
+    // the model holds a reference on its texture
     static void SetTexture(Model* model, TextureResource* texture);
+    // drops the material set and array slot of a released texture, the slot is remapped to
+    // the default texture while its image lives on until the frames in flight finish
+    static void ForgetTexture(TextureResource* texture);
+    // after textures changed samplers, the device must be idle
+    static void RewriteTextureDescriptors();
+    // the texture has a new image, frames in flight keep binding the old one
+    static void OnTextureImageChanged(TextureResource* texture);
+    static void UpdateModels(uint32_t frameIndex);
+    // instances the selected model, or the first one with a mesh, on a grid
+    static void SpawnModels(uint32_t count);
+    // removes the spawned models after the first keep
+    static void ClearSpawnedModels(size_t keep = 0);
+    // one vkCmdDrawIndexedIndirect for the whole scene, or one per model without multiDrawIndirect
+    static void DrawIndirect(VkCommandBuffer commandBuffer, uint32_t frameIndex);
 
     static inline void AddModel(Model* model) { models.push_back(model); }
     static inline BufferResource& GetUniformBuffer(uint32_t frameIndex) { return sceneBuffers[frameIndex]; }
     static inline VkDescriptorSet& GetSceneDescriptor(uint32_t frameIndex) { return sceneDescriptors[frameIndex]; }
+    static inline VkDescriptorSet& GetModelDescriptor() { return modelDescriptor; }
+    static inline VkDescriptorSet& GetObjectDescriptor(uint32_t frameIndex) { return objectDescriptors[frameIndex]; }
+    static inline VkDescriptorSet& GetTextureArrayDescriptor(uint32_t frameIndex) { return textureArrayDescriptors[frameIndex]; }
+    static inline uint32_t GetModelOffset(uint32_t frameIndex, uint32_t modelIndex) { return (uint32_t)(((VkDeviceSize)frameIndex * modelCapacity + modelIndex) * modelStride); }
     static inline std::vector<Model*>& GetModels() { return models; }
+    static inline size_t GetSpawnedCount() { return spawnedModels.size(); }
     static inline Model* GetSelectedModel() { return selectedModel; }
 };
@@ -1,5 +1,12 @@
 #include "SwapChain.h"
 
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "BufferManager.h"
+#include "Profiler.h"
+
 void SwapChain::Create()
 {
     auto device = LogicalDevice::GetVkDevice();
@@ -11,7 +18,38 @@ void SwapChain::Create()
         numSamples = PhysicalDevice::GetMaxSamples();
     }
 
+    if (Window::IsHeadless())
+    {
+        framesInFlight = newFramesInFlight;
+        additionalImages = newAdditionalImages;
+        extent = { Window::GetWidth(), Window::GetHeight() };
+
+        // rendered to like swapchain images but only ever copied out
+        colorFormat = VK_FORMAT_B8G8R8A8_UNORM;
+        if (!PhysicalDevice::SupportFormat(colorFormat, VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT))
+        {
+            colorFormat = VK_FORMAT_R8G8B8A8_UNORM;
+        }
+
+        ImageDesc offscreenDesc;
+        offscreenDesc.width = extent.width;
+        offscreenDesc.height = extent.height;
+        offscreenDesc.format = colorFormat;
+        offscreenDesc.numSamples = VK_SAMPLE_COUNT_1_BIT;
+        offscreenDesc.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        offscreenDesc.aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+
+        offscreenImages.resize(framesInFlight + additionalImages);
+        for (ImageResource& offscreen : offscreenImages)
+        {
+            ImageManager::Create(offscreenDesc, offscreen);
+            images.push_back(offscreen.image);
+            views.push_back(offscreen.view);
+        }
+        nextOffscreenImage = 0;
+    }
     // create swapchain
+    else
     {
         const auto& capabilities = PhysicalDevice::GetCapabilities();
         VkSurfaceFormatKHR surfaceFormat = chooseSurfaceFormat(PhysicalDevice::GetSurfaceFormats());
@@ -82,9 +120,14 @@ void SwapChain::Create()
 
         // here we specify a handle to when the swapchain become invalid
         // possible causes are changing settings or resizing window
-        createInfo.oldSwapchain = VK_NULL_HANDLE;
+        createInfo.oldSwapchain = oldSwapChain;
 
         auto res = vkCreateSwapchainKHR(device, &createInfo, nullptr, &swapChain);
+        if (oldSwapChain != VK_NULL_HANDLE)
+        {
+            vkDestroySwapchainKHR(device, oldSwapChain, allocator);
+            oldSwapChain = VK_NULL_HANDLE;
+        }
         if (res != VK_SUCCESS)
         {
             throw std::runtime_error("Failed to create swap chain!");
@@ -97,7 +140,7 @@ void SwapChain::Create()
 
     // create image views
     views.resize(images.size());
-    for (size_t i = 0; i < images.size(); i++) 
+    for (size_t i = 0; i < images.size() && !Window::IsHeadless(); i++) 
     {
         VkImageViewCreateInfo viewInfo{};
         viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -161,6 +204,8 @@ void SwapChain::Create()
     // create render pass
     {
         std::vector<VkAttachmentDescription> attachments;
+        // offscreen images are left ready to be copied out
+        VkImageLayout outputLayout = Window::IsHeadless() ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
         VkSubpassDescription subpass{};
         subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
@@ -173,7 +218,7 @@ void SwapChain::Create()
         colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
         colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
         colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        colorAttachment.finalLayout = outputLayout;
 
         attachments.push_back(colorAttachment);
 
@@ -213,7 +258,7 @@ void SwapChain::Create()
             colorAttachmentResolve.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
             colorAttachmentResolve.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
             colorAttachmentResolve.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-            colorAttachmentResolve.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+            colorAttachmentResolve.finalLayout = outputLayout;
 
             colorAttachmentResolveRef.attachment = 2;
             colorAttachmentResolveRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
@@ -283,29 +328,20 @@ void SwapChain::Create()
         }
     }
 
-    // create command buffers 
+    // frame contexts, one per frame in flight
     {
-        commandBuffers.resize(images.size());
+        frames.resize(framesInFlight);
+
+        // buffers are re-recorded every frame, the pool is reset as a whole instead of each buffer
+        VkCommandPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.queueFamilyIndex = PhysicalDevice::GetGraphicsFamily();
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
 
         VkCommandBufferAllocateInfo allocInfo{};
         allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-        allocInfo.commandPool = LogicalDevice::GetCommandPool();
         allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        allocInfo.commandBufferCount = (uint32_t)commandBuffers.size();
-
-        auto res = vkAllocateCommandBuffers(device, &allocInfo, commandBuffers.data());
-        if (res != VK_SUCCESS)
-        {
-            throw std::runtime_error("Failed to allocate command buffers!");
-        }
-    }
-
-    // synchronization objects
-    {
-        imageAvailableSemaphores.resize(framesInFlight);
-        renderFinishedSemaphores.resize(framesInFlight);
-        inFlightFences.resize(framesInFlight);
-        imagesInFlight.resize(images.size(), VK_NULL_HANDLE);
+        allocInfo.commandBufferCount = 1;
 
         VkSemaphoreCreateInfo semaphoreInfo{};
         semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
@@ -314,24 +350,56 @@ void SwapChain::Create()
         fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
         fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-        for (size_t i = 0; i < framesInFlight; i++) 
+        useTimeline = preferTimeline && LogicalDevice::IsTimelineSupported();
+        if (useTimeline)
+        {
+            frameTimeline = LogicalDevice::CreateTimelineSemaphore();
+            timelineValue = 0;
+        }
+
+        for (FrameContext& frame : frames) 
         {
-            auto res = vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]);
+            frame.timelineValue = 0;
+            // a pool must only be used by one thread at a time
+            frame.commandPools.resize(JobSystem::GetThreadCount() + 1);
+            frame.secondaryBuffers.resize(frame.commandPools.size());
+            frame.secondaryUsed.resize(frame.commandPools.size(), 0);
+            for (VkCommandPool& pool : frame.commandPools)
+            {
+                auto res = vkCreateCommandPool(device, &poolInfo, allocator, &pool);
+                if (res != VK_SUCCESS)
+                {
+                    throw std::runtime_error("Failed to create frame command pool!");
+                }
+            }
+
+            allocInfo.commandPool = frame.commandPools[0];
+            auto res = vkAllocateCommandBuffers(device, &allocInfo, &frame.commandBuffer);
             if (res != VK_SUCCESS)
             {
-                throw std::runtime_error("Failed to create semaphore!");
+                throw std::runtime_error("Failed to allocate command buffers!");
             }
-            res = vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]);
+            res = vkCreateSemaphore(device, &semaphoreInfo, nullptr, &frame.imageAvailable);
             if (res != VK_SUCCESS)
             {
                 throw std::runtime_error("Failed to create semaphore!");
             }
-            res = vkCreateFence(device, &fenceInfo, nullptr, &inFlightFences[i]);
+            res = vkCreateFence(device, &fenceInfo, nullptr, &frame.inFlight);
             if (res != VK_SUCCESS)
             {
                 throw std::runtime_error("Failed to create fence!");
             }
         }
+
+        renderFinished.resize(images.size());
+        for (VkSemaphore& semaphore : renderFinished)
+        {
+            auto res = vkCreateSemaphore(device, &semaphoreInfo, nullptr, &semaphore);
+            if (res != VK_SUCCESS)
+            {
+                throw std::runtime_error("Failed to create semaphore!");
+            }
+        }
     }
 
     std::cout << "Created Swapchain" << std::endl;
@@ -341,6 +409,25 @@ void SwapChain::Create()
 }
 
 void SwapChain::Destroy()
+{
+    destroyResources();
+    if (swapChain != VK_NULL_HANDLE)
+    {
+        vkDestroySwapchainKHR(LogicalDevice::GetVkDevice(), swapChain, Instance::GetAllocator());
+        swapChain = VK_NULL_HANDLE;
+    }
+}
+
+void SwapChain::Recreate()
+{
+    destroyResources();
+    // retired once the new swapchain exists
+    oldSwapChain = swapChain;
+    swapChain = VK_NULL_HANDLE;
+    Create();
+}
+
+void SwapChain::destroyResources()
 {
     auto device = LogicalDevice::GetVkDevice();
     auto allocator = Instance::GetAllocator();
@@ -351,34 +438,72 @@ void SwapChain::Destroy()
     for (int i = 0; i < images.size(); i++) 
     {
         vkDestroyFramebuffer(device, framebuffers[i], allocator);
-        vkDestroyImageView(device, views[i], allocator);
+        if (offscreenImages.empty())
+        {
+            vkDestroyImageView(device, views[i], allocator);
+        }
     }
+    // owns its view
+    for (ImageResource& offscreen : offscreenImages)
+    {
+        ImageManager::Destroy(offscreen);
+    }
+    offscreenImages.clear();
 
-    for (int i = 0; i < framesInFlight; i++)
+    for (FrameContext& frame : frames)
     {
-        vkDestroySemaphore(device, imageAvailableSemaphores[i], allocator);
-        vkDestroySemaphore(device, renderFinishedSemaphores[i], allocator);
-        vkDestroyFence(device, inFlightFences[i], allocator);
+        vkDestroySemaphore(device, frame.imageAvailable, allocator);
+        vkDestroyFence(device, frame.inFlight, allocator);
+        // frees every buffer allocated from them
+        for (VkCommandPool pool : frame.commandPools)
+        {
+            vkDestroyCommandPool(device, pool, allocator);
+        }
     }
 
-    vkFreeCommandBuffers(device, LogicalDevice::GetCommandPool(), (uint32_t)commandBuffers.size(), commandBuffers.data());
+    if (frameTimeline != VK_NULL_HANDLE)
+    {
+        vkDestroySemaphore(device, frameTimeline, allocator);
+        frameTimeline = VK_NULL_HANDLE;
+    }
 
     vkDestroyRenderPass(device, renderPass, allocator);
-    vkDestroySwapchainKHR(device, swapChain, allocator);
 
-    imageAvailableSemaphores.clear();
-    renderFinishedSemaphores.clear();
-    inFlightFences.clear();
-    imagesInFlight.clear();
-    commandBuffers.clear();
+    for (VkSemaphore semaphore : renderFinished)
+    {
+        vkDestroySemaphore(device, semaphore, allocator);
+    }
+
+    frames.clear();
+    renderFinished.clear();
 
     framebuffers.clear();
     views.clear();
     images.clear();
-    swapChain = VK_NULL_HANDLE;
     renderPass = VK_NULL_HANDLE;
 }
 
+void SwapChain::RecordRecreate(float ms, const char* mode)
+{
+    lastRecreateMs = ms;
+    lastRecreateMode = mode;
+
+    if (benchmarkRuns > 0)
+    {
+        benchmarkTotalMs += ms;
+        benchmarkDone++;
+        benchmarkRuns--;
+        if (benchmarkRuns > 0)
+        {
+            dirty = true;
+        }
+        else
+        {
+            std::cout << "Swapchain recreation (" << mode << "): " << benchmarkTotalMs / benchmarkDone << " ms average over " << benchmarkDone << " runs" << std::endl;
+        }
+    }
+}
+
 void SwapChain::OnImgui()
 {
     const auto totalSpace = ImGui::GetContentRegionAvail();
@@ -440,6 +565,64 @@ void SwapChain::OnImgui()
             }
             ImGui::PopID();
         }
+        // Frame Contexts
+        {
+            ImGui::Text("Frame Contexts");
+            ImGui::SameLine(totalWidth * 3.0 / 5.0f);
+            ImGui::Text("%zu for %zu images", frames.size(), images.size());
+            ImGui::Text("Command Pools");
+            ImGui::SameLine(totalWidth * 3.0 / 5.0f);
+            ImGui::Text("%zu per frame", frames.empty() ? (size_t)0 : frames[0].commandPools.size());
+        }
+        // Frame Pacing
+        {
+            ImGui::Text("Timeline Semaphores");
+            ImGui::SameLine(totalWidth * 3.0 / 5.0f);
+            if (LogicalDevice::IsTimelineSupported())
+            {
+                ImGui::PushID("preferTimeline");
+                if (ImGui::Checkbox("", &preferTimeline))
+                {
+                    dirty = true;
+                }
+                ImGui::PopID();
+            }
+            else
+            {
+                ImGui::Text("Unsupported");
+            }
+
+            struct History
+            {
+                const char* name;
+                const float* values;
+            };
+            const History histories[] =
+            {
+                { "Frame Wait", frameWaitHistory },
+                { "Acquire", acquireHistory },
+                { "Acquire To Present", latencyHistory },
+            };
+            for (const History& history : histories)
+            {
+                float average = 0.0f;
+                float peak = 0.0f;
+                for (int i = 0; i < historySize; i++)
+                {
+                    average += history.values[i];
+                    peak = std::max(peak, history.values[i]);
+                }
+                average /= historySize;
+
+                char overlay[64];
+                snprintf(overlay, sizeof(overlay), "avg %.2f ms, max %.2f ms", average, peak);
+                ImGui::Text("%s", history.name);
+                ImGui::SameLine(totalWidth * 3.0 / 5.0f);
+                ImGui::PushID(history.name);
+                ImGui::PlotLines("", history.values, historySize, historyOffset, overlay, 0.0f, std::max(peak, 1.0f), ImVec2(totalWidth * 2.0f / 5.0f, 40.0f));
+                ImGui::PopID();
+            }
+        }
         // Present Mode
         {
             ImGui::Text("Present Mode");
@@ -490,6 +673,33 @@ void SwapChain::OnImgui()
             }
             ImGui::PopID();
         }
+        // Recreation
+        {
+            ImGui::Text("Force Full Recreate");
+            ImGui::SameLine(totalWidth * 3.0 / 5.0f);
+            ImGui::PushID("forceFullRecreate");
+            ImGui::Checkbox("", &forceFullRecreate);
+            ImGui::PopID();
+            ImGui::Text("Last Recreate");
+            ImGui::SameLine(totalWidth * 3.0 / 5.0f);
+            ImGui::Text("%.2f ms (%s)", lastRecreateMs, lastRecreateMode);
+            ImGui::Text("Benchmark");
+            ImGui::SameLine(totalWidth * 3.0 / 5.0f);
+            ImGui::PushID("recreateBenchmark");
+            if (ImGui::Button("Recreate x20") && benchmarkRuns == 0)
+            {
+                benchmarkRuns = 20;
+                benchmarkDone = 0;
+                benchmarkTotalMs = 0.0f;
+                dirty = true;
+            }
+            ImGui::PopID();
+            if (benchmarkDone > 0)
+            {
+                ImGui::SameLine();
+                ImGui::Text("%.2f ms avg", benchmarkTotalMs / benchmarkDone);
+            }
+        }
         // Surface Format
         {
             if (ImGui::TreeNode("Surface Format")) 
@@ -519,12 +729,39 @@ void SwapChain::OnImgui()
 
 uint32_t SwapChain::Acquire()
 {
+    PROFILE_FUNCTION();
     auto device = LogicalDevice::GetVkDevice();
 
-    vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+    FrameContext& frame = frames[currentFrame];
+
+    // once this signals, everything the context owns can be rewritten
+    auto waitStart = std::chrono::high_resolution_clock::now();
+    if (useTimeline)
+    {
+        LogicalDevice::WaitTimeline(frameTimeline, frame.timelineValue);
+    }
+    else
+    {
+        vkWaitForFences(device, 1, &frame.inFlight, VK_TRUE, UINT64_MAX);
+    }
+    acquireStart = std::chrono::high_resolution_clock::now();
+    frameWaitHistory[historyOffset] = std::chrono::duration<float, std::milli>(acquireStart - waitStart).count();
+
+    ResetFrame(currentFrame);
+
+    if (Window::IsHeadless())
+    {
+        // there are at least framesInFlight images, so the frame that last rendered
+        // into this one already waited above
+        uint32_t imageIndex = nextOffscreenImage;
+        nextOffscreenImage = (nextOffscreenImage + 1) % (uint32_t)images.size();
+        acquireHistory[historyOffset] = 0.0f;
+        return imageIndex;
+    }
 
     uint32_t imageIndex;
-    auto res = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+    auto res = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, frame.imageAvailable, VK_NULL_HANDLE, &imageIndex);
+    acquireHistory[historyOffset] = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - acquireStart).count();
 
     if (res == VK_ERROR_OUT_OF_DATE_KHR) 
     {
@@ -535,45 +772,114 @@ uint32_t SwapChain::Acquire()
         throw std::runtime_error("Failed to acquire swap chain image!");
     }
 
+    // nothing but the framebuffer is indexed by the image, the acquire semaphore
+    // already orders the render pass after the previous present of it
     return imageIndex;
 }
 
-void SwapChain::SubmitAndPresent(uint32_t imageIndex)
+void SwapChain::ResetFrame(uint32_t frame)
 {
     auto device = LogicalDevice::GetVkDevice();
 
-    // check if a previous frame is using this image
-    if (imagesInFlight[imageIndex] != VK_NULL_HANDLE) 
+    FrameContext& context = frames[frame];
+    for (VkCommandPool pool : context.commandPools)
     {
-        vkWaitForFences(device, 1, &imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
+        vkResetCommandPool(device, pool, 0);
     }
+    std::fill(context.secondaryUsed.begin(), context.secondaryUsed.end(), 0);
+}
 
-    // mark the image as now being in use by this frame
-    imagesInFlight[imageIndex] = inFlightFences[currentFrame];
+VkCommandBuffer SwapChain::GetSecondaryCommandBuffer(uint32_t frame)
+{
+    // only the calling thread touches its slot, no locking needed
+    uint32_t thread = JobSystem::GetThreadIndex();
+    FrameContext& context = frames[frame];
+    std::vector<VkCommandBuffer>& buffers = context.secondaryBuffers[thread];
+    uint32_t& used = context.secondaryUsed[thread];
+
+    if (used == buffers.size())
+    {
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = context.commandPools[thread];
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        allocInfo.commandBufferCount = 1;
+
+        VkCommandBuffer commandBuffer;
+        auto res = vkAllocateCommandBuffers(LogicalDevice::GetVkDevice(), &allocInfo, &commandBuffer);
+        if (res != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to allocate secondary command buffer!");
+        }
+        buffers.push_back(commandBuffer);
+    }
+    return buffers[used++];
+}
+
+void SwapChain::SubmitAndPresent(uint32_t imageIndex)
+{
+    PROFILE_FUNCTION();
+    auto device = LogicalDevice::GetVkDevice();
+
+    FrameContext& frame = frames[currentFrame];
 
     VkSubmitInfo submitInfo{};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-    VkSemaphore waitSemaphores[] = { imageAvailableSemaphores[currentFrame] };
+    // offscreen images are not acquired or presented, nothing to wait on or signal for them
+    const bool present = !Window::IsHeadless();
+
+    VkSemaphore waitSemaphores[] = { frame.imageAvailable };
     VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-    submitInfo.waitSemaphoreCount = 1;
+    submitInfo.waitSemaphoreCount = present ? 1 : 0;
     submitInfo.pWaitSemaphores = waitSemaphores;
     submitInfo.pWaitDstStageMask = waitStages;
     submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &(commandBuffers[imageIndex]);
-
-    VkSemaphore signalSemaphores[] = { renderFinishedSemaphores[currentFrame] };
-    submitInfo.signalSemaphoreCount = 1;
-    submitInfo.pSignalSemaphores = signalSemaphores;
-
-    vkResetFences(device, 1, &inFlightFences[currentFrame]);
+    submitInfo.pCommandBuffers = &frame.commandBuffer;
+
+    // present only takes the binary semaphore, the timeline one is signaled next to it
+    VkSemaphore signalSemaphores[] = { renderFinished[imageIndex], frameTimeline };
+    submitInfo.signalSemaphoreCount = present ? 1 : 0;
+    submitInfo.pSignalSemaphores = present ? signalSemaphores : signalSemaphores + 1;
+
+    VkFence fence = frame.inFlight;
+    uint64_t waitValues[] = { 0 };
+    uint64_t signalValues[] = { 0, timelineValue + 1 };
+    VkTimelineSemaphoreSubmitInfoKHR timelineInfo{};
+    if (useTimeline)
+    {
+        timelineValue++;
+        frame.timelineValue = timelineValue;
+
+        // binary semaphores ignore their values but the arrays must cover them
+        timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+        timelineInfo.waitSemaphoreValueCount = submitInfo.waitSemaphoreCount;
+        timelineInfo.pWaitSemaphoreValues = waitValues;
+        timelineInfo.signalSemaphoreValueCount = present ? 2 : 1;
+        timelineInfo.pSignalSemaphoreValues = present ? signalValues : signalValues + 1;
+        submitInfo.pNext = &timelineInfo;
+        submitInfo.signalSemaphoreCount = present ? 2 : 1;
+        fence = VK_NULL_HANDLE;
+    }
+    else
+    {
+        vkResetFences(device, 1, &frame.inFlight);
+    }
 
-    auto res = vkQueueSubmit(LogicalDevice::GetGraphicsQueue(), 1, &submitInfo, inFlightFences[currentFrame]);
+    auto res = vkQueueSubmit(LogicalDevice::GetGraphicsQueue(), 1, &submitInfo, fence);
     if (res != VK_SUCCESS)
     {
         throw std::runtime_error("Failed to submit draw command buffer!");
     }
 
+    if (!present)
+    {
+        latencyHistory[historyOffset] = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - acquireStart).count();
+        historyOffset = (historyOffset + 1) % historySize;
+        currentFrame = (currentFrame + 1) % framesInFlight;
+        return;
+    }
+
     VkPresentInfoKHR presentInfo{};
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
     presentInfo.waitSemaphoreCount = 1;
@@ -587,6 +893,9 @@ void SwapChain::SubmitAndPresent(uint32_t imageIndex)
 
     res = vkQueuePresentKHR(LogicalDevice::GetPresentQueue(), &presentInfo);
 
+    latencyHistory[historyOffset] = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - acquireStart).count();
+    historyOffset = (historyOffset + 1) % historySize;
+
     if (res == VK_ERROR_OUT_OF_DATE_KHR || res == VK_SUBOPTIMAL_KHR) 
     {
         dirty = true;
@@ -600,6 +909,67 @@ void SwapChain::SubmitAndPresent(uint32_t imageIndex)
     currentFrame = (currentFrame + 1) % framesInFlight;
 }
 
+void SwapChain::ReadImage(uint32_t imageIndex, std::vector<uint8_t>& pixels)
+{
+    if (offscreenImages.empty())
+    {
+        throw std::runtime_error("Only offscreen images can be read back!");
+    }
+
+    VkDeviceSize size = (VkDeviceSize)extent.width * extent.height * 4;
+
+    BufferDescriptor readbackDesc;
+    readbackDesc.size = size;
+    readbackDesc.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    readbackDesc.properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+    BufferResource readback;
+    BufferManager::Create(readbackDesc, readback);
+
+    auto commandBuffer = LogicalDevice::BeginSingleTimeCommands();
+
+    // the render pass already left it in the transfer layout, only the writes need to be made visible
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = images[imageIndex];
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.layerCount = 1;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    VkBufferImageCopy region{};
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.layerCount = 1;
+    region.imageExtent = { extent.width, extent.height, 1 };
+    vkCmdCopyImageToBuffer(commandBuffer, images[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readback.buffer, 1, &region);
+
+    VkMemoryBarrier hostBarrier{};
+    hostBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &hostBarrier, 0, nullptr, 0, nullptr);
+
+    LogicalDevice::EndSingleTimeCommands(commandBuffer);
+
+    pixels.resize(size);
+    memcpy(pixels.data(), readback.mapped, size);
+    BufferManager::Destroy(readback);
+
+    if (colorFormat == VK_FORMAT_B8G8R8A8_UNORM)
+    {
+        for (size_t i = 0; i < pixels.size(); i += 4)
+        {
+            std::swap(pixels[i], pixels[i + 2]);
+        }
+    }
+}
+
 VkExtent2D SwapChain::chooseExtent(const VkSurfaceCapabilitiesKHR& capabilities)
 {
     if (capabilities.currentExtent.width != UINT32_MAX) 
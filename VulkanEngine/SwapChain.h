@@ -1,47 +1,90 @@
 #pragma once
 
 #include <vulkan/vulkan.h>
+#include <chrono>
 #include <vector>
 #include "ImageManager.h"
+#include "JobSystem.h"
 #include "LogicalDevice.h"
 #include "PhysicalDevice.h"
 #include "Window.h"
 #include "Instance.h"
 #include "VulkanUtils.h"
 
+// everything one frame in flight records into and waits on, reused once its fence signals
+// the ring is sized by framesInFlight, independent of how many images the swapchain has
+struct FrameContext
+{
+    // one transient pool per recording thread, all reset together when the fence signals
+    std::vector<VkCommandPool> commandPools;
+    // primary buffer, allocated from the main thread's pool
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    // secondary buffers of each thread, handed out again after every reset
+    std::vector<std::vector<VkCommandBuffer>> secondaryBuffers;
+    std::vector<uint32_t> secondaryUsed;
+    VkSemaphore imageAvailable = VK_NULL_HANDLE;
+    VkFence inFlight = VK_NULL_HANDLE;
+    // value of the frame timeline signaled by the last submit, replaces the fence on the timeline path
+    uint64_t timelineValue = 0;
+};
+
 class SwapChain
 {
 public:
     static void Create();
     static void Destroy();
+    // rebuilds the swapchain and its images, the old swapchain is handed to the driver
+    // so in flight presents can finish, render pass compatibility is unchanged unless
+    // the format or sample count changed
+    static void Recreate();
 
     static void OnImgui();
 
+    // recreation latency measured by the caller, which also rebuilds what depends on the swapchain
+    static void RecordRecreate(float ms, const char* mode);
+
+    // waits for the current frame context to be free, then acquires an image for it
     static uint32_t Acquire();
     static void SubmitAndPresent(uint32_t imageIndex);
+    // resets every pool of the frame, only valid while nothing recorded from them is pending
+    static void ResetFrame(uint32_t frame);
+    // secondary buffer from the calling thread's pool, in the initial state
+    static VkCommandBuffer GetSecondaryCommandBuffer(uint32_t frame);
+    // copies a rendered offscreen image to rgba8 pixels and waits for it, headless only
+    static void ReadImage(uint32_t imageIndex, std::vector<uint8_t>& pixels);
      
     static inline bool IsDirty() { return dirty; }
+    static inline bool IsFullRecreateForced() { return forceFullRecreate; }
     static inline VkExtent2D GetExtent() { return extent; }
     static inline uint32_t GetNumFrames() { return images.size(); }
     static inline uint32_t GetFramesInFlight() { return framesInFlight; }
+    // index of the frame context being recorded, per frame data is indexed by this, not by the image
+    static inline uint32_t GetCurrentFrame() { return currentFrame; }
     static inline VkRenderPass GetRenderPass() { return renderPass; }
     static inline VkSwapchainKHR GetVkSwapChain() { return swapChain; }
     static inline VkSampleCountFlagBits GetNumSamples() { return numSamples; }
+    static inline VkFormat GetColorFormat() { return colorFormat; }
+    static inline VkFormat GetDepthFormat() { return depthFormat; }
     static inline VkFramebuffer GetFramebuffer(size_t i) { return framebuffers[i]; }
-    static inline VkCommandBuffer GetCommandBuffer(uint32_t i) { return commandBuffers[i]; }
+    static inline VkCommandBuffer GetCommandBuffer(uint32_t frame) { return frames[frame].commandBuffer; }
+    // pool of the calling thread for the frame, buffers allocated from it are valid until the frame comes around again
+    static inline VkCommandPool GetCommandPool(uint32_t frame) { return frames[frame].commandPools[JobSystem::GetThreadIndex()]; }
 
 private:
     static inline VkSwapchainKHR swapChain = VK_NULL_HANDLE;
+    static inline VkSwapchainKHR oldSwapChain = VK_NULL_HANDLE;
     static inline VkRenderPass renderPass = VK_NULL_HANDLE;
     static inline std::vector<VkImage> images;
     static inline std::vector<VkImageView> views;
     static inline std::vector<VkFramebuffer> framebuffers;
+    // headless only, stand in for the swapchain images and are handed out round robin
+    static inline std::vector<ImageResource> offscreenImages;
+    static inline uint32_t nextOffscreenImage = 0;
 
-    static inline std::vector<VkCommandBuffer> commandBuffers;
-    static inline std::vector<VkSemaphore> imageAvailableSemaphores;
-    static inline std::vector<VkSemaphore> renderFinishedSemaphores;
-    static inline std::vector<VkFence> inFlightFences;
-    static inline std::vector<VkFence> imagesInFlight;
+    static inline std::vector<FrameContext> frames;
+    // signaled by the submit and waited on by the present of each image, indexed by the image
+    // since a frame context can come around again before the present using its semaphore is done
+    static inline std::vector<VkSemaphore> renderFinished;
             
     static inline ImageResource colorRes;
     static inline ImageResource depthRes;
@@ -54,6 +97,29 @@ private:
     static inline int newAdditionalImages = 0;
     static inline int newFramesInFlight= 2;
     static inline bool dirty = true;
+
+    // binary fences per frame, or one timeline semaphore counting submitted frames
+    static inline bool preferTimeline = true;
+    static inline bool useTimeline = false;
+    static inline VkSemaphore frameTimeline = VK_NULL_HANDLE;
+    static inline uint64_t timelineValue = 0;
+
+    // rolling cpu timings, in ms: waiting for the frame context, blocking in acquire,
+    // and from acquire to the present call returning
+    static constexpr int historySize = 120;
+    static inline float frameWaitHistory[historySize] = {};
+    static inline float acquireHistory[historySize] = {};
+    static inline float latencyHistory[historySize] = {};
+    static inline int historyOffset = 0;
+    static inline std::chrono::high_resolution_clock::time_point acquireStart;
+
+    static inline bool forceFullRecreate = false;
+    static inline float lastRecreateMs = 0.0f;
+    static inline const char* lastRecreateMode = "None";
+    // recreations left in the running benchmark, each one marks the swapchain dirty again
+    static inline uint32_t benchmarkRuns = 0;
+    static inline uint32_t benchmarkDone = 0;
+    static inline float benchmarkTotalMs = 0.0f;
             
     // preferred, warn if not available
     static inline VkFormat colorFormat = VK_FORMAT_B8G8R8A8_UNORM;
@@ -61,6 +127,7 @@ private:
     static inline VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
     static inline VkSampleCountFlagBits numSamples = VK_SAMPLE_COUNT_64_BIT;
      
+    static void destroyResources();
     static VkExtent2D chooseExtent(const VkSurfaceCapabilitiesKHR& capabilities);
     static VkPresentModeKHR choosePresentMode(const std::vector<VkPresentModeKHR>& presentModes);
     static VkSurfaceFormatKHR chooseSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& formats);
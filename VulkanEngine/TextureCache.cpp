@@ -0,0 +1,316 @@
+#include "TextureCache.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#include "AssetManager.h"
+#include "JobSystem.h"
+#include "MipGenerator.h"
+
+static std::string Lower(std::string text)
+{
+    std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+    return text;
+}
+
+std::filesystem::path TextureCache::GetCachePath(const std::filesystem::path& source)
+{
+    std::filesystem::path cachePath = source;
+    cachePath += ".tex";
+    return cachePath;
+}
+
+bool TextureCache::Load(const std::filesystem::path& source, CookedTexture& texture)
+{
+    std::shared_ptr<MappedFile> file = MappedFile::Open(GetCachePath(source).string());
+    if (file == nullptr || file->GetSize() < sizeof(Header))
+    {
+        return false;
+    }
+
+    const char* data = file->GetData();
+    const size_t size = file->GetSize();
+
+    Header header;
+    memcpy(&header, data, sizeof(Header));
+    if (memcmp(header.magic, magic, sizeof(magic)) != 0 || header.version != version)
+    {
+        return false;
+    }
+    if (header.levelCount == 0 || header.levelCount > 32 || sizeof(Header) + header.levelCount * sizeof(LevelEntry) > size)
+    {
+        return false;
+    }
+
+    // a missing source is fine, the cooked file can ship on its own
+    std::error_code error;
+    if (std::filesystem::exists(source, error))
+    {
+        if (std::filesystem::file_size(source, error) != header.sourceSize)
+        {
+            return false;
+        }
+        // the write time changes on copies and checkouts, only then pay for hashing
+        if (FileManager::GetWriteTime(source.string()) != header.sourceTime)
+        {
+            std::shared_ptr<MappedFile> sourceFile = MappedFile::Open(source.string());
+            if (sourceFile == nullptr || FileManager::Hash(sourceFile->GetData(), sourceFile->GetSize()) != header.sourceHash)
+            {
+                return false;
+            }
+        }
+    }
+
+    std::vector<LevelEntry> entries(header.levelCount);
+    memcpy(entries.data(), data + sizeof(Header), header.levelCount * sizeof(LevelEntry));
+
+    // levels are uploaded with one copy, so they are addressed from the first one
+    const uint64_t first = entries[0].offset;
+    uint64_t end = first;
+    CookedTexture cooked;
+    cooked.levels.resize(header.levelCount);
+    for (uint32_t i = 0; i < header.levelCount; i++)
+    {
+        const LevelEntry& entry = entries[i];
+        if (entry.offset < first || entry.offset + entry.size > size)
+        {
+            return false;
+        }
+        end = std::max(end, entry.offset + entry.size);
+
+        ImageLevel& level = cooked.levels[i];
+        level.offset = entry.offset - first;
+        level.size = entry.size;
+        level.width = std::max(1u, header.width >> i);
+        level.height = std::max(1u, header.height >> i);
+    }
+
+    cooked.format = (VkFormat)header.format;
+    cooked.width = header.width;
+    cooked.height = header.height;
+    cooked.sourceHash = header.sourceHash;
+    cooked.pixelHash = header.pixelHash;
+    cooked.data = data + first;
+    cooked.size = end - first;
+    cooked.file = file;
+
+    texture = std::move(cooked);
+    return true;
+}
+
+bool TextureCache::IsNormalMap(const std::filesystem::path& source)
+{
+    // sponza names its tangent space normal maps *_ddn
+    std::string stem = Lower(source.stem().string());
+    return stem.find("_ddn") != std::string::npos || stem.find("_normal") != std::string::npos || stem.find("_nrm") != std::string::npos;
+}
+
+std::vector<std::filesystem::path> TextureCache::FindImages(const std::filesystem::path& directory)
+{
+    static const char* extensions[] = { ".png", ".jpg", ".jpeg", ".tga", ".bmp" };
+
+    std::vector<std::filesystem::path> images;
+    std::error_code error;
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(directory, error))
+    {
+        std::string extension = Lower(entry.path().extension().string());
+        if (entry.is_regular_file() && std::find(std::begin(extensions), std::end(extensions), extension) != std::end(extensions))
+        {
+            images.push_back(entry.path());
+        }
+    }
+    return images;
+}
+
+BlockFormat TextureCache::ChooseFormat(const std::filesystem::path& source, const uint8_t* rgba, size_t pixelCount, bool highQuality)
+{
+    if (IsNormalMap(source))
+    {
+        return BlockFormat::BC5;
+    }
+    if (highQuality)
+    {
+        return BlockFormat::BC7;
+    }
+
+    for (size_t i = 0; i < pixelCount; i++)
+    {
+        if (rgba[i * 4 + 3] != 255)
+        {
+            return BlockFormat::BC3;
+        }
+    }
+    return BlockFormat::BC1;
+}
+
+bool TextureCache::Cook(const std::filesystem::path& source, bool highQuality, TextureCookStats* stats, bool verify)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    std::shared_ptr<MappedFile> sourceFile = MappedFile::Open(source.string());
+    if (sourceFile == nullptr)
+    {
+        return false;
+    }
+
+    int width, height;
+    unsigned char* pixels = AssetManager::DecodeImageFile(source, width, height);
+    if (pixels == nullptr)
+    {
+        std::cerr << "Failed to load image file " << source.string() << std::endl;
+        return false;
+    }
+    BlockFormat format = ChooseFormat(source, pixels, (size_t)width * height, highQuality);
+    const uint64_t pixelHash = FileManager::Hash(pixels, (size_t)width * height * 4);
+
+    MipChain chain;
+    MipGenerator::Generate(pixels, (uint32_t)width, (uint32_t)height, !IsNormalMap(source), chain);
+    AssetManager::FreeImage(pixels);
+
+    Header header{};
+    memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    header.sourceSize = sourceFile->GetSize();
+    header.sourceTime = FileManager::GetWriteTime(source.string());
+    header.sourceHash = FileManager::Hash(sourceFile->GetData(), sourceFile->GetSize());
+    header.pixelHash = pixelHash;
+    header.format = (uint32_t)BlockCompressor::GetVkFormat(format);
+    header.width = (uint32_t)width;
+    header.height = (uint32_t)height;
+    header.levelCount = (uint32_t)chain.levels.size();
+
+    std::vector<char> out;
+    auto write = [&out](const void* src, size_t bytes)
+    {
+        out.insert(out.end(), (const char*)src, (const char*)src + bytes);
+    };
+    auto align = [&out]()
+    {
+        out.resize((out.size() + 15) / 16 * 16, 0);
+    };
+
+    write(&header, sizeof(header));
+    // patched once the levels are placed
+    std::vector<LevelEntry> entries(header.levelCount);
+    const size_t entriesPosition = out.size();
+    write(entries.data(), entries.size() * sizeof(LevelEntry));
+
+    // BC1 is written as an rgb format and BC5 only keeps red and green
+    const uint32_t channels = format == BlockFormat::BC1 ? 3 : format == BlockFormat::BC5 ? 2 : 4;
+    std::vector<uint8_t> decoded;
+    double squaredError = 0.0;
+    size_t samples = 0;
+
+    size_t rgbaBytes = 0;
+    for (uint32_t i = 0; i < header.levelCount; i++)
+    {
+        const ImageLevel& level = chain.levels[i];
+        const uint8_t* rgba = chain.data.data() + level.offset;
+        align();
+        entries[i].offset = out.size();
+        entries[i].size = BlockCompressor::GetCompressedSize(format, level.width, level.height);
+        out.resize(out.size() + entries[i].size);
+        BlockCompressor::Compress(format, rgba, level.width, level.height, (uint8_t*)out.data() + entries[i].offset);
+        rgbaBytes += level.size;
+
+        if (verify)
+        {
+            decoded.resize((size_t)level.size);
+            BlockCompressor::Decompress(format, (const uint8_t*)out.data() + entries[i].offset, level.width, level.height, decoded.data());
+            for (size_t t = 0; t < (size_t)level.width * level.height; t++)
+            {
+                for (uint32_t c = 0; c < channels; c++)
+                {
+                    double d = (double)rgba[t * 4 + c] - decoded[t * 4 + c];
+                    squaredError += d * d;
+                }
+            }
+            samples += (size_t)level.width * level.height * channels;
+        }
+    }
+    memcpy(out.data() + entriesPosition, entries.data(), entries.size() * sizeof(LevelEntry));
+
+    if (!FileManager::WriteRawBytes(GetCachePath(source).string(), out.data(), out.size()))
+    {
+        std::cerr << "Failed to write texture cache for " << source.string() << std::endl;
+        return false;
+    }
+
+    if (stats != nullptr)
+    {
+        auto end = std::chrono::high_resolution_clock::now();
+        stats->format = format;
+        stats->width = header.width;
+        stats->height = header.height;
+        stats->rgbaBytes = rgbaBytes;
+        stats->cookedBytes = out.size();
+        stats->ms = std::chrono::duration<float, std::milli>(end - start).count();
+        // a lossless chain has no error, reported as infinity
+        stats->psnr = verify ? (float)(10.0 * std::log10(255.0 * 255.0 * samples / squaredError)) : 0.0f;
+    }
+    return true;
+}
+
+void TextureCache::CookDirectory(const std::filesystem::path& directory, bool highQuality, bool verify)
+{
+    std::vector<std::filesystem::path> sources = FindImages(directory);
+    if (sources.empty())
+    {
+        std::cerr << "No images to cook under " << directory.string() << std::endl;
+        return;
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    std::vector<TextureCookStats> stats(sources.size());
+    std::vector<uint8_t> cooked(sources.size(), 0);
+    JobSystem::ParallelFor((uint32_t)sources.size(), [&](uint32_t i)
+    {
+        cooked[i] = Cook(sources[i], highQuality, &stats[i], verify) ? 1 : 0;
+    });
+
+    auto end = std::chrono::high_resolution_clock::now();
+
+    size_t rgbaBytes = 0;
+    size_t cookedBytes = 0;
+    uint32_t cookedCount = 0;
+    size_t worst = sources.size();
+    for (size_t i = 0; i < sources.size(); i++)
+    {
+        if (!cooked[i])
+        {
+            std::cout << "  failed " << sources[i].filename().string() << std::endl;
+            continue;
+        }
+        const TextureCookStats& s = stats[i];
+        std::cout << "  " << sources[i].filename().string() << " " << s.width << "x" << s.height
+            << " " << BlockCompressor::GetName(s.format)
+            << " " << s.rgbaBytes / 1024 << " KB -> " << s.cookedBytes / 1024 << " KB"
+            << " in " << s.ms << " ms";
+        if (verify)
+        {
+            std::cout << ", PSNR " << s.psnr << " dB";
+            if (worst == sources.size() || s.psnr < stats[worst].psnr)
+            {
+                worst = i;
+            }
+        }
+        std::cout << std::endl;
+        rgbaBytes += s.rgbaBytes;
+        cookedBytes += s.cookedBytes;
+        cookedCount++;
+    }
+
+    float ms = std::chrono::duration<float, std::milli>(end - start).count();
+    std::cout << "Cooked " << cookedCount << " of " << sources.size() << " textures in " << ms << " ms on " << JobSystem::GetThreadCount() + 1 << " threads"
+        << ", " << rgbaBytes / (1024.0f * 1024.0f) << " MB rgba8 -> " << cookedBytes / (1024.0f * 1024.0f) << " MB"
+        << " (" << (cookedBytes > 0 ? (float)rgbaBytes / cookedBytes : 0.0f) << "x)" << std::endl;
+    if (worst != sources.size())
+    {
+        std::cout << "Lowest PSNR " << stats[worst].psnr << " dB for " << sources[worst].filename().string() << std::endl;
+    }
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "BlockCompressor.h"
+#include "FileManager.h"
+#include "ImageManager.h"
+
+// a block compressed mip chain, ready for ImageManager::Create
+struct CookedTexture
+{
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint64_t sourceHash = 0;
+    // of the decoded rgba level 0, the same content hash the decode path computes
+    uint64_t pixelHash = 0;
+    // level offsets are relative to data, which points into the mapped file
+    std::vector<ImageLevel> levels;
+    const char* data = nullptr;
+    VkDeviceSize size = 0;
+    std::shared_ptr<MappedFile> file;
+};
+
+struct TextureCookStats
+{
+    BlockFormat format = BlockFormat::BC1;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    // the whole mip chain, as rgba8 and as written
+    size_t rgbaBytes = 0;
+    size_t cookedBytes = 0;
+    float ms = 0.0f;
+    // over every level and the channels the format keeps, only when verified
+    float psnr = 0.0f;
+};
+
+// cooked texture written next to a source image as "<source>.tex"
+// layout follows KTX2: header, level index with the byte offset and length of every level,
+// then the 16 byte aligned levels, largest first, keyed on the source like MeshCache
+class TextureCache
+{
+public:
+    static std::filesystem::path GetCachePath(const std::filesystem::path& source);
+
+    // false when there is no cache or the source changed since it was cooked
+    static bool Load(const std::filesystem::path& source, CookedTexture& texture);
+    // decodes the source, builds the mip chain on the cpu and compresses every level,
+    // verify decodes every block again and compares it to the uncompressed chain
+    static bool Cook(const std::filesystem::path& source, bool highQuality, TextureCookStats* stats = nullptr, bool verify = false);
+    // BC5 for normal maps by name, BC3 for images with alpha and BC1 for the rest,
+    // highQuality picks BC7 for everything but normal maps
+    static BlockFormat ChooseFormat(const std::filesystem::path& source, const uint8_t* rgba, size_t pixelCount, bool highQuality);
+    // by name, normal maps are not sRGB and get BC5
+    static bool IsNormalMap(const std::filesystem::path& source);
+    // every image file under the directory, recursively
+    static std::vector<std::filesystem::path> FindImages(const std::filesystem::path& directory);
+    // cooks every image under the directory on the JobSystem, printed to the console
+    static void CookDirectory(const std::filesystem::path& directory, bool highQuality, bool verify = false);
+
+private:
+    static constexpr char magic[4] = { 'V', 'E', 'T', 'C' };
+    // 2 filters the levels in linear light, 3 adds the pixel hash
+    static constexpr uint32_t version = 3;
+
+    struct Header
+    {
+        char magic[4];
+        uint32_t version;
+        uint64_t sourceSize;
+        int64_t sourceTime;
+        uint64_t sourceHash;
+        uint64_t pixelHash;
+        uint32_t format;
+        uint32_t width;
+        uint32_t height;
+        uint32_t levelCount;
+    };
+
+    struct LevelEntry
+    {
+        uint64_t offset;
+        uint64_t size;
+    };
+};
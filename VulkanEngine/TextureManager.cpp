@@ -1,29 +1,79 @@
 #include "TextureManager.h"
 
 #include "AssetManager.h"
+#include "JobSystem.h"
+#include "MipGenerator.h"
+#include "SceneManager.h"
+#include "SwapChain.h"
+#include "TextureCache.h"
+#include "TextureStreamer.h"
+#include "UploadManager.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+#include "imgui/imgui.h"
 
 void TextureManager::Create()
 {
-    TextureResource* newTexture = AssetManager::LoadImageFile(defaultTexture->path);
-    defaultTexture->image = newTexture->image;
-    defaultTexture->sampler = newTexture->sampler;
-    if (textures[textures.size() - 1] != newTexture)
+    // the resources outlive the device, only their images and samplers are recreated
+    reload(defaultTexture);
+    for (TextureResource* texture : textures)
     {
-        throw std::runtime_error("New texture is different than last texture on buffer!");
+        reload(texture);
     }
-    
-    textures.pop_back();
-    for (TextureResource* texture : textures) 
+}
+
+void TextureManager::reload(TextureResource* texture)
+{
+    // the new device may lack the format, then the source is decoded instead
+    CookedTexture cooked;
+    if (texture->format != VK_FORMAT_R8G8B8A8_UNORM && TextureCache::Load(texture->path, cooked) && IsFormatSupported(cooked.format))
     {
-        newTexture = AssetManager::LoadImageFile(texture->path);
-        texture->image = newTexture->image;
-        texture->sampler = newTexture->sampler;
-        if (textures[textures.size() - 1] != newTexture)
-        {
-            throw std::runtime_error("New texture is different than last texture on buffer!");
-        }
-        textures.pop_back();
+        TextureDescriptor desc{};
+        DescribeCooked(cooked, desc);
+        upload(texture, desc);
+        return;
+    }
+
+    TextureDescriptor desc{};
+    int width, height;
+    unsigned char* pixels = AssetManager::DecodeImageFile(texture->path, width, height);
+    if (pixels == nullptr)
+    {
+        throw std::runtime_error("Failed to reload texture " + texture->path.string());
+    }
+    desc.data = pixels;
+    desc.width = width;
+    desc.height = height;
+
+    upload(texture, desc);
+    AssetManager::FreeImage(pixels);
+}
+
+bool TextureManager::IsFormatSupported(VkFormat format)
+{
+    bool blockCompressed = format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && format <= VK_FORMAT_BC7_SRGB_BLOCK;
+    if (blockCompressed && PhysicalDevice::GetFeatures().textureCompressionBC != VK_TRUE)
+    {
+        return false;
     }
+
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(PhysicalDevice::GetVkPhysicalDevice(), format, &properties);
+    const VkFormatFeatureFlags required = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    return (properties.optimalTilingFeatures & required) == required;
+}
+
+void TextureManager::DescribeCooked(const CookedTexture& cooked, TextureDescriptor& desc)
+{
+    desc.data = (void*)cooked.data;
+    desc.width = cooked.width;
+    desc.height = cooked.height;
+    desc.format = cooked.format;
+    desc.levels = cooked.levels;
+    desc.size = cooked.size;
 }
 
 void TextureManager::Setup() 
@@ -39,62 +89,372 @@ void TextureManager::Finish()
         delete texture;
     }
     textures.clear();
+    pathCache.clear();
+    contentCache.clear();
 }
 
 void TextureManager::Destroy()
 {
-    ImageManager::Destroy(defaultTexture->image);
-    vkDestroySampler(LogicalDevice::GetVkDevice(), defaultTexture->sampler, Instance::GetAllocator());
+    // the device is idle, released textures don't need to wait for their frames
+    for (RetiredTexture& retired : retiredTextures)
+    {
+        textures.erase(std::remove(textures.begin(), textures.end(), retired.texture), textures.end());
+        destroyTexture(retired.texture);
+        delete retired.texture;
+    }
+    retiredTextures.clear();
+    for (RetiredImage& retired : retiredImages)
+    {
+        ImageManager::Destroy(retired.image);
+    }
+    retiredImages.clear();
 
+    destroyTexture(defaultTexture);
     for (TextureResource* texture : textures) 
     {
-        ImageManager::Destroy(texture->image);
-        vkDestroySampler(LogicalDevice::GetVkDevice(), texture->sampler, Instance::GetAllocator());
+        destroyTexture(texture);
     }
+    destroySamplers();
 }
 
+void TextureManager::Update()
+{
+    frame++;
 
-TextureResource* TextureManager::CreateTexture(TextureDescriptor& desc)
+    if (samplersDirty)
+    {
+        updateSamplers();
+        samplersDirty = false;
+    }
+
+    if (mipBenchmarkRequested)
+    {
+        BenchmarkMips("assets/sponza");
+        mipBenchmarkRequested = false;
+    }
+
+    // every frame recorded before the release has had its fence waited on by then
+    const uint64_t safeFrames = SwapChain::GetFramesInFlight() + 1;
+
+    for (size_t i = 0; i < retiredImages.size();)
+    {
+        if (frame >= retiredImages[i].frame + safeFrames)
+        {
+            ImageManager::Destroy(retiredImages[i].image);
+            retiredImages.erase(retiredImages.begin() + i);
+        }
+        else
+        {
+            i++;
+        }
+    }
+
+    for (size_t i = 0; i < retiredTextures.size();)
+    {
+        RetiredTexture& retired = retiredTextures[i];
+        if (frame >= retired.frame + safeFrames)
+        {
+            TextureResource* texture = retired.texture;
+            destroyTexture(texture);
+            textures.erase(std::remove(textures.begin(), textures.end(), texture), textures.end());
+            delete texture;
+            texturesReleased++;
+            retiredTextures.erase(retiredTextures.begin() + i);
+        }
+        else
+        {
+            i++;
+        }
+    }
+}
+
+void TextureManager::OnImgui()
 {
-    auto device = LogicalDevice::GetVkDevice();
-    auto instance = Instance::GetInstance();
+    const auto totalSpace = ImGui::GetContentRegionAvail();
+    const float totalWidth = totalSpace.x;
 
-    ImageDesc imageDesc{};
-    imageDesc.numSamples = VK_SAMPLE_COUNT_1_BIT;
-    imageDesc.width = desc.width;
-    imageDesc.height = desc.height;
-    imageDesc.mipLevels = (uint32_t)(std::floor(std::log2(std::max(desc.width, desc.height)))) + 1;
-    imageDesc.numSamples = VK_SAMPLE_COUNT_1_BIT;
-    imageDesc.format = VK_FORMAT_R8G8B8A8_UNORM;
-    imageDesc.tiling = VK_IMAGE_TILING_OPTIMAL;
-    imageDesc.usage = VK_IMAGE_USAGE_SAMPLED_BIT;
-    imageDesc.usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
-    imageDesc.usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
-    imageDesc.properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-    imageDesc.aspect = VK_IMAGE_ASPECT_COLOR_BIT;
-    imageDesc.size = (uint32_t)(desc.width * desc.height * 4);
+    if (ImGui::CollapsingHeader("Textures"))
+    {
+        // what the same chains would take as rgba8, a third more than level 0 for the mips
+        VkDeviceSize liveBytes = defaultTexture->bytes;
+        VkDeviceSize rgbaBytes = (VkDeviceSize)defaultTexture->width * defaultTexture->height * 16 / 3;
+        uint32_t compressed = 0;
+        for (TextureResource* texture : textures)
+        {
+            liveBytes += texture->bytes;
+            rgbaBytes += (VkDeviceSize)texture->width * texture->height * 16 / 3;
+            compressed += texture->format != VK_FORMAT_R8G8B8A8_UNORM ? 1 : 0;
+        }
 
-    TextureResource* res = new TextureResource();
+        ImGui::Text("Live Textures");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::Text("%zu", textures.size() + 1);
+        ImGui::Text("Texture Memory");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::Text("%.2f MB", liveBytes / (1024.0f * 1024.0f));
+        ImGui::Text("As RGBA8");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::Text("%.2f MB", rgbaBytes / (1024.0f * 1024.0f));
+        ImGui::Text("Compressed");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::Text("%u", compressed);
 
-    BufferResource staging;
-    BufferManager::CreateStagingBuffer(staging, desc.data, imageDesc.size);
-    ImageManager::Create(imageDesc, res->image, staging);
-    BufferManager::Destroy(staging);
+        // only affects loads from now on
+        ImGui::Text("Use Cooked");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::PushID("textureUseCooked");
+        ImGui::Checkbox("", &useCooked);
+        ImGui::PopID();
 
-    VkSamplerCreateInfo samplerInfo{};
-    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-    samplerInfo.magFilter = VK_FILTER_LINEAR;
-    samplerInfo.minFilter = VK_FILTER_LINEAR;
-    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    samplerInfo.anisotropyEnable = VK_TRUE;
+        ImGui::Text("Path Hits");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::Text("%u", pathHits);
+        ImGui::Text("Content Hits");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::Text("%u", contentHits);
+        ImGui::Text("Misses");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::Text("%u", misses);
+        ImGui::Text("Memory Saved");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::Text("%.2f MB", bytesSaved / (1024.0f * 1024.0f));
+        ImGui::Text("Decode Time Saved");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::Text("%.2f ms", decodeMsSaved);
+        ImGui::Text("Released");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::Text("%u (%zu pending)", texturesReleased, retiredTextures.size());
+
+        ImGui::Text("Hash Content");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::PushID("textureHashContent");
+        ImGui::Checkbox("", &hashContent);
+        ImGui::PopID();
+
+        const auto& limits = PhysicalDevice::GetProperties().limits;
+        ImGui::Text("Samplers");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::Text("%zu of %u", samplers.size(), limits.maxSamplerAllocationCount);
+
+        // applied on the next Update, after the device went idle
+        ImGui::Text("Anisotropy");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::PushID("textureAnisotropy");
+        ImGui::BeginDisabled(PhysicalDevice::GetFeatures().samplerAnisotropy != VK_TRUE);
+        samplersDirty |= ImGui::SliderFloat("", &anisotropy, 1.0f, limits.maxSamplerAnisotropy, "%.0fx");
+        ImGui::EndDisabled();
+        ImGui::PopID();
+
+        ImGui::Text("LOD Bias");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::PushID("textureLodBias");
+        samplersDirty |= ImGui::SliderFloat("", &lodBias, -limits.maxSamplerLodBias, limits.maxSamplerLodBias, "%.2f");
+        ImGui::PopID();
+
+        // runs on the next Update, stalls the frame for the whole directory
+        ImGui::Text("Mip Upload");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::PushID("textureMipBenchmark");
+        if (ImGui::Button("Benchmark"))
+        {
+            mipBenchmarkRequested = true;
+        }
+        ImGui::PopID();
+        if (mipBenchmarkCpuMs > 0.0f)
+        {
+            ImGui::Text("Blit / CPU");
+            ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+            ImGui::Text("%.1f / %.1f ms", mipBenchmarkBlitMs, mipBenchmarkCpuMs);
+        }
+    }
+}
+
+void TextureManager::BenchmarkMips(const std::filesystem::path& directory)
+{
+    std::vector<DecodedImage> images = MipGenerator::DecodeImages(directory);
+    if (images.empty())
+    {
+        return;
+    }
+
+    // everything in flight is finished first so only these uploads are timed
+    UploadManager::WaitIdle();
+
+    auto run = [&](bool cpu)
+    {
+        std::vector<ImageResource> resources(images.size());
+        auto start = std::chrono::high_resolution_clock::now();
+        for (size_t i = 0; i < images.size(); i++)
+        {
+            const DecodedImage& image = images[i];
+            uint32_t mipLevels = (uint32_t)(std::floor(std::log2(std::max(image.width, image.height)))) + 1;
+            ImageDesc imageDesc = describeImage(VK_FORMAT_R8G8B8A8_UNORM, image.width, image.height, mipLevels);
+
+            if (cpu)
+            {
+                MipChain chain;
+                MipGenerator::Generate(image.pixels, image.width, image.height, image.srgb, chain);
+                imageDesc.size = chain.data.size();
+                ImageManager::Create(imageDesc, resources[i], chain.data.data(), chain.levels);
+            }
+            else
+            {
+                imageDesc.usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+                imageDesc.size = (VkDeviceSize)image.width * image.height * 4;
+                ImageManager::Create(imageDesc, resources[i], image.pixels);
+            }
+        }
+        UploadManager::Submit();
+        UploadManager::WaitIdle();
+        auto end = std::chrono::high_resolution_clock::now();
+
+        for (ImageResource& resource : resources)
+        {
+            ImageManager::Destroy(resource);
+        }
+        return std::chrono::duration<float, std::milli>(end - start).count();
+    };
+
+    mipBenchmarkBlitMs = run(false);
+    mipBenchmarkCpuMs = run(true);
 
-    // get the max ansotropy level of my device
-    VkPhysicalDeviceProperties properties{};
-    vkGetPhysicalDeviceProperties(PhysicalDevice::GetVkPhysicalDevice(), &properties);
+    size_t texels = 0;
+    for (const DecodedImage& image : images)
+    {
+        texels += (size_t)image.width * image.height;
+    }
+    MipGenerator::FreeImages(images);
+    std::cout << "Mip upload of " << images.size() << " images, " << texels / 1000000.0f << " Mtexel: blit " << mipBenchmarkBlitMs
+        << " ms, cpu " << mipBenchmarkCpuMs << " ms on " << JobSystem::GetThreadCount() + 1 << " threads" << std::endl;
+}
 
-    samplerInfo.maxAnisotropy = properties.limits.maxSamplerAnisotropy;
+std::string TextureManager::GetCacheKey(const std::filesystem::path& path)
+{
+    std::error_code error;
+    std::filesystem::path canonical = std::filesystem::weakly_canonical(path, error);
+    return error ? path.lexically_normal().generic_string() : canonical.generic_string();
+}
+
+TextureResource* TextureManager::Find(const std::filesystem::path& path)
+{
+    auto it = pathCache.find(GetCacheKey(path));
+    if (it == pathCache.end())
+    {
+        return nullptr;
+    }
+
+    TextureResource* texture = it->second;
+    Acquire(texture);
+    pathHits++;
+    bytesSaved += texture->bytes;
+    decodeMsSaved += texture->decodeMs;
+    return texture;
+}
+
+TextureResource* TextureManager::FindContent(uint64_t contentHash, uint32_t width, uint32_t height, const std::filesystem::path& path)
+{
+    if (contentHash == 0)
+    {
+        return nullptr;
+    }
+
+    auto it = contentCache.find(contentHash);
+    if (it == contentCache.end() || it->second->width != width || it->second->height != height)
+    {
+        return nullptr;
+    }
+
+    // the decode already happened, only the upload and the memory are saved
+    TextureResource* texture = it->second;
+    Acquire(texture);
+    pathCache[GetCacheKey(path)] = texture;
+    contentHits++;
+    bytesSaved += texture->bytes;
+    return texture;
+}
+
+void TextureManager::Acquire(TextureResource* texture)
+{
+    if (texture == nullptr || texture == defaultTexture)
+    {
+        return;
+    }
+    texture->refCount++;
+}
+
+void TextureManager::Release(TextureResource* texture)
+{
+    if (texture == nullptr || texture == defaultTexture)
+    {
+        return;
+    }
+    if (texture->refCount == 0)
+    {
+        throw std::runtime_error("Texture released more often than acquired!");
+    }
+
+    texture->refCount--;
+    if (texture->refCount == 0)
+    {
+        // a later load of the same file decodes it again instead of reviving a dying texture
+        uncache(texture);
+        // the slot points at the default texture from the next recorded frame on, only the
+        // image has to outlive the frames in flight
+        SceneManager::ForgetTexture(texture);
+        retiredTextures.push_back({ texture, frame });
+    }
+}
+
+void TextureManager::uncache(TextureResource* texture)
+{
+    // content hits map extra paths to the same texture
+    for (auto it = pathCache.begin(); it != pathCache.end();)
+    {
+        it = it->second == texture ? pathCache.erase(it) : std::next(it);
+    }
+    auto it = contentCache.find(texture->contentHash);
+    if (it != contentCache.end() && it->second == texture)
+    {
+        contentCache.erase(it);
+    }
+}
+
+void TextureManager::destroyTexture(TextureResource* texture)
+{
+    ImageManager::Destroy(texture->image);
+    // the upload was waited on, the streamer sees there is nothing left to swap in
+    if (texture->pendingImage.image != VK_NULL_HANDLE)
+    {
+        ImageManager::Destroy(texture->pendingImage);
+        texture->pendingImage = {};
+    }
+    texture->sampler = VK_NULL_HANDLE;
+}
+
+VkSampler TextureManager::GetSampler(const SamplerDesc& desc)
+{
+    const auto& limits = PhysicalDevice::GetProperties().limits;
+    bool anisotropySupported = PhysicalDevice::GetFeatures().samplerAnisotropy == VK_TRUE;
+    float maxAnisotropy = anisotropySupported ? std::clamp(anisotropy, 1.0f, limits.maxSamplerAnisotropy) : 1.0f;
+    float mipLodBias = std::clamp(lodBias, -limits.maxSamplerLodBias, limits.maxSamplerLodBias);
+
+    for (const CachedSampler& cached : samplers)
+    {
+        if (cached.desc == desc && cached.anisotropy == maxAnisotropy && cached.lodBias == mipLodBias)
+        {
+            return cached.sampler;
+        }
+    }
+
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = desc.magFilter;
+    samplerInfo.minFilter = desc.minFilter;
+    samplerInfo.addressModeU = desc.addressMode;
+    samplerInfo.addressModeV = desc.addressMode;
+    samplerInfo.addressModeW = desc.addressMode;
+    samplerInfo.anisotropyEnable = maxAnisotropy > 1.0f ? VK_TRUE : VK_FALSE;
+    samplerInfo.maxAnisotropy = maxAnisotropy;
 
     // what color to return when clamp is active in addressing mode
     samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
@@ -105,18 +465,186 @@ TextureResource* TextureManager::CreateTexture(TextureDescriptor& desc)
     samplerInfo.compareEnable = VK_FALSE;
     samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
 
-    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-    samplerInfo.mipLodBias = 0.0f;
+    // no lod clamp so one sampler fits textures with any number of mips
+    samplerInfo.mipmapMode = desc.mipmapMode;
+    samplerInfo.mipLodBias = mipLodBias;
     samplerInfo.minLod = 0.0f;
-    samplerInfo.maxLod = static_cast<float>(imageDesc.mipLevels);
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
 
-    auto vkRes = vkCreateSampler(device, &samplerInfo, nullptr, &res->sampler);
+    VkSampler sampler;
+    auto vkRes = vkCreateSampler(LogicalDevice::GetVkDevice(), &samplerInfo, Instance::GetAllocator(), &sampler);
     if (vkRes != VK_SUCCESS)
     {
         throw std::runtime_error("Failed to create texture sampler!");
     }
 
+    samplers.push_back({ desc, maxAnisotropy, mipLodBias, sampler });
+    return sampler;
+}
+
+void TextureManager::destroySamplers()
+{
+    for (const CachedSampler& cached : samplers)
+    {
+        vkDestroySampler(LogicalDevice::GetVkDevice(), cached.sampler, Instance::GetAllocator());
+    }
+    samplers.clear();
+}
+
+void TextureManager::updateSamplers()
+{
+    // descriptor sets of frames in flight point at the old samplers, a settings change is rare enough to wait
+    vkDeviceWaitIdle(LogicalDevice::GetVkDevice());
+
+    std::vector<CachedSampler> oldSamplers;
+    oldSamplers.swap(samplers);
+
+    defaultTexture->sampler = GetSampler(defaultTexture->samplerDesc);
+    for (TextureResource* texture : textures)
+    {
+        texture->sampler = GetSampler(texture->samplerDesc);
+    }
+    SceneManager::RewriteTextureDescriptors();
+
+    for (const CachedSampler& cached : oldSamplers)
+    {
+        vkDestroySampler(LogicalDevice::GetVkDevice(), cached.sampler, Instance::GetAllocator());
+    }
+}
+
+TextureResource* TextureManager::CreateTexture(TextureDescriptor& desc)
+{
+    TextureResource* res = new TextureResource();
+    res->path = desc.path;
+    res->contentHash = desc.contentHash;
+    res->decodeMs = desc.decodeMs;
+    res->samplerDesc = desc.sampler;
+
+    upload(res, desc);
+
     textures.push_back(res);
+    misses++;
+
+    if (!desc.path.empty())
+    {
+        pathCache[GetCacheKey(desc.path)] = res;
+    }
+    if (desc.contentHash != 0)
+    {
+        contentCache[desc.contentHash] = res;
+    }
 
     return res;
 }
+
+void TextureManager::upload(TextureResource* texture, const TextureDescriptor& desc)
+{
+    texture->width = desc.width;
+    texture->height = desc.height;
+    texture->format = desc.format;
+    texture->mipLevels = (uint32_t)(std::floor(std::log2(std::max(desc.width, desc.height)))) + 1;
+    // the default texture is never streamed, it stands in for everything else
+    const bool streamed = texture != defaultTexture;
+
+    if (desc.levels.empty() && MipGenerator::IsEnabled())
+    {
+        // the loaders that decode on this thread build the chain here too
+        MipChain chain;
+        MipGenerator::Generate((const uint8_t*)desc.data, desc.width, desc.height, !TextureCache::IsNormalMap(desc.path), chain);
+        uploadLevels(texture, chain.data.data(), chain.levels, streamed ? TextureStreamer::GetInitialMip(chain.levels) : 0);
+    }
+    else if (desc.levels.empty())
+    {
+        // the mips are blitted from level 0, so the whole chain stays resident
+        ImageDesc imageDesc = describeImage(desc.format, desc.width, desc.height, texture->mipLevels);
+        imageDesc.usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        imageDesc.size = (VkDeviceSize)desc.width * desc.height * 4;
+        texture->uploadTicket = ImageManager::Create(imageDesc, texture->image, desc.data);
+        texture->residentMip = 0;
+        texture->streamable = false;
+        texture->chainBytes = texture->image.allocation.size;
+    }
+    else
+    {
+        uploadLevels(texture, desc.data, desc.levels, streamed ? TextureStreamer::GetInitialMip(desc.levels) : 0);
+    }
+    texture->bytes = texture->image.allocation.size;
+
+    texture->sampler = GetSampler(texture->samplerDesc);
+}
+
+ImageDesc TextureManager::describeImage(VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels)
+{
+    ImageDesc imageDesc{};
+    imageDesc.numSamples = VK_SAMPLE_COUNT_1_BIT;
+    imageDesc.width = width;
+    imageDesc.height = height;
+    imageDesc.mipLevels = mipLevels;
+    imageDesc.format = format;
+    imageDesc.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageDesc.usage = VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageDesc.usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    imageDesc.properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    imageDesc.aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+    return imageDesc;
+}
+
+uint64_t TextureManager::createLevels(const TextureResource* texture, ImageResource& image, const void* data, const std::vector<ImageLevel>& levels, uint32_t firstMip)
+{
+    // the image starts at firstMip, so the offsets are rebased on that level
+    const ImageLevel& first = levels[firstMip];
+    std::vector<ImageLevel> resident(levels.begin() + firstMip, levels.end());
+    VkDeviceSize size = 0;
+    for (ImageLevel& level : resident)
+    {
+        level.offset -= first.offset;
+        size = std::max(size, level.offset + level.size);
+    }
+
+    ImageDesc imageDesc = describeImage(texture->format, first.width, first.height, (uint32_t)resident.size());
+    // evictions copy the levels they keep out of it
+    imageDesc.usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    imageDesc.size = size;
+    return ImageManager::Create(imageDesc, image, (const char*)data + first.offset, resident);
+}
+
+void TextureManager::uploadLevels(TextureResource* texture, const void* data, const std::vector<ImageLevel>& levels, uint32_t firstMip)
+{
+    texture->uploadTicket = createLevels(texture, texture->image, data, levels, firstMip);
+    texture->residentMip = firstMip;
+    texture->streamable = true;
+
+    texture->chainBytes = 0;
+    for (const ImageLevel& level : levels)
+    {
+        texture->chainBytes += level.size;
+    }
+}
+
+void TextureManager::SetResidentMips(TextureResource* texture, const void* data, const std::vector<ImageLevel>& levels, uint32_t firstMip)
+{
+    texture->pendingTicket = createLevels(texture, texture->pendingImage, data, levels, firstMip);
+    texture->pendingMip = firstMip;
+}
+
+void TextureManager::CopyResidentMips(TextureResource* texture, uint32_t firstMip)
+{
+    const uint32_t width = std::max(1u, texture->width >> firstMip);
+    const uint32_t height = std::max(1u, texture->height >> firstMip);
+    ImageDesc imageDesc = describeImage(texture->format, width, height, texture->mipLevels - firstMip);
+    imageDesc.usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    texture->pendingTicket = ImageManager::Create(imageDesc, texture->pendingImage, texture->image, firstMip - texture->residentMip);
+    texture->pendingMip = firstMip;
+}
+
+void TextureManager::SwapResidentMips(TextureResource* texture)
+{
+    // frames in flight still sample the old image
+    retiredImages.push_back({ texture->image, frame });
+    texture->image = texture->pendingImage;
+    texture->pendingImage = {};
+    texture->uploadTicket = texture->pendingTicket;
+    texture->residentMip = texture->pendingMip;
+    texture->bytes = texture->image.allocation.size;
+    SceneManager::OnTextureImageChanged(texture);
+}
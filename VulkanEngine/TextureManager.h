@@ -2,21 +2,90 @@
 
 #include <string>
 #include <filesystem>
+#include <unordered_map>
 
 #include "ImageManager.h"
 
+struct CookedTexture;
+
+// per texture sampler state, anisotropy and lod bias are global and added by the cache
+struct SamplerDesc
+{
+    VkFilter magFilter = VK_FILTER_LINEAR;
+    VkFilter minFilter = VK_FILTER_LINEAR;
+    VkSamplerMipmapMode mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    VkSamplerAddressMode addressMode = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+
+    bool operator==(const SamplerDesc& other) const = default;
+};
+
 struct TextureDescriptor
 {
     void* data;
     uint32_t width;
     uint32_t height;
+    // cache keys, an empty path or a zero hash keeps the texture out of that cache
+    std::filesystem::path path;
+    uint64_t contentHash = 0;
+    float decodeMs = 0.0f;
+    SamplerDesc sampler;
+    // a cooked mip chain when levels is not empty, else rgba8 level 0 and blitted mips
+    VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+    std::vector<ImageLevel> levels;
+    VkDeviceSize size = 0;
 };
 
 struct TextureResource 
 {
     std::filesystem::path path;
     ImageResource image;
+    // owned by the sampler cache and shared with every texture of the same state
     VkSampler sampler;
+    SamplerDesc samplerDesc;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+    // the texture is resident once this upload ticket completes
+    uint64_t uploadTicket = 0;
+    // the image holds levels residentMip to mipLevels - 1 of the full chain, the finer
+    // levels are streamed in once they are needed on screen
+    uint32_t mipLevels = 1;
+    uint32_t residentMip = 0;
+    // finest level the models using it need this frame, mipLevels - 1 when none is visible
+    uint32_t wantedMip = 0;
+    // blitted chains can't be rebuilt from a level and stay fully resident
+    bool streamable = false;
+    bool streaming = false;
+    // device memory of the full chain
+    VkDeviceSize chainBytes = 0;
+    // levels pendingMip and up being uploaded for the streamer, the image is only swapped
+    // in once pendingTicket completes, until then frames keep sampling the current one
+    ImageResource pendingImage{};
+    uint64_t pendingTicket = 0;
+    uint32_t pendingMip = 0;
+    // written once by SceneManager, never updated so frames in flight can keep using it
+    VkDescriptorSet materialDescriptor = VK_NULL_HANDLE;
+
+    // models and loads holding the texture, it is destroyed once this drops to zero
+    uint32_t refCount = 0;
+    uint64_t contentHash = 0;
+    // what a cache hit saves, device memory of the mip chain and cpu time of the decode
+    VkDeviceSize bytes = 0;
+    float decodeMs = 0.0f;
+};
+
+// a texture nothing references anymore, its image is kept until no frame in flight can sample it
+struct RetiredTexture
+{
+    TextureResource* texture;
+    uint64_t frame;
+};
+
+// an image replaced by one with a different set of mips
+struct RetiredImage
+{
+    ImageResource image;
+    uint64_t frame;
 };
 
 class TextureManager 
@@ -26,11 +95,94 @@ public:
     static void Setup();
     static void Finish();
     static void Destroy();
+    // once per frame, destroys released textures no frame can still use
+    static void Update();
+    static void OnImgui();
+    // starts with no references, the caller acquires it
     static TextureResource* CreateTexture(TextureDescriptor& desc);
 
+    // canonical path, the same file reached through different relative paths is one entry
+    static std::string GetCacheKey(const std::filesystem::path& path);
+    // cached texture with one more reference, nullptr on a miss
+    static TextureResource* Find(const std::filesystem::path& path);
+    // path is added to the path cache on a hit so the next load skips the decode
+    static TextureResource* FindContent(uint64_t contentHash, uint32_t width, uint32_t height, const std::filesystem::path& path);
+    static void Acquire(TextureResource* texture);
+    static void Release(TextureResource* texture);
+
+    // cached sampler for the state plus the global anisotropy and lod bias
+    static VkSampler GetSampler(const SamplerDesc& desc);
+
     static inline TextureResource* GetDefaultTexture() { return defaultTexture; }
+    static inline bool IsContentHashEnabled() { return hashContent; }
+
+    // sampled with linear filtering, BCn formats also need textureCompressionBC
+    static bool IsFormatSupported(VkFormat format);
+    // a cooked texture is used when its format is supported, else the source is decoded
+    static inline bool IsCookedEnabled() { return useCooked; }
+    static void DescribeCooked(const CookedTexture& cooked, TextureDescriptor& desc);
+
+    // uploads every image under the directory with blitted mips and then with cpu built
+    // chains, both timed up to the upload fence and printed to the console
+    static void BenchmarkMips(const std::filesystem::path& directory);
+
+    // uploads an image holding levels firstMip and up of the full chain as the pending image,
+    // offsets relative to data
+    static void SetResidentMips(TextureResource* texture, const void* data, const std::vector<ImageLevel>& levels, uint32_t firstMip);
+    // the pending image keeps levels firstMip and up of the resident image, copied on the gpu
+    static void CopyResidentMips(TextureResource* texture, uint32_t firstMip);
+    // puts the pending image in use, only once its upload ticket completed
+    static void SwapResidentMips(TextureResource* texture);
+    static inline const std::vector<TextureResource*>& GetTextures() { return textures; }
 
 private:
     static inline std::vector<TextureResource*> textures;
     static inline TextureResource* defaultTexture;
+
+    static inline std::unordered_map<std::string, TextureResource*> pathCache;
+    static inline std::unordered_map<uint64_t, TextureResource*> contentCache;
+    static inline std::vector<RetiredTexture> retiredTextures;
+    static inline std::vector<RetiredImage> retiredImages;
+    static inline uint64_t frame = 0;
+    // hashing the decoded pixels also catches copies of an image under another name
+    static inline bool hashContent = true;
+    static inline bool useCooked = true;
+
+    struct CachedSampler
+    {
+        SamplerDesc desc;
+        float anisotropy;
+        float lodBias;
+        VkSampler sampler;
+    };
+
+    static inline std::vector<CachedSampler> samplers;
+    // 1 disables anisotropic filtering
+    static inline float anisotropy = 16.0f;
+    static inline float lodBias = 0.0f;
+    static inline bool samplersDirty = false;
+
+    static inline bool mipBenchmarkRequested = false;
+    static inline float mipBenchmarkBlitMs = 0.0f;
+    static inline float mipBenchmarkCpuMs = 0.0f;
+
+    static inline uint32_t pathHits = 0;
+    static inline uint32_t contentHits = 0;
+    static inline uint32_t misses = 0;
+    static inline uint32_t texturesReleased = 0;
+    static inline VkDeviceSize bytesSaved = 0;
+    static inline float decodeMsSaved = 0.0f;
+
+    static void upload(TextureResource* texture, const TextureDescriptor& desc);
+    static ImageDesc describeImage(VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels);
+    static void uploadLevels(TextureResource* texture, const void* data, const std::vector<ImageLevel>& levels, uint32_t firstMip);
+    // the image of levels firstMip and up, returns the upload ticket
+    static uint64_t createLevels(const TextureResource* texture, ImageResource& image, const void* data, const std::vector<ImageLevel>& levels, uint32_t firstMip);
+    // decodes or maps the texture again after the device was recreated
+    static void reload(TextureResource* texture);
+    static void destroyTexture(TextureResource* texture);
+    static void uncache(TextureResource* texture);
+    static void destroySamplers();
+    // moves every texture to samplers with the current global settings
+    static void updateSamplers();
 };
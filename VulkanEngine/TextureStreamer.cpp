@@ -0,0 +1,429 @@
+#include "TextureStreamer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <queue>
+
+#include "AssetManager.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+#include "SceneManager.h"
+#include "UploadManager.h"
+#include "imgui/imgui.h"
+
+void TextureStreamer::Finish()
+{
+    // the load jobs were drained by JobSystem::Destroy, the textures die in TextureManager::Finish
+    for (StreamRequest* request : requests)
+    {
+        request->texture->streaming = false;
+        delete request;
+    }
+    requests.clear();
+}
+
+uint32_t TextureStreamer::GetInitialMip(const std::vector<ImageLevel>& levels)
+{
+    if (!enabled)
+    {
+        return 0;
+    }
+    for (uint32_t i = 0; i < levels.size(); i++)
+    {
+        if (std::max(levels[i].width, levels[i].height) <= (uint32_t)initialSize)
+        {
+            return i;
+        }
+    }
+    return (uint32_t)levels.size() - 1;
+}
+
+VkDeviceSize TextureStreamer::estimateBytes(const TextureResource* texture, uint32_t firstMip)
+{
+    return std::max<VkDeviceSize>(texture->chainBytes >> (2 * firstMip), 16);
+}
+
+void TextureStreamer::computeWantedMips(const glm::mat4& view, const glm::mat4& proj, float screenHeight)
+{
+    for (TextureResource* texture : TextureManager::GetTextures())
+    {
+        texture->wantedMip = texture->mipLevels - 1;
+    }
+
+    // pixels per world unit at a view depth of 1, w is the view depth for a perspective
+    // projection and 1 for an orthographic one
+    const float pixelsAtUnitDepth = std::abs(proj[1][1]) * screenHeight * 0.5f;
+    const float perspective = std::abs(proj[2][3]);
+
+    TextureResource* defaultTexture = TextureManager::GetDefaultTexture();
+    for (Model* model : SceneManager::GetModels())
+    {
+        TextureResource* texture = model->texture;
+        const MeshResource* mesh = model->mesh;
+        if (mesh == nullptr || texture == nullptr || texture == defaultTexture || !texture->streamable)
+        {
+            continue;
+        }
+
+        const glm::mat4& world = model->ubo.model;
+        const float scale = std::max({ glm::length(glm::vec3(world[0])), glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2])), 1e-6f });
+        const float radius = mesh->radius * scale;
+        const glm::vec4 viewCenter = view * world * glm::vec4(mesh->center, 1.0f);
+        const float w = (proj * viewCenter).w;
+        if (w + radius * perspective < 0.0f)
+        {
+            // behind the camera
+            continue;
+        }
+
+        // the closest point of the bounds sets the finest level any pixel needs
+        const float depth = std::max(w - radius * perspective, 1e-3f);
+        const float pixelsPerUnit = pixelsAtUnitDepth / depth;
+        const float texelsPerUnit = std::max(texture->width, texture->height) * mesh->uvDensity / scale;
+
+        int mip = texelsPerUnit > pixelsPerUnit ? (int)std::floor(std::log2(texelsPerUnit / pixelsPerUnit)) : 0;
+        mip = std::clamp(mip + mipBias, 0, (int)texture->mipLevels - 1);
+        texture->wantedMip = std::min(texture->wantedMip, (uint32_t)mip);
+    }
+}
+
+void TextureStreamer::Update(const glm::mat4& view, const glm::mat4& proj, float screenHeight)
+{
+    PROFILE_FUNCTION();
+    finishRequests();
+
+    const std::vector<TextureResource*>& textures = TextureManager::GetTextures();
+    if (enabled)
+    {
+        computeWantedMips(view, proj, screenHeight);
+    }
+
+    // off streams every chain back in full, without a budget
+    std::vector<uint32_t> targets(textures.size(), 0);
+    residentBytes = 0;
+    wantedBytes = 0;
+    streamableCount = 0;
+    for (size_t i = 0; i < textures.size(); i++)
+    {
+        TextureResource* texture = textures[i];
+        residentBytes += texture->bytes;
+        if (!texture->streamable)
+        {
+            wantedBytes += texture->bytes;
+            continue;
+        }
+        targets[i] = enabled ? texture->wantedMip : 0;
+        wantedBytes += estimateBytes(texture, targets[i]);
+        streamableCount++;
+    }
+
+    // over budget the level that frees the most memory is dropped first, which keeps the
+    // coarse levels of everything and takes the finest levels of the largest textures
+    targetBytes = wantedBytes;
+    trimmedCount = 0;
+    const VkDeviceSize budget = (VkDeviceSize)budgetMB * 1024 * 1024;
+    if (enabled && targetBytes > budget)
+    {
+        std::priority_queue<std::pair<VkDeviceSize, size_t>> saving;
+        for (size_t i = 0; i < textures.size(); i++)
+        {
+            if (textures[i]->streamable && targets[i] + 1 < textures[i]->mipLevels)
+            {
+                saving.push({ estimateBytes(textures[i], targets[i]) - estimateBytes(textures[i], targets[i] + 1), i });
+            }
+        }
+        std::vector<uint8_t> trimmed(textures.size(), 0);
+        while (targetBytes > budget && !saving.empty())
+        {
+            auto [bytes, i] = saving.top();
+            saving.pop();
+            targets[i]++;
+            targetBytes -= bytes;
+            trimmed[i] = 1;
+            if (targets[i] + 1 < textures[i]->mipLevels)
+            {
+                saving.push({ estimateBytes(textures[i], targets[i]) - estimateBytes(textures[i], targets[i] + 1), i });
+            }
+        }
+        for (uint8_t t : trimmed)
+        {
+            trimmedCount += t;
+        }
+    }
+
+    // under the budget finer levels than needed stay resident, they may be needed again soon
+    const bool overBudget = residentBytes > budget;
+    struct Candidate
+    {
+        TextureResource* texture;
+        uint32_t target;
+        int priority;
+    };
+    std::vector<Candidate> candidates;
+    belowWantedCount = 0;
+    for (size_t i = 0; i < textures.size(); i++)
+    {
+        TextureResource* texture = textures[i];
+        if (!texture->streamable)
+        {
+            continue;
+        }
+        belowWantedCount += texture->residentMip > texture->wantedMip ? 1 : 0;
+        // released textures wait in TextureManager for their frames to finish
+        if (texture->streaming || texture->refCount == 0)
+        {
+            continue;
+        }
+
+        if (targets[i] < texture->residentMip)
+        {
+            candidates.push_back({ texture, targets[i], (int)(texture->residentMip - targets[i]) });
+        }
+        else if (enabled && overBudget && targets[i] > texture->residentMip)
+        {
+            // evictions free memory before anything else is streamed in
+            candidates.push_back({ texture, targets[i], 1000 + (int)(targets[i] - texture->residentMip) });
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) { return a.priority > b.priority; });
+
+    for (const Candidate& candidate : candidates)
+    {
+        if ((int)requests.size() >= maxRequests)
+        {
+            break;
+        }
+        request(candidate.texture, candidate.target);
+    }
+}
+
+void TextureStreamer::request(TextureResource* texture, uint32_t firstMip)
+{
+    // the reference keeps the texture alive until the levels are swapped in
+    TextureManager::Acquire(texture);
+    texture->streaming = true;
+
+    StreamRequest* streamRequest = new StreamRequest();
+    streamRequest->texture = texture;
+    streamRequest->firstMip = firstMip;
+    requests.push_back(streamRequest);
+
+    if (firstMip > texture->residentMip)
+    {
+        // evictions keep levels that are already resident, nothing is read or decoded
+        TextureManager::CopyResidentMips(texture, firstMip);
+        streamRequest->uploading = true;
+        return;
+    }
+    JobSystem::Submit([streamRequest]() { load(streamRequest); }, nullptr, JobPriority::Background);
+}
+
+void TextureStreamer::load(StreamRequest* request)
+{
+    PROFILE_FUNCTION();
+    const TextureResource* texture = request->texture;
+
+    if (texture->format != VK_FORMAT_R8G8B8A8_UNORM)
+    {
+        // a cooked chain is only mapped, any level range costs nothing to read
+        request->failed = !TextureCache::Load(texture->path, request->cooked) ||
+            request->cooked.format != texture->format ||
+            request->cooked.levels.size() != texture->mipLevels;
+    }
+    else
+    {
+        // without a cooked file every stream in decodes the source again
+        int width, height;
+        unsigned char* pixels = AssetManager::DecodeImageFile(texture->path, width, height);
+        request->failed = pixels == nullptr || (uint32_t)width != texture->width || (uint32_t)height != texture->height;
+        if (!request->failed)
+        {
+            MipGenerator::Generate(pixels, width, height, !TextureCache::IsNormalMap(texture->path), request->mips);
+        }
+        if (pixels != nullptr)
+        {
+            AssetManager::FreeImage(pixels);
+        }
+    }
+    request->loaded = true;
+}
+
+void TextureStreamer::finishRequests()
+{
+    for (size_t i = 0; i < requests.size();)
+    {
+        StreamRequest* request = requests[i];
+        TextureResource* texture = request->texture;
+        if (request->uploading)
+        {
+            // no pending image left means the device was recreated and the texture reloaded meanwhile
+            const bool dropped = texture->pendingImage.image == VK_NULL_HANDLE;
+            // swapped in only once the levels are on the gpu, like any other upload
+            if (!dropped && !UploadManager::IsComplete(texture->pendingTicket))
+            {
+                i++;
+                continue;
+            }
+            if (!dropped)
+            {
+                const uint32_t previousMip = texture->residentMip;
+                TextureManager::SwapResidentMips(texture);
+                if (request->firstMip < previousMip)
+                {
+                    streamedIn++;
+                    bytesStreamed += texture->bytes;
+                }
+                else
+                {
+                    evicted++;
+                }
+            }
+        }
+        else if (!request->loaded)
+        {
+            i++;
+            continue;
+        }
+        else if (request->failed)
+        {
+            // the source changed or is gone, the resident levels are kept for good
+            std::cerr << "Failed to stream " << texture->path.string() << ", keeping its resident mips" << std::endl;
+            texture->streamable = false;
+            failedCount++;
+        }
+        else
+        {
+            const bool cooked = request->cooked.file != nullptr;
+            const void* data = cooked ? (const void*)request->cooked.data : (const void*)request->mips.data.data();
+            const std::vector<ImageLevel>& levels = cooked ? request->cooked.levels : request->mips.levels;
+            TextureManager::SetResidentMips(texture, data, levels, request->firstMip);
+
+            // the levels are in staging memory now
+            request->cooked = CookedTexture{};
+            request->mips = MipChain{};
+            request->uploading = true;
+            i++;
+            continue;
+        }
+
+        texture->streaming = false;
+        TextureManager::Release(texture);
+        delete request;
+        requests.erase(requests.begin() + i);
+    }
+}
+
+void TextureStreamer::OnImgui()
+{
+    const auto totalSpace = ImGui::GetContentRegionAvail();
+    const float totalWidth = totalSpace.x;
+    const float mb = 1024.0f * 1024.0f;
+
+    if (ImGui::CollapsingHeader("Texture Streaming"))
+    {
+        ImGui::Text("Enabled");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::PushID("streamingEnabled");
+        ImGui::Checkbox("", &enabled);
+        ImGui::PopID();
+
+        ImGui::Text("Budget (MB)");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::PushID("streamingBudget");
+        ImGui::SliderInt("", &budgetMB, 16, 4096);
+        ImGui::PopID();
+
+        // only affects textures loaded from now on
+        ImGui::Text("Initial Size");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::PushID("streamingInitialSize");
+        ImGui::SliderInt("", &initialSize, 1, 1024);
+        ImGui::PopID();
+
+        ImGui::Text("Mip Bias");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::PushID("streamingMipBias");
+        ImGui::SliderInt("", &mipBias, -2, 4);
+        ImGui::PopID();
+
+        ImGui::Text("Max Requests");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::PushID("streamingMaxRequests");
+        ImGui::SliderInt("", &maxRequests, 1, 32);
+        ImGui::PopID();
+
+        const float budget = (float)budgetMB * mb;
+        ImGui::Text("Resident");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        char overlay[64];
+        snprintf(overlay, sizeof(overlay), "%.1f / %d MB", residentBytes / mb, budgetMB);
+        ImGui::ProgressBar(std::min(residentBytes / budget, 1.0f), ImVec2(-1.0f, 0.0f), overlay);
+        ImGui::Text("Wanted");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::Text("%.1f MB (%.0f%% of budget)", wantedBytes / mb, wantedBytes / budget * 100.0f);
+        ImGui::Text("Target");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::Text("%.1f MB", targetBytes / mb);
+
+        ImGui::Text("Streamable");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::Text("%u of %zu", streamableCount, TextureManager::GetTextures().size());
+        ImGui::Text("Trimmed by Budget");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::Text("%u", trimmedCount);
+        ImGui::Text("Coarser than Wanted");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::Text("%u", belowWantedCount);
+        ImGui::Text("In Flight");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::Text("%zu", requests.size());
+        ImGui::Text("Streamed In / Evicted");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::Text("%llu / %llu", (unsigned long long)streamedIn, (unsigned long long)evicted);
+        ImGui::Text("Uploaded");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::Text("%.1f MB (%llu failed)", bytesStreamed / mb, (unsigned long long)failedCount);
+
+        if (ImGui::TreeNode("Residency"))
+        {
+            ImGuiTableFlags flags = ImGuiTableFlags_ScrollY;
+            flags |= ImGuiTableFlags_RowBg;
+            flags |= ImGuiTableFlags_BordersOuter;
+            flags |= ImGuiTableFlags_BordersV;
+            if (ImGui::BeginTable("streamingTable", 4, flags, ImVec2(0.0f, 300.0f)))
+            {
+                ImGui::TableSetupScrollFreeze(0, 1);
+                ImGui::TableSetupColumn("Texture", ImGuiTableColumnFlags_None);
+                ImGui::TableSetupColumn("Resident", ImGuiTableColumnFlags_None);
+                ImGui::TableSetupColumn("Wanted", ImGuiTableColumnFlags_None);
+                ImGui::TableSetupColumn("MB", ImGuiTableColumnFlags_None);
+                ImGui::TableHeadersRow();
+
+                for (const TextureResource* texture : TextureManager::GetTextures())
+                {
+                    ImGui::TableNextRow();
+                    ImGui::TableSetColumnIndex(0);
+                    ImGui::Text("%s", texture->path.filename().string().c_str());
+                    ImGui::TableSetColumnIndex(1);
+                    ImGui::Text("%u (%ux%u)%s", texture->residentMip, std::max(1u, texture->width >> texture->residentMip),
+                        std::max(1u, texture->height >> texture->residentMip), texture->streaming ? " *" : "");
+                    ImGui::TableSetColumnIndex(2);
+                    if (texture->streamable)
+                    {
+                        ImGui::Text("%u", texture->wantedMip);
+                    }
+                    else
+                    {
+                        ImGui::Text("full");
+                    }
+                    ImGui::TableSetColumnIndex(3);
+                    ImGui::Text("%.2f", texture->bytes / mb);
+                }
+                ImGui::EndTable();
+            }
+            ImGui::TreePop();
+        }
+    }
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "MipGenerator.h"
+#include "TextureCache.h"
+#include "TextureManager.h"
+
+// levels of a texture being read or decoded on a worker thread
+struct StreamRequest
+{
+    TextureResource* texture = nullptr;
+    uint32_t firstMip = 0;
+
+    // written by the load job, the cooked chain of compressed textures, else a decoded chain
+    CookedTexture cooked;
+    MipChain mips;
+    bool failed = false;
+    std::atomic<bool> loaded = false;
+    // the levels are recorded into the pending image of the texture, waiting for the upload
+    bool uploading = false;
+};
+
+// keeps the levels each texture needs on screen resident, under a device memory budget
+// the needed level comes from the uv density of the meshes using the texture and how large
+// their bounds are on screen, new textures only upload their small levels and the finer ones
+// are read from the cooked file or decoded on the JobSystem, then uploaded as a new image
+// that is swapped in once the upload completed, evictions copy the kept levels on the gpu
+class TextureStreamer
+{
+public:
+    static void Finish();
+    // once per frame after AssetManager::Update, with the camera of the next frame
+    static void Update(const glm::mat4& view, const glm::mat4& proj, float screenHeight);
+    static void OnImgui();
+
+    // first level uploaded for a new texture, 0 when streaming is off
+    static uint32_t GetInitialMip(const std::vector<ImageLevel>& levels);
+
+private:
+    static inline bool enabled = true;
+    static inline int budgetMB = 256;
+    // new textures start at the first level no larger than this
+    static inline int initialSize = 64;
+    static inline int maxRequests = 4;
+    // added to the computed level, positive trades sharpness for memory
+    static inline int mipBias = 0;
+
+    static inline std::vector<StreamRequest*> requests;
+
+    // of the last Update, wanted is what the visible textures need without the budget
+    static inline VkDeviceSize residentBytes = 0;
+    static inline VkDeviceSize wantedBytes = 0;
+    static inline VkDeviceSize targetBytes = 0;
+    static inline uint32_t streamableCount = 0;
+    static inline uint32_t trimmedCount = 0;
+    static inline uint32_t belowWantedCount = 0;
+
+    static inline uint64_t streamedIn = 0;
+    static inline uint64_t evicted = 0;
+    static inline uint64_t failedCount = 0;
+    static inline VkDeviceSize bytesStreamed = 0;
+
+    static void computeWantedMips(const glm::mat4& view, const glm::mat4& proj, float screenHeight);
+    // device memory of the chain from firstMip, a level is a quarter of the one above
+    static VkDeviceSize estimateBytes(const TextureResource* texture, uint32_t firstMip);
+    static void request(TextureResource* texture, uint32_t firstMip);
+    static void load(StreamRequest* request);
+    // uploads the levels of finished loads and swaps in the images of finished uploads
+    static void finishRequests();
+};
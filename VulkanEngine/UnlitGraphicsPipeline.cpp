@@ -1,5 +1,8 @@
 #include "UnlitGraphicsPipeline.h"
 
+#include <filesystem>
+#include <iostream>
+
 void UnlitGraphicsPipeline::Setup()
 {
     desc.name = "Unlit";
@@ -72,8 +75,9 @@ void UnlitGraphicsPipeline::Setup()
     desc.bindings[0].descriptorCount = 1;
     desc.bindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 
+    // every model reads its slice of the per-frame model buffer through a dynamic offset
     desc.bindings[1].binding = 0;
-    desc.bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    desc.bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     desc.bindings[1].descriptorCount = 1;
     desc.bindings[1].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 
@@ -84,20 +88,168 @@ void UnlitGraphicsPipeline::Setup()
     desc.bindings[2].pImmutableSamplers = nullptr;
     // here we specify in which shader stages the buffer will by referenced
     desc.bindings[2].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    // committed next to vert.spv and frag.spv, compile.bat rebuilds them
+    indirectShaders = std::filesystem::exists("indirect_vert.spv") && std::filesystem::exists("indirect_frag.spv");
+    if (!indirectShaders)
+    {
+        return;
+    }
+
+    indirectDesc = desc;
+    indirectDesc.name = "Unlit Indirect";
+    indirectDesc.colorBlendState.pAttachments = &indirectDesc.colorBlendAttachment;
+    indirectDesc.shaderStages[0].shaderBytes = FileManager::ReadRawBytes("indirect_vert.spv");
+    indirectDesc.shaderStages[1].shaderBytes = FileManager::ReadRawBytes("indirect_frag.spv");
+
+    // every draw reads its ObjectData through gl_InstanceIndex
+    indirectDesc.bindings[1].binding = 0;
+    indirectDesc.bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    indirectDesc.bindings[1].descriptorCount = 1;
+    indirectDesc.bindings[1].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+    indirectDesc.bindings[2].binding = 0;
+    indirectDesc.bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    indirectDesc.bindings[2].descriptorCount = GraphicsPipelineManager::MaxBindlessTextures;
+    indirectDesc.bindings[2].pImmutableSamplers = nullptr;
+    indirectDesc.bindings[2].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+}
+
+bool UnlitGraphicsPipeline::IsIndirectSupported()
+{
+    const auto& features = PhysicalDevice::GetFeatures();
+    const auto& limits = PhysicalDevice::GetProperties().limits;
+
+    // multiDrawIndirect is optional, without it every command is its own indirect call
+    return indirectShaders &&
+        features.drawIndirectFirstInstance &&
+        features.shaderSampledImageArrayDynamicIndexing &&
+        limits.maxPerStageDescriptorSamplers >= GraphicsPipelineManager::MaxBindlessTextures &&
+        limits.maxPerStageDescriptorSampledImages >= GraphicsPipelineManager::MaxBindlessTextures &&
+        limits.maxDescriptorSetSamplers >= GraphicsPipelineManager::MaxBindlessTextures;
+}
+
+void UnlitGraphicsPipeline::SetRecordTime(DrawPath path, float ms)
+{
+    float& average = recordMs[(int)path];
+    average = average == 0.0f ? ms : average * 0.95f + ms * 0.05f;
+}
+
+void UnlitGraphicsPipeline::SetRecordBenchmark(const std::vector<float>& ms)
+{
+    recordBenchmarkMs = ms;
+    recordBenchmarkRequested = false;
 }
 
 void UnlitGraphicsPipeline::Create()
 {
 	desc.multisampling.rasterizationSamples = SwapChain::GetNumSamples();
 	GraphicsPipelineManager::CreatePipeline(desc, resource);
+
+	if (IsIndirectSupported())
+	{
+		// follows the settings edited through the per model pipeline
+		indirectDesc.rasterizer = desc.rasterizer;
+		indirectDesc.multisampling = desc.multisampling;
+		indirectDesc.depthStencil = desc.depthStencil;
+		GraphicsPipelineManager::CreatePipeline(indirectDesc, indirectResource);
+	}
+	else
+	{
+		// otherwise the toggle just disappears from the ui
+		std::cerr << "Indirect draw path disabled, drawing per model: " << (indirectShaders
+			? "the device lacks drawIndirectFirstInstance, sampler array indexing or enough sampler descriptors"
+			: "indirect_vert.spv or indirect_frag.spv not found") << std::endl;
+	}
+}
+
+void UnlitGraphicsPipeline::Rebuild()
+{
+	desc.multisampling.rasterizationSamples = SwapChain::GetNumSamples();
+	GraphicsPipelineManager::BuildPipeline(desc, resource);
+
+	if (indirectResource.pipeline != VK_NULL_HANDLE)
+	{
+		indirectDesc.rasterizer = desc.rasterizer;
+		indirectDesc.multisampling = desc.multisampling;
+		indirectDesc.depthStencil = desc.depthStencil;
+		GraphicsPipelineManager::BuildPipeline(indirectDesc, indirectResource);
+	}
 }
 
 void UnlitGraphicsPipeline::Destroy()
 {
 	GraphicsPipelineManager::DestroyPipeline(resource);
+	if (indirectResource.pipeline != VK_NULL_HANDLE)
+	{
+		GraphicsPipelineManager::DestroyPipeline(indirectResource);
+		indirectResource = GraphicsPipelineResource{};
+	}
 }
 
 void UnlitGraphicsPipeline::OnImgui()
 {
+	const auto totalSpace = ImGui::GetContentRegionAvail();
+	const float totalWidth = totalSpace.x;
+
 	GraphicsPipelineManager::OnImgui(desc, resource);
+
+	if (ImGui::CollapsingHeader("Unlit Draw Path"))
+	{
+		ImGui::Text("Indirect");
+		ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+		if (indirectResource.pipeline != VK_NULL_HANDLE)
+		{
+			ImGui::PushID("useIndirect");
+			ImGui::Checkbox("", &useIndirect);
+			ImGui::PopID();
+		}
+		else
+		{
+			ImGui::Text(indirectShaders ? "Unsupported" : "Shaders missing");
+		}
+		ImGui::Text("Multi Draw");
+		ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+		ImGui::Text(PhysicalDevice::GetFeatures().multiDrawIndirect ? "Yes" : "No");
+		ImGui::Text("Record Per Model");
+		ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+		ImGui::Text("%.3f ms", recordMs[0]);
+		ImGui::Text("Record Indirect");
+		ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+		ImGui::Text("%.3f ms", recordMs[1]);
+		ImGui::Text("Record Parallel");
+		ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+		ImGui::Text("%.3f ms", recordMs[2]);
+		ImGui::Text("Parallel Recording");
+		ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+		ImGui::PushID("useParallel");
+		ImGui::Checkbox("", &useParallel);
+		ImGui::PopID();
+		ImGui::Text("Record Threads");
+		ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+		ImGui::SetNextItemWidth(totalWidth * 2.0f / 5.0f);
+		ImGui::PushID("recordThreads");
+		ImGui::SliderInt("", &recordThreads, 1, (int)JobSystem::GetThreadCount() + 1);
+		ImGui::PopID();
+		ImGui::Text("Scaling Benchmark");
+		ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+		ImGui::PushID("recordBenchmark");
+		if (ImGui::Button("Run"))
+		{
+			recordBenchmarkRequested = true;
+		}
+		ImGui::PopID();
+		for (size_t i = 0; i < recordBenchmarkMs.size(); i++)
+		{
+			ImGui::Text("%zu Threads", i + 1);
+			ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+			ImGui::Text("%.3f ms (x%.2f)", recordBenchmarkMs[i], recordBenchmarkMs[0] / recordBenchmarkMs[i]);
+		}
+		if (indirectResource.pipeline != VK_NULL_HANDLE)
+		{
+			ImGui::Text("Indirect Build");
+			ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+			ImGui::Text("%.3f ms", indirectResource.buildMs);
+		}
+	}
 }
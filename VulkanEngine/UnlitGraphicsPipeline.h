@@ -1,5 +1,7 @@
 #pragma once
 
+#include <algorithm>
+
 #include "GraphicsPipelineManager.h"
 
 #include "MeshManager.h"
@@ -7,19 +9,58 @@
 #include "FileManager.h"
 #include "SwapChain.h"
 
+enum class DrawPath
+{
+    PerModel,
+    Indirect,
+    Parallel,
+};
+
 class UnlitGraphicsPipeline
 {
 public:
+    // size of the synthetic scene the recording benchmark runs on
+    static constexpr uint32_t BenchmarkModels = 50000;
+
     static void Setup();
     static void Create();
     static void Destroy();
+    // rebuilds the pipelines against the current render pass and state, layouts are kept
+    static void Rebuild();
     static void OnImgui();
 
+    // the indirect path needs its compiled shaders and a few core features
+    static bool IsIndirectSupported();
+    // cpu time spent recording scene draws, smoothed over frames
+    static void SetRecordTime(DrawPath path, float ms);
+    // best recording time for 1 to N threads, index 0 is one thread
+    static void SetRecordBenchmark(const std::vector<float>& ms);
+
     static inline bool IsDirty() { return resource.dirty; }
+    static inline bool UseIndirect() { return useIndirect && indirectResource.pipeline != VK_NULL_HANDLE; }
+    // per model draws split into secondary command buffers recorded on the job system
+    static inline bool UseParallelRecording() { return useParallel && !UseIndirect(); }
+    static inline uint32_t GetRecordThreads() { return std::min((uint32_t)recordThreads, JobSystem::GetThreadCount() + 1); }
+    static inline bool IsRecordBenchmarkRequested() { return recordBenchmarkRequested; }
     static inline GraphicsPipelineResource& GetResource() { return resource; }
+    static inline GraphicsPipelineResource& GetIndirectResource() { return indirectResource; }
 
 private:
     static inline GraphicsPipelineDescriptor desc{};
     static inline GraphicsPipelineResource resource{};
+
+    // same fixed function state, reads per object data from a storage buffer
+    // and textures from one array instead of per model descriptor sets
+    static inline GraphicsPipelineDescriptor indirectDesc{};
+    static inline GraphicsPipelineResource indirectResource{};
+    static inline bool indirectShaders = false;
+    static inline bool useIndirect = true;
+
+    static inline bool useParallel = false;
+    static inline int recordThreads = 4;
+
+    static inline float recordMs[3] = { 0.0f, 0.0f, 0.0f };
+    static inline bool recordBenchmarkRequested = false;
+    static inline std::vector<float> recordBenchmarkMs;
 };
 
@@ -0,0 +1,639 @@
+#include "UploadManager.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "GpuProfiler.h"
+#include "imgui/imgui.h"
+
+void UploadManager::Create()
+{
+    auto device = LogicalDevice::GetVkDevice();
+    separateTransfer = PhysicalDevice::HasDedicatedTransfer();
+    if (LogicalDevice::IsTimelineSupported())
+    {
+        timeline = LogicalDevice::CreateTimelineSemaphore();
+    }
+
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+    poolInfo.queueFamilyIndex = PhysicalDevice::GetGraphicsFamily();
+    auto res = vkCreateCommandPool(device, &poolInfo, Instance::GetAllocator(), &graphicsPool);
+    if (res != VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to create upload command pool!");
+    }
+
+    if (separateTransfer)
+    {
+        poolInfo.queueFamilyIndex = PhysicalDevice::GetTransferFamily();
+        res = vkCreateCommandPool(device, &poolInfo, Instance::GetAllocator(), &transferPool);
+        if (res != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create transfer command pool!");
+        }
+    }
+}
+
+void UploadManager::Destroy()
+{
+    auto device = LogicalDevice::GetVkDevice();
+
+    WaitIdle();
+
+    for (UploadBatch* batch : freeBatches)
+    {
+        destroyBatch(batch);
+    }
+    freeBatches.clear();
+
+    if (timeline != VK_NULL_HANDLE)
+    {
+        vkDestroySemaphore(device, timeline, Instance::GetAllocator());
+        timeline = VK_NULL_HANDLE;
+    }
+
+    vkDestroyCommandPool(device, graphicsPool, Instance::GetAllocator());
+    graphicsPool = VK_NULL_HANDLE;
+    if (transferPool != VK_NULL_HANDLE)
+    {
+        vkDestroyCommandPool(device, transferPool, Instance::GetAllocator());
+        transferPool = VK_NULL_HANDLE;
+    }
+}
+
+uint64_t UploadManager::UploadBuffer(VkBuffer dst, const void* data, VkDeviceSize size, VkDeviceSize dstOffset)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+
+    UploadBatch* batch = getBatch();
+    uint64_t ticket = batch->ticket;
+
+    VkDeviceSize srcOffset;
+    VkBuffer src = allocateStaging(batch, data, size, srcOffset);
+
+    VkBufferCopy region{};
+    region.srcOffset = srcOffset;
+    region.dstOffset = dstOffset;
+    region.size = size;
+    vkCmdCopyBuffer(batch->transferCommands, src, dst, 1, &region);
+
+    if (separateTransfer)
+    {
+        // hand the buffer over to the graphics family
+        VkBufferMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcQueueFamilyIndex = PhysicalDevice::GetTransferFamily();
+        barrier.dstQueueFamilyIndex = PhysicalDevice::GetGraphicsFamily();
+        barrier.buffer = dst;
+        barrier.offset = dstOffset;
+        barrier.size = size;
+
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = 0;
+        vkCmdPipelineBarrier(batch->transferCommands, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+        vkCmdPipelineBarrier(batch->graphicsCommands, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+    }
+
+    batch->bytes += size;
+    batch->copies++;
+    if (batch->bytes >= maxBatchBytes)
+    {
+        Submit();
+    }
+    return ticket;
+}
+
+uint64_t UploadManager::UploadImage(const ImageDesc& desc, ImageResource& resource, const void* data, VkDeviceSize size)
+{
+    ImageLevel level{ 0, size, desc.width, desc.height };
+    return uploadImage(desc, resource, data, size, &level, 1);
+}
+
+uint64_t UploadManager::UploadImageLevels(const ImageDesc& desc, ImageResource& resource, const void* data, VkDeviceSize size, const std::vector<ImageLevel>& levels)
+{
+    return uploadImage(desc, resource, data, size, levels.data(), (uint32_t)levels.size());
+}
+
+uint64_t UploadManager::uploadImage(const ImageDesc& desc, ImageResource& resource, const void* data, VkDeviceSize size, const ImageLevel* levels, uint32_t levelCount)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+
+    UploadBatch* batch = getBatch();
+    uint64_t ticket = batch->ticket;
+
+    VkDeviceSize srcOffset;
+    VkBuffer src = allocateStaging(batch, data, size, srcOffset);
+
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = resource.image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = desc.mipLevels;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+    vkCmdPipelineBarrier(batch->transferCommands, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    std::vector<VkBufferImageCopy> regions(levelCount);
+    for (uint32_t i = 0; i < levelCount; i++)
+    {
+        VkBufferImageCopy& region = regions[i];
+        region.bufferOffset = srcOffset + levels[i].offset;
+        region.bufferRowLength = 0;
+        region.bufferImageHeight = 0;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = i;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageOffset = { 0, 0, 0 };
+        region.imageExtent = { levels[i].width, levels[i].height, 1 };
+    }
+
+    vkCmdCopyBufferToImage(batch->transferCommands, src, resource.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, levelCount, regions.data());
+
+    if (separateTransfer)
+    {
+        // the layout stays TRANSFER_DST, only the owner changes
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcQueueFamilyIndex = PhysicalDevice::GetTransferFamily();
+        barrier.dstQueueFamilyIndex = PhysicalDevice::GetGraphicsFamily();
+
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = 0;
+        vkCmdPipelineBarrier(batch->transferCommands, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(batch->graphicsCommands, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+    }
+
+    if (levelCount < desc.mipLevels)
+    {
+        // blits need a graphics queue, transfer only families can't do them
+        ImageManager::RecordMipmaps(batch->graphicsCommands, desc, resource);
+    }
+    else
+    {
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(batch->graphicsCommands, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+    }
+
+    batch->bytes += size;
+    batch->copies++;
+    if (batch->bytes >= maxBatchBytes)
+    {
+        Submit();
+    }
+    return ticket;
+}
+
+uint64_t UploadManager::CopyBuffer(VkBuffer src, VkBuffer dst, VkDeviceSize size)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+
+    // both buffers are owned by the graphics family, so the copy is recorded there
+    // src has to stay alive until the ticket completes
+    UploadBatch* batch = getBatch();
+
+    // src may have been filled earlier in this batch, on a single queue the transfer and
+    // graphics commands are the same buffer and nothing else orders those writes
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = src;
+    barrier.offset = 0;
+    barrier.size = size;
+    vkCmdPipelineBarrier(batch->graphicsCommands, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+    VkBufferCopy region{};
+    region.srcOffset = 0;
+    region.dstOffset = 0;
+    region.size = size;
+    vkCmdCopyBuffer(batch->graphicsCommands, src, dst, 1, &region);
+
+    batch->copies++;
+    return batch->ticket;
+}
+
+uint64_t UploadManager::CopyImageLevels(const ImageResource& src, uint32_t srcFirstMip, const ImageDesc& desc, ImageResource& dst)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+
+    // both images are owned by the graphics family, so the copy is recorded there
+    // src has to stay alive until the ticket completes
+    UploadBatch* batch = getBatch();
+
+    VkImageMemoryBarrier barriers[2]{};
+    for (VkImageMemoryBarrier& barrier : barriers)
+    {
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.levelCount = desc.mipLevels;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = 1;
+    }
+
+    // earlier frames may still sample src
+    barriers[0].image = src.image;
+    barriers[0].subresourceRange.baseMipLevel = srcFirstMip;
+    barriers[0].oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barriers[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+    barriers[1].image = dst.image;
+    barriers[1].subresourceRange.baseMipLevel = 0;
+    barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barriers[1].srcAccessMask = 0;
+    barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+    vkCmdPipelineBarrier(batch->graphicsCommands, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 2, barriers);
+
+    std::vector<VkImageCopy> regions(desc.mipLevels);
+    for (uint32_t i = 0; i < desc.mipLevels; i++)
+    {
+        VkImageCopy& region = regions[i];
+        region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.srcSubresource.mipLevel = srcFirstMip + i;
+        region.srcSubresource.baseArrayLayer = 0;
+        region.srcSubresource.layerCount = 1;
+        region.srcOffset = { 0, 0, 0 };
+        region.dstSubresource = region.srcSubresource;
+        region.dstSubresource.mipLevel = i;
+        region.dstOffset = { 0, 0, 0 };
+        region.extent = { std::max(1u, desc.width >> i), std::max(1u, desc.height >> i), 1 };
+    }
+
+    vkCmdCopyImage(batch->graphicsCommands, src.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, dst.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, desc.mipLevels, regions.data());
+
+    // src goes back to being sampled until the new image is swapped in
+    barriers[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barriers[0].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barriers[0].srcAccessMask = 0;
+    barriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    barriers[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barriers[1].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    vkCmdPipelineBarrier(batch->graphicsCommands, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 2, barriers);
+
+    batch->copies++;
+    return batch->ticket;
+}
+
+void UploadManager::Submit()
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+
+    if (current != nullptr)
+    {
+        submitBatch(current);
+        current = nullptr;
+    }
+}
+
+void UploadManager::Update()
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+
+    auto device = LogicalDevice::GetVkDevice();
+
+    // every batch ends on the graphics queue, so they finish in submission order
+    uint64_t signaled = timeline != VK_NULL_HANDLE ? LogicalDevice::GetTimelineValue(timeline) : 0;
+    auto isDone = [&](UploadBatch* batch)
+    {
+        return timeline != VK_NULL_HANDLE ? batch->ticket <= signaled : vkGetFenceStatus(device, batch->fence) == VK_SUCCESS;
+    };
+
+    size_t retired = 0;
+    while (retired < pending.size() && isDone(pending[retired]))
+    {
+        completedTicket = pending[retired]->ticket;
+        retireBatch(pending[retired]);
+        retired++;
+    }
+    pending.erase(pending.begin(), pending.begin() + retired);
+}
+
+bool UploadManager::IsComplete(uint64_t ticket)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+
+    if (ticket > completedTicket)
+    {
+        Update();
+    }
+    return ticket <= completedTicket;
+}
+
+void UploadManager::Wait(uint64_t ticket)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+
+    if (ticket <= completedTicket)
+    {
+        return;
+    }
+    if (current != nullptr && current->ticket <= ticket)
+    {
+        Submit();
+    }
+
+    auto waitStart = std::chrono::high_resolution_clock::now();
+
+    std::vector<VkFence> fences;
+    uint64_t lastTicket = 0;
+    for (UploadBatch* batch : pending)
+    {
+        if (batch->ticket <= ticket)
+        {
+            fences.push_back(batch->fence);
+            lastTicket = batch->ticket;
+        }
+    }
+    if (timeline != VK_NULL_HANDLE && lastTicket != 0)
+    {
+        // only wait for values that were actually submitted
+        LogicalDevice::WaitTimeline(timeline, lastTicket);
+    }
+    else if (!fences.empty())
+    {
+        vkWaitForFences(LogicalDevice::GetVkDevice(), (uint32_t)fences.size(), fences.data(), VK_TRUE, UINT64_MAX);
+    }
+    totalWaitMs += std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - waitStart).count();
+    Update();
+}
+
+void UploadManager::WaitIdle()
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+
+    Submit();
+    Wait(nextTicket - 1);
+}
+
+void UploadManager::OnImgui()
+{
+    const auto totalSpace = ImGui::GetContentRegionAvail();
+    const float totalWidth = totalSpace.x;
+
+    if (ImGui::CollapsingHeader("Uploads"))
+    {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+
+        ImGui::Text("Transfer Queue");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::Text(separateTransfer ? "Dedicated (family %d)" : "Graphics (family %d)", PhysicalDevice::GetTransferFamily());
+        ImGui::Text("Batches");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::Text("%llu", (unsigned long long)totalBatches);
+        ImGui::Text("Copies");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::Text("%llu", (unsigned long long)totalCopies);
+        ImGui::Text("Uploaded");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::Text("%.2f MB", totalBytes / (1024.0f * 1024.0f));
+        ImGui::Text("Pending Batches");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::Text("%zu", pending.size());
+        ImGui::Text("Sync");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::Text(timeline != VK_NULL_HANDLE ? "Timeline" : "Fences");
+        ImGui::Text("Wait Time");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::Text("%.2f ms", totalWaitMs);
+        ImGui::Text("Completed Ticket");
+        ImGui::SameLine(totalWidth * 3.0f / 5.0f);
+        ImGui::Text("%llu", (unsigned long long)completedTicket);
+    }
+}
+
+UploadBatch* UploadManager::getBatch()
+{
+    if (current != nullptr)
+    {
+        return current;
+    }
+
+    auto device = LogicalDevice::GetVkDevice();
+
+    UploadBatch* batch = nullptr;
+    if (!freeBatches.empty())
+    {
+        batch = freeBatches.back();
+        freeBatches.pop_back();
+    }
+    else
+    {
+        batch = new UploadBatch();
+
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+
+        allocInfo.commandPool = graphicsPool;
+        vkAllocateCommandBuffers(device, &allocInfo, &batch->graphicsCommands);
+
+        if (separateTransfer)
+        {
+            allocInfo.commandPool = transferPool;
+            vkAllocateCommandBuffers(device, &allocInfo, &batch->transferCommands);
+
+            VkSemaphoreCreateInfo semaphoreInfo{};
+            semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+            vkCreateSemaphore(device, &semaphoreInfo, Instance::GetAllocator(), &batch->transferDone);
+        }
+        else
+        {
+            // copies and mips share the one graphics command buffer
+            batch->transferCommands = batch->graphicsCommands;
+        }
+
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        auto res = vkCreateFence(device, &fenceInfo, Instance::GetAllocator(), &batch->fence);
+        if (res != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create upload fence!");
+        }
+    }
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    vkBeginCommandBuffer(batch->graphicsCommands, &beginInfo);
+    if (separateTransfer)
+    {
+        vkBeginCommandBuffer(batch->transferCommands, &beginInfo);
+    }
+    batch->querySlot = GpuProfiler::BeginUpload(batch->graphicsCommands);
+
+    batch->ticket = nextTicket++;
+    current = batch;
+    return batch;
+}
+
+VkBuffer UploadManager::allocateStaging(UploadBatch* batch, const void* data, VkDeviceSize size, VkDeviceSize& offset)
+{
+    // copy offsets have to be a multiple of the texel size, 16 covers every format we upload
+    VkDeviceSize alignment = std::max<VkDeviceSize>(16, PhysicalDevice::GetProperties().limits.optimalBufferCopyOffsetAlignment);
+    offset = (batch->stagingOffset + alignment - 1) / alignment * alignment;
+
+    if (batch->staging.empty() || offset + size > batch->staging.back().allocation.size)
+    {
+        BufferDescriptor stagingDesc;
+        stagingDesc.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        stagingDesc.properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        stagingDesc.size = std::max(stagingChunkSize, size);
+
+        BufferResource chunk;
+        BufferManager::Create(stagingDesc, chunk);
+        batch->staging.push_back(chunk);
+        offset = 0;
+    }
+
+    BufferResource& chunk = batch->staging.back();
+    BufferManager::Update(chunk, data, size, offset);
+    batch->stagingOffset = offset + size;
+    return chunk.buffer;
+}
+
+void UploadManager::submitBatch(UploadBatch* batch)
+{
+    // make everything written by the batch visible to any later graphics work
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+    vkCmdPipelineBarrier(batch->graphicsCommands, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+
+    if (separateTransfer)
+    {
+        vkEndCommandBuffer(batch->transferCommands);
+
+        submitInfo.pCommandBuffers = &batch->transferCommands;
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores = &batch->transferDone;
+        auto res = vkQueueSubmit(LogicalDevice::GetTransferQueue(), 1, &submitInfo, VK_NULL_HANDLE);
+        if (res != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to submit transfer commands!");
+        }
+
+        submitInfo.signalSemaphoreCount = 0;
+        submitInfo.pSignalSemaphores = nullptr;
+        submitInfo.waitSemaphoreCount = 1;
+        submitInfo.pWaitSemaphores = &batch->transferDone;
+        submitInfo.pWaitDstStageMask = &waitStage;
+    }
+
+    GpuProfiler::EndUpload(batch->graphicsCommands, batch->querySlot);
+    vkEndCommandBuffer(batch->graphicsCommands);
+
+    VkFence fence = batch->fence;
+    uint64_t waitValue = 0;
+    VkTimelineSemaphoreSubmitInfoKHR timelineInfo{};
+    if (timeline != VK_NULL_HANDLE)
+    {
+        // tickets are handed out and submitted in order, so they are valid timeline values
+        timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+        timelineInfo.waitSemaphoreValueCount = submitInfo.waitSemaphoreCount;
+        timelineInfo.pWaitSemaphoreValues = &waitValue;
+        timelineInfo.signalSemaphoreValueCount = 1;
+        timelineInfo.pSignalSemaphoreValues = &batch->ticket;
+        submitInfo.pNext = &timelineInfo;
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores = &timeline;
+        fence = VK_NULL_HANDLE;
+    }
+
+    submitInfo.pCommandBuffers = &batch->graphicsCommands;
+    auto res = vkQueueSubmit(LogicalDevice::GetGraphicsQueue(), 1, &submitInfo, fence);
+    if (res != VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to submit upload commands!");
+    }
+
+    totalBatches++;
+    totalCopies += batch->copies;
+    totalBytes += batch->bytes;
+    pending.push_back(batch);
+}
+
+void UploadManager::retireBatch(UploadBatch* batch)
+{
+    auto device = LogicalDevice::GetVkDevice();
+
+    GpuProfiler::ResolveUpload(batch->querySlot);
+    batch->querySlot = UINT32_MAX;
+
+    for (BufferResource& chunk : batch->staging)
+    {
+        BufferManager::Destroy(chunk);
+    }
+    batch->staging.clear();
+    batch->stagingOffset = 0;
+    batch->bytes = 0;
+    batch->copies = 0;
+
+    vkResetFences(device, 1, &batch->fence);
+    vkResetCommandBuffer(batch->graphicsCommands, 0);
+    if (separateTransfer)
+    {
+        vkResetCommandBuffer(batch->transferCommands, 0);
+    }
+
+    freeBatches.push_back(batch);
+}
+
+void UploadManager::destroyBatch(UploadBatch* batch)
+{
+    auto device = LogicalDevice::GetVkDevice();
+
+    vkDestroyFence(device, batch->fence, Instance::GetAllocator());
+    if (batch->transferDone != VK_NULL_HANDLE)
+    {
+        vkDestroySemaphore(device, batch->transferDone, Instance::GetAllocator());
+    }
+    vkFreeCommandBuffers(device, graphicsPool, 1, &batch->graphicsCommands);
+    if (separateTransfer)
+    {
+        vkFreeCommandBuffers(device, transferPool, 1, &batch->transferCommands);
+    }
+    delete batch;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <mutex>
+
+#include "LogicalDevice.h"
+#include "PhysicalDevice.h"
+#include "BufferManager.h"
+#include "ImageManager.h"
+
+// a set of copies recorded together and submitted with a single fence
+// when the transfer family is separate the copies run on the transfer queue
+// and the graphics command buffer acquires ownership and generates mips
+struct UploadBatch
+{
+    VkCommandBuffer transferCommands = VK_NULL_HANDLE;
+    VkCommandBuffer graphicsCommands = VK_NULL_HANDLE;
+    VkSemaphore transferDone = VK_NULL_HANDLE;
+    VkFence fence = VK_NULL_HANDLE;
+    uint64_t ticket = 0;
+    // gpu profiler slot, only spans the graphics side when the transfer family is separate
+    uint32_t querySlot = UINT32_MAX;
+
+    // staging memory is kept alive until the fence signals
+    std::vector<BufferResource> staging;
+    VkDeviceSize stagingOffset = 0;
+    VkDeviceSize bytes = 0;
+    uint32_t copies = 0;
+};
+
+class UploadManager
+{
+public:
+    static void Create();
+    static void Destroy();
+    static void OnImgui();
+
+    // every upload returns the ticket of the batch it was recorded in
+    static uint64_t UploadBuffer(VkBuffer dst, const void* data, VkDeviceSize size, VkDeviceSize dstOffset = 0);
+    static uint64_t UploadImage(const ImageDesc& desc, ImageResource& resource, const void* data, VkDeviceSize size);
+    // a prebuilt mip chain, the image is left in SHADER_READ_ONLY without any blit
+    static uint64_t UploadImageLevels(const ImageDesc& desc, ImageResource& resource, const void* data, VkDeviceSize size, const std::vector<ImageLevel>& levels);
+    static uint64_t CopyBuffer(VkBuffer src, VkBuffer dst, VkDeviceSize size);
+    // levels srcFirstMip and up of a sampled image into every level of a new one, both
+    // are left in SHADER_READ_ONLY
+    static uint64_t CopyImageLevels(const ImageResource& src, uint32_t srcFirstMip, const ImageDesc& desc, ImageResource& dst);
+
+    // submits the open batch, if any
+    static void Submit();
+    // retires finished batches and releases their staging memory
+    static void Update();
+
+    static bool IsComplete(uint64_t ticket);
+    static void Wait(uint64_t ticket);
+    static void WaitIdle();
+
+private:
+    static inline VkCommandPool transferPool = VK_NULL_HANDLE;
+    static inline VkCommandPool graphicsPool = VK_NULL_HANDLE;
+    static inline bool separateTransfer = false;
+
+    static inline UploadBatch* current = nullptr;
+    static inline std::vector<UploadBatch*> pending;
+    static inline std::vector<UploadBatch*> freeBatches;
+    static inline std::recursive_mutex mutex;
+
+    // when supported the graphics submit of a batch signals its ticket on one timeline
+    // semaphore, instead of the per batch fence
+    static inline VkSemaphore timeline = VK_NULL_HANDLE;
+
+    static inline uint64_t nextTicket = 1;
+    static inline uint64_t completedTicket = 0;
+
+    static inline VkDeviceSize stagingChunkSize = 16ull * 1024 * 1024;
+    // batches are submitted early once they hold this much staging data
+    static inline VkDeviceSize maxBatchBytes = 128ull * 1024 * 1024;
+
+    static inline uint64_t totalBatches = 0;
+    static inline uint64_t totalCopies = 0;
+    static inline VkDeviceSize totalBytes = 0;
+    static inline float totalWaitMs = 0.0f;
+
+    static UploadBatch* getBatch();
+    // a full chain is copied as is, otherwise the rest of the chain is blitted from level 0
+    static uint64_t uploadImage(const ImageDesc& desc, ImageResource& resource, const void* data, VkDeviceSize size, const ImageLevel* levels, uint32_t levelCount);
+    static VkBuffer allocateStaging(UploadBatch* batch, const void* data, VkDeviceSize size, VkDeviceSize& offset);
+    static void submitBatch(UploadBatch* batch);
+    static void retireBatch(UploadBatch* batch);
+    static void destroyBatch(UploadBatch* batch);
+};
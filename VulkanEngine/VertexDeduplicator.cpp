@@ -0,0 +1,78 @@
+#include "VertexDeduplicator.h"
+
+#include <cstring>
+
+static_assert(sizeof(MeshVertex) % sizeof(uint64_t) == 0, "MeshVertex is hashed as 64 bit words");
+
+void VertexDeduplicator::Reserve(size_t maxVertices)
+{
+    size_t capacity = 16;
+    while (capacity < maxVertices * 2)
+    {
+        capacity *= 2;
+    }
+
+    if (capacity > slots.size())
+    {
+        slots.assign(capacity, emptySlot);
+        usedSlots.clear();
+        mask = capacity - 1;
+    }
+    else
+    {
+        Clear();
+    }
+    usedSlots.reserve(maxVertices);
+}
+
+void VertexDeduplicator::Clear()
+{
+    for (uint32_t slot : usedSlots)
+    {
+        slots[slot] = emptySlot;
+    }
+    usedSlots.clear();
+}
+
+uint32_t VertexDeduplicator::Insert(const MeshVertex& vertex, std::vector<MeshVertex>& vertices)
+{
+    uint64_t slot = Hash(vertex) & mask;
+    while (true)
+    {
+        uint32_t index = slots[slot];
+        if (index == emptySlot)
+        {
+            index = (uint32_t)vertices.size();
+            slots[slot] = index;
+            usedSlots.push_back((uint32_t)slot);
+            vertices.push_back(vertex);
+            return index;
+        }
+        // bytes are compared to stay consistent with the hash
+        if (memcmp(&vertices[index], &vertex, sizeof(MeshVertex)) == 0)
+        {
+            return index;
+        }
+        slot = (slot + 1) & mask;
+    }
+}
+
+uint64_t VertexDeduplicator::Hash(const MeshVertex& vertex)
+{
+    uint64_t words[sizeof(MeshVertex) / sizeof(uint64_t)];
+    memcpy(words, &vertex, sizeof(MeshVertex));
+
+    // multiply and rotate per word, then a murmur style finalizer so the
+    // low bits used for the slot depend on every input bit
+    uint64_t hash = 0x9e3779b97f4a7c15ull;
+    for (uint64_t word : words)
+    {
+        hash ^= word * 0xbf58476d1ce4e5b9ull;
+        hash = (hash << 31) | (hash >> 33);
+        hash *= 0x94d049bb133111ebull;
+    }
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    return hash;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "MeshManager.h"
+
+// open addressing hash table from vertex bytes to the vertex index in the output,
+// replaces std::unordered_map<MeshVertex, uint32_t> in the importers
+class VertexDeduplicator
+{
+public:
+    // sized for the worst case where every index is a new vertex, the table is
+    // never rehashed and stays at most half full
+    void Reserve(size_t maxVertices);
+    // forgets every inserted vertex, only touches the slots that were used
+    void Clear();
+
+    // returns the index of the vertex, appending it to vertices if it is new
+    uint32_t Insert(const MeshVertex& vertex, std::vector<MeshVertex>& vertices);
+
+    static uint64_t Hash(const MeshVertex& vertex);
+
+private:
+    static constexpr uint32_t emptySlot = ~0u;
+
+    std::vector<uint32_t> slots;
+    std::vector<uint32_t> usedSlots;
+    uint64_t mask = 0;
+};
@@ -2,6 +2,13 @@
 
 void Window::Create()
 {
+	if (headless)
+	{
+		lastTime = std::chrono::high_resolution_clock::now();
+		dirty = false;
+		return;
+	}
+
 	glfwInit();
 
 	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
@@ -79,6 +86,11 @@ void Window::Update()
 	deltaTime /= 1000.0f;
 	lastTime = newTime;
 
+	if (headless)
+	{
+		return;
+	}
+
 	double x;
 	double y;
 	glfwGetCursorPos(window, &x, &y);
@@ -89,6 +101,11 @@ void Window::Update()
 
 void Window::Destroy()
 {
+	if (headless)
+	{
+		return;
+	}
+
 	glfwGetWindowPos(window, &posX, &posY);
 	glfwDestroyWindow(window);
 	glfwTerminate();
@@ -97,6 +114,10 @@ void Window::Destroy()
 void Window::UpdateFramebufferSize()
 {
 	framebufferResized = false;
+	if (headless)
+	{
+		return;
+	}
 	glfwGetFramebufferSize(window, &width, &height);
 }
 
@@ -17,21 +17,27 @@ public:
     static void OnImgui();
     static void ApplyChanges();
 
+    // no glfw window or surface, the swapchain renders into offscreen images of width x height
+    // must be set before Create
+    static inline void SetHeadless(uint32_t width, uint32_t height) { headless = true; Window::width = width; Window::height = height; }
+    static inline bool IsHeadless() { return headless; }
+
     static inline GLFWwindow* GetGLFWwindow() { return window; }
     static inline bool IsDirty() { return dirty; }
-    static inline void WaitEvents() { glfwWaitEvents(); }
+    static inline void WaitEvents() { if (!headless) { glfwWaitEvents(); } }
     static inline uint32_t GetWidth() { return width; }
     static inline uint32_t GetHeight() { return height; }
     static inline float GetDeltaTime() { return deltaTime; }
-    static inline bool GetShouldClose() { return glfwWindowShouldClose(window) || IsKeyDown(GLFW_KEY_ESCAPE); }
+    static inline bool GetShouldClose() { return !headless && (glfwWindowShouldClose(window) || IsKeyDown(GLFW_KEY_ESCAPE)); }
     static inline float GetDeltaScroll() { return deltaScroll; }
     static inline glm::vec2 GetDeltaMouse() { return deltaMousePos; }
     static inline bool GetFramebufferResized() { return framebufferResized; }
-    static inline bool IsKeyDown(uint16_t keyCode) { return glfwGetKey(window, keyCode); }
-    static inline bool IsMouseDown(uint16_t buttonCode) { return glfwGetMouseButton(window, buttonCode); }
+    static inline bool IsKeyDown(uint16_t keyCode) { return !headless && glfwGetKey(window, keyCode); }
+    static inline bool IsMouseDown(uint16_t buttonCode) { return !headless && glfwGetMouseButton(window, buttonCode); }
 
 private:
     static inline GLFWwindow* window = nullptr;
+    static inline bool headless = false;
     static inline GLFWmonitor** monitors = nullptr;
     static inline const char* name = "Window";
     static inline int width = 1280;
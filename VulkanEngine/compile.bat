@@ -1,3 +1,5 @@
 C:/VulkanSDK/1.3.268.0/Bin/glslc.exe shader.vert -o vert.spv
 C:/VulkanSDK/1.3.268.0/Bin/glslc.exe shader.frag -o frag.spv
+C:/VulkanSDK/1.3.268.0/Bin/glslc.exe indirect.vert -o indirect_vert.spv
+C:/VulkanSDK/1.3.268.0/Bin/glslc.exe indirect.frag -o indirect_frag.spv
 pause
\ No newline at end of file
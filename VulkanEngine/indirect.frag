@@ -0,0 +1,15 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// must match GraphicsPipelineManager::MaxBindlessTextures
+layout(set = 2, binding = 0) uniform sampler2D textures[256];
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragTexCoord;
+layout(location = 2) flat in uint fragTextureIndex;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    outColor = texture(textures[fragTextureIndex], fragTexCoord) * vec4(fragColor, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,32 @@
+#version 450
+
+layout(set = 0, binding = 0) uniform UniformBufferObject {
+    mat4 view;
+    mat4 proj;
+} scene;
+
+struct ObjectData {
+    mat4 model;
+    uint textureIndex;
+};
+
+// one entry per draw, selected by the firstInstance of its indirect command
+layout(std430, set = 1, binding = 0) readonly buffer ObjectBuffer {
+    ObjectData objects[];
+};
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inColor;
+layout(location = 2) in vec2 inTexCoord;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) flat out uint fragTextureIndex;
+
+void main() {
+    ObjectData object = objects[gl_InstanceIndex];
+    gl_Position = scene.proj * scene.view * object.model * vec4(inPosition, 1.0);
+    fragColor = inColor;
+    fragTexCoord = inTexCoord;
+    fragTextureIndex = object.textureIndex;
+}
\ No newline at end of file
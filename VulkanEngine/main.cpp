@@ -13,10 +13,21 @@
 #include "SceneManager.h"
 #include "TextureManager.h"
 #include "AssetManager.h"
+#include "MemoryAllocator.h"
+#include "UploadManager.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+#include "MeshOptimizer.h"
+#include "PipelineCache.h"
+#include "GpuProfiler.h"
+#include "TextureCache.h"
+#include "MipGenerator.h"
+#include "TextureStreamer.h"
 
 #include <iostream>
 #include <stdexcept>
 #include <cstdlib>
+#include <cstdio>
 #include <vector>
 #include <optional>
 #include <set>
@@ -67,6 +78,16 @@ void CheckVulkanResult(VkResult res)
     }
 }
 
+// replays a fixed camera orbit offscreen, without glfw, and reports frame times
+struct HeadlessSettings
+{
+    uint32_t frames = 300;
+    uint32_t width = 1280;
+    uint32_t height = 720;
+    std::string pngPath;
+    std::string csvPath;
+};
+
 class HelloTriangleApplication
 {
 public:
@@ -78,6 +99,15 @@ public:
         Finish();
 	}
 
+    void runHeadless(const HeadlessSettings& settings)
+    {
+        Window::SetHeadless(settings.width, settings.height);
+        Setup();
+        Create();
+        HeadlessLoop(settings);
+        Finish();
+    }
+
 private:
 	Camera camera;
 
@@ -86,8 +116,13 @@ private:
     //imgui
     ImDrawData* imguiDrawData = nullptr;
 
+    // image the last submitted frame rendered into
+    uint32_t lastImage = 0;
+
     void Setup()
     {
+        Profiler::Create();
+        JobSystem::Create();
         UnlitGraphicsPipeline::Setup();
         TextureManager::Setup();
         SetupImgui();
@@ -106,6 +141,10 @@ private:
         Instance::Create();
         PhysicalDevice::Create();
         LogicalDevice::Create();
+        MemoryAllocator::Create();
+        PipelineCache::Create();
+        GpuProfiler::Create();
+        UploadManager::Create();
         SwapChain::Create();
 
         std::cout << "Finish creating SwapChain" << std::endl;
@@ -129,10 +168,14 @@ private:
     void Finish() 
     {
         DestroyVulkan();
+        JobSystem::Destroy();
+        AssetManager::Destroy();
+        TextureStreamer::Finish();
         SceneManager::Finish();
         MeshManager::Finish();
         TextureManager::Finish();
         FinishImgui();
+        Profiler::Destroy();
     }
 
     void DestroyVulkan() 
@@ -142,8 +185,13 @@ private:
 
         DestroyFrameResources();
         
+        UploadManager::Destroy();
+        GpuProfiler::Destroy();
         MeshManager::Destroy();
         TextureManager::Destroy();
+        // written back on every device teardown so a crash later loses little
+        PipelineCache::Destroy();
+        MemoryAllocator::Destroy();
         LogicalDevice::Destroy();
         PhysicalDevice::Destroy();
         Instance::Destroy();
@@ -168,6 +216,9 @@ private:
         auto instance = Instance::GetInstance();
         while (!Window::GetShouldClose()) 
         {
+            Profiler::BeginFrame();
+            PROFILE_ZONE("Frame");
+
             Window::Update();
             camera.Update();
             drawFrame();
@@ -183,9 +234,9 @@ private:
             }
             else if (UnlitGraphicsPipeline::IsDirty())
             {
+                // only the pipeline state changed, layouts and descriptor sets stay valid
                 vkDeviceWaitIdle(LogicalDevice::GetVkDevice());
-                UnlitGraphicsPipeline::Destroy();
-                UnlitGraphicsPipeline::Create();
+                UnlitGraphicsPipeline::Rebuild();
             }
             else if (Window::IsDirty())
             {
@@ -195,6 +246,84 @@ private:
         vkDeviceWaitIdle(LogicalDevice::GetVkDevice());
     }
 
+    void HeadlessLoop(const HeadlessSettings& settings)
+    {
+        // textures stream in over the first frames, they are not part of the measurement
+        const uint32_t maxLoadFrames = 10000;
+        const uint32_t warmupFrames = 30;
+        uint32_t loadFrames = 0;
+        while (!AssetManager::IsIdle() && loadFrames < maxLoadFrames)
+        {
+            drawFrame();
+            loadFrames++;
+        }
+        if (!AssetManager::IsIdle())
+        {
+            std::cerr << "Textures still loading after " << loadFrames << " frames" << std::endl;
+        }
+
+        std::vector<float> frameMs;
+        frameMs.reserve(settings.frames);
+        for (uint32_t i = 0; i < warmupFrames + settings.frames; i++)
+        {
+            Profiler::BeginFrame();
+            PROFILE_ZONE("Frame");
+
+            // one full orbit over the measured frames, the same path on every run
+            float t = i < warmupFrames ? 0.0f : (float)(i - warmupFrames) / std::max(1u, settings.frames);
+            camera.SetOrbit(glm::vec3(0.0f, 1.0f, 0.0f), -20.0f, 360.0f * t, 15.0f);
+
+            auto start = std::chrono::high_resolution_clock::now();
+            Window::Update();
+            drawFrame();
+            auto end = std::chrono::high_resolution_clock::now();
+
+            if (i >= warmupFrames)
+            {
+                frameMs.push_back(std::chrono::duration<float, std::milli>(end - start).count());
+            }
+        }
+        vkDeviceWaitIdle(LogicalDevice::GetVkDevice());
+
+        std::vector<float> sorted = frameMs;
+        std::sort(sorted.begin(), sorted.end());
+        auto percentile = [&](float p)
+        {
+            return sorted.empty() ? 0.0f : sorted[std::min(sorted.size() - 1, (size_t)(p * sorted.size()))];
+        };
+        float total = 0.0f;
+        for (float ms : frameMs)
+        {
+            total += ms;
+        }
+        float average = frameMs.empty() ? 0.0f : total / frameMs.size();
+
+        std::cout << "Headless " << settings.width << "x" << settings.height << ", " << frameMs.size() << " frames on " << PhysicalDevice::GetProperties().deviceName << std::endl;
+        std::cout << "  avg " << average << " ms (" << (average > 0.0f ? 1000.0f / average : 0.0f) << " fps)" << std::endl;
+        std::cout << "  min " << percentile(0.0f) << " ms, p50 " << percentile(0.5f) << " ms, p95 " << percentile(0.95f)
+            << " ms, p99 " << percentile(0.99f) << " ms, max " << (sorted.empty() ? 0.0f : sorted.back()) << " ms" << std::endl;
+
+        if (!settings.csvPath.empty())
+        {
+            std::ofstream csv(settings.csvPath, std::ios::trunc);
+            csv << "frame,ms\n";
+            for (size_t i = 0; i < frameMs.size(); i++)
+            {
+                csv << i << "," << frameMs[i] << "\n";
+            }
+            std::cout << (csv.good() ? "Wrote " : "Failed to write ") << settings.csvPath << std::endl;
+        }
+
+        if (!settings.pngPath.empty())
+        {
+            std::vector<uint8_t> pixels;
+            SwapChain::ReadImage(lastImage, pixels);
+            auto extent = SwapChain::GetExtent();
+            bool written = FileManager::WritePng(settings.pngPath, extent.width, extent.height, pixels.data());
+            std::cout << (written ? "Wrote " : "Failed to write ") << settings.pngPath << std::endl;
+        }
+    }
+
     bool DirtyGlobalResources() 
     {
         bool dirty = false;
@@ -214,6 +343,7 @@ private:
 
     void imguiDrawFrame()
     {
+        PROFILE_FUNCTION();
         auto device = LogicalDevice::GetVkDevice();
         auto instance = Instance::GetInstance();
         ImGui_ImplVulkan_NewFrame();
@@ -226,13 +356,25 @@ private:
             Instance::OnImgui();
             PhysicalDevice::OnImgui();
             LogicalDevice::OnImgui();
+            MemoryAllocator::OnImgui();
+            UploadManager::OnImgui();
+            JobSystem::OnImgui();
+            AssetManager::OnImgui();
+            TextureManager::OnImgui();
+            MipGenerator::OnImgui();
+            TextureStreamer::OnImgui();
+            MeshManager::OnImgui();
+            MeshOptimizer::OnImgui();
             SwapChain::OnImgui();
             UnlitGraphicsPipeline::OnImgui();
+            PipelineCache::OnImgui();
             camera.OnImgui();
         }
         ImGui::End();
 
         SceneManager::OnImgui();
+        Profiler::OnImgui();
+        GpuProfiler::OnImgui();
 
         ImGuizmo::BeginFrame();
         static ImGuizmo::OPERATION currentGizmoOperation = ImGuizmo::ROTATE;
@@ -340,15 +482,145 @@ private:
 
     }
 
-    void updateCommandBuffer(size_t frameIndex) 
+    void setViewportAndScissor(VkCommandBuffer commandBuffer)
+    {
+        // dynamic in every pipeline, the extent only lives in the swapchain
+        VkViewport viewport{};
+        viewport.x = 0.0f;
+        viewport.y = 0.0f;
+        viewport.width = (float)SwapChain::GetExtent().width;
+        viewport.height = (float)SwapChain::GetExtent().height;
+        viewport.minDepth = 0.0f;
+        viewport.maxDepth = 1.0f;
+        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+        VkRect2D scissor{};
+        scissor.offset = { 0, 0 };
+        scissor.extent = SwapChain::GetExtent();
+        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+    }
+
+    // per model draws of [first, last), binds everything itself so it records the same
+    // into the primary or into any secondary
+    void recordModels(VkCommandBuffer commandBuffer, uint32_t frameIndex, uint32_t first, uint32_t last)
+    {
+        auto unlitGPR = UnlitGraphicsPipeline::GetResource();
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, unlitGPR.pipeline);
+
+        auto sceneDescriptor = SceneManager::GetSceneDescriptor(frameIndex);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, unlitGPR.layout, 0, 1, &sceneDescriptor, 0, nullptr);
+
+        // every mesh is a range of the same two buffers
+        MeshManager::Bind(commandBuffer);
+
+        const auto& models = SceneManager::GetModels();
+        auto modelDescriptor = SceneManager::GetModelDescriptor();
+        for (uint32_t i = first; i < last; i++)
+        {
+            const Model* model = models[i];
+            if (model->mesh != nullptr) 
+            {
+                MeshResource* mesh = model->mesh;
+
+                uint32_t modelOffset = SceneManager::GetModelOffset(frameIndex, i);
+                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, unlitGPR.layout, 1, 1, &modelDescriptor, 1, &modelOffset);
+                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, unlitGPR.layout, 2, 1, &model->materialDescriptor, 0, nullptr);
+                vkCmdDrawIndexed(commandBuffer, mesh->indexCount, 1, mesh->firstIndex, mesh->vertexOffset, 0);
+            }
+        }
+    }
+
+    VkCommandBuffer beginSecondary(uint32_t frameIndex, uint32_t imageIndex)
+    {
+        VkCommandBuffer commandBuffer = SwapChain::GetSecondaryCommandBuffer(frameIndex);
+
+        VkCommandBufferInheritanceInfo inheritanceInfo{};
+        inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritanceInfo.renderPass = SwapChain::GetRenderPass();
+        inheritanceInfo.subpass = 0;
+        inheritanceInfo.framebuffer = SwapChain::GetFramebuffer(imageIndex);
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+        if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) 
+        {
+            throw std::runtime_error("failed to begin recording secondary command buffer!");
+        }
+        return commandBuffer;
+    }
+
+    // splits the model list in chunkCount contiguous ranges, each recorded into a secondary
+    // on whichever thread picks it up, from that thread's pool
+    void recordModelsParallel(uint32_t frameIndex, uint32_t imageIndex, uint32_t chunkCount, std::vector<VkCommandBuffer>& secondaries)
+    {
+        const uint32_t modelCount = (uint32_t)SceneManager::GetModels().size();
+        chunkCount = std::max(1u, std::min(chunkCount, modelCount));
+
+        secondaries.resize(chunkCount);
+        JobSystem::ParallelFor(chunkCount, [&](uint32_t chunk)
+        {
+            PROFILE_ZONE("Record Chunk");
+            uint32_t first = (uint32_t)((uint64_t)modelCount * chunk / chunkCount);
+            uint32_t last = (uint32_t)((uint64_t)modelCount * (chunk + 1) / chunkCount);
+
+            VkCommandBuffer commandBuffer = beginSecondary(frameIndex, imageIndex);
+            setViewportAndScissor(commandBuffer);
+            recordModels(commandBuffer, frameIndex, first, last);
+            if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) 
+            {
+                throw std::runtime_error("failed to record secondary command buffer!");
+            }
+            secondaries[chunk] = commandBuffer;
+        }, JobPriority::High);
+    }
+
+    // records the per model path with 1 to N chunks and keeps the best of a few runs,
+    // nothing is submitted and the frame's pools are reset between runs
+    void benchmarkRecording(uint32_t frameIndex, uint32_t imageIndex)
+    {
+        const uint32_t maxThreads = JobSystem::GetThreadCount() + 1;
+        const uint32_t runs = 5;
+        const size_t modelCount = SceneManager::GetModels().size();
+        if (modelCount < UnlitGraphicsPipeline::BenchmarkModels)
+        {
+            std::cerr << "Recording benchmark needs a model with a mesh to spawn from, running on " << modelCount << " models" << std::endl;
+        }
+
+        std::vector<float> results;
+        std::vector<VkCommandBuffer> secondaries;
+        for (uint32_t threads = 1; threads <= maxThreads; threads++)
+        {
+            float best = 0.0f;
+            for (uint32_t run = 0; run < runs; run++)
+            {
+                auto start = std::chrono::high_resolution_clock::now();
+                recordModelsParallel(frameIndex, imageIndex, threads, secondaries);
+                auto end = std::chrono::high_resolution_clock::now();
+                SwapChain::ResetFrame(frameIndex);
+
+                float ms = std::chrono::duration<float, std::milli>(end - start).count();
+                best = run == 0 ? ms : std::min(best, ms);
+            }
+            results.push_back(best);
+            std::cout << "Recorded " << modelCount << " models on " << threads << " threads in " << best << " ms" << std::endl;
+        }
+        UnlitGraphicsPipeline::SetRecordBenchmark(results);
+    }
+
+    void updateCommandBuffer(uint32_t frameIndex, uint32_t imageIndex) 
     {
+        PROFILE_FUNCTION();
         auto device = LogicalDevice::GetVkDevice();
         auto instance = Instance::GetInstance();
         auto commandBuffer = SwapChain::GetCommandBuffer(frameIndex);
 
         VkCommandBufferBeginInfo beginInfo{};
         beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-        beginInfo.flags = 0;
+        // recorded again every frame after the pool reset
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
         beginInfo.pInheritanceInfo = nullptr;
 
         if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) 
@@ -356,10 +628,12 @@ private:
             throw std::runtime_error("failed to begin recording command buffer!");
         }
 
+        GpuProfiler::BeginFrame(commandBuffer, frameIndex);
+
         VkRenderPassBeginInfo renderPassInfo{};
         renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
         renderPassInfo.renderPass = SwapChain::GetRenderPass();
-        renderPassInfo.framebuffer = SwapChain::GetFramebuffer(frameIndex);
+        renderPassInfo.framebuffer = SwapChain::GetFramebuffer(imageIndex);
 
         renderPassInfo.renderArea.offset = { 0, 0 };
         renderPassInfo.renderArea.extent = SwapChain::GetExtent();
@@ -370,32 +644,83 @@ private:
         renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
         renderPassInfo.pClearValues = clearValues.data();
 
-        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        bool indirect = UnlitGraphicsPipeline::UseIndirect();
+        bool parallel = UnlitGraphicsPipeline::UseParallelRecording();
 
-        auto sceneDescriptor = SceneManager::GetSceneDescriptor(frameIndex);
-        auto unlitGPR = UnlitGraphicsPipeline::GetResource();
-        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, unlitGPR.pipeline);
+        GpuProfiler::BeginRegion(commandBuffer, frameIndex, GpuRegion::Scene);
 
-        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, unlitGPR.layout, 0, 1, &sceneDescriptor, 0, nullptr);
+        // a subpass is either all inline or all secondaries, imgui gets its own secondary then
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, parallel ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
+
+        auto recordStart = std::chrono::high_resolution_clock::now();
 
-        for (const Model* model : SceneManager::GetModels())
+        if (parallel)
         {
-            if (model->mesh != nullptr) 
+            std::vector<VkCommandBuffer> secondaries;
+            recordModelsParallel(frameIndex, imageIndex, UnlitGraphicsPipeline::GetRecordThreads(), secondaries);
+
+            auto recordEnd = std::chrono::high_resolution_clock::now();
+            UnlitGraphicsPipeline::SetRecordTime(DrawPath::Parallel, std::chrono::duration<float, std::milli>(recordEnd - recordStart).count());
+
+            // the primary may only execute secondaries here, so the imgui secondary closes the scene region
+            VkCommandBuffer imguiBuffer = beginSecondary(frameIndex, imageIndex);
+            GpuProfiler::EndRegion(imguiBuffer, frameIndex, GpuRegion::Scene);
+            GpuProfiler::BeginRegion(imguiBuffer, frameIndex, GpuRegion::Imgui);
+            if (imguiDrawData != nullptr)
             {
-                MeshResource* mesh = model->mesh;
-                VkBuffer vertexBuffers[] = { mesh->vertexBuffer.buffer };
-                VkDeviceSize offsets[] = { 0 };
-                vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
-                vkCmdBindIndexBuffer(commandBuffer, mesh->indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
-
-                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, unlitGPR.layout, 1, 1, &model->descriptors[frameIndex], 0, nullptr);
-                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, unlitGPR.layout, 2, 1, &model->materialDescriptors[frameIndex], 0, nullptr);
-                vkCmdDrawIndexed(commandBuffer, mesh->indexCount, 1, 0, 0, 0);
+                ImGui_ImplVulkan_RenderDrawData(imguiDrawData, imguiBuffer);
             }
+            GpuProfiler::EndRegion(imguiBuffer, frameIndex, GpuRegion::Imgui);
+            if (vkEndCommandBuffer(imguiBuffer) != VK_SUCCESS) 
+            {
+                throw std::runtime_error("failed to record secondary command buffer!");
+            }
+            secondaries.push_back(imguiBuffer);
+
+            // executed in order, imgui last so it draws on top
+            vkCmdExecuteCommands(commandBuffer, (uint32_t)secondaries.size(), secondaries.data());
         }
+        else
+        {
+            setViewportAndScissor(commandBuffer);
+            GpuProfiler::BeginStatistics(commandBuffer, frameIndex);
 
-        //imgui draw
-        ImGui_ImplVulkan_RenderDrawData(imguiDrawData, commandBuffer);
+            if (indirect)
+            {
+                // object data and textures are indexed in the shaders, the whole scene is a few indirect calls
+                auto indirectGPR = UnlitGraphicsPipeline::GetIndirectResource();
+                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, indirectGPR.pipeline);
+
+                std::array<VkDescriptorSet, 3> sets =
+                {
+                    SceneManager::GetSceneDescriptor(frameIndex),
+                    SceneManager::GetObjectDescriptor(frameIndex),
+                    SceneManager::GetTextureArrayDescriptor(frameIndex)
+                };
+                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, indirectGPR.layout, 0, (uint32_t)sets.size(), sets.data(), 0, nullptr);
+
+                MeshManager::Bind(commandBuffer);
+                SceneManager::DrawIndirect(commandBuffer, frameIndex);
+            }
+            else
+            {
+                recordModels(commandBuffer, frameIndex, 0, (uint32_t)SceneManager::GetModels().size());
+            }
+
+            auto recordEnd = std::chrono::high_resolution_clock::now();
+            UnlitGraphicsPipeline::SetRecordTime(indirect ? DrawPath::Indirect : DrawPath::PerModel, std::chrono::duration<float, std::milli>(recordEnd - recordStart).count());
+
+            GpuProfiler::EndStatistics(commandBuffer, frameIndex);
+            GpuProfiler::EndRegion(commandBuffer, frameIndex, GpuRegion::Scene);
+
+            //imgui draw
+            GpuProfiler::BeginRegion(commandBuffer, frameIndex, GpuRegion::Imgui);
+            if (imguiDrawData != nullptr)
+            {
+                ImGui_ImplVulkan_RenderDrawData(imguiDrawData, commandBuffer);
+            }
+            GpuProfiler::EndRegion(commandBuffer, frameIndex, GpuRegion::Imgui);
+        }
 
         vkCmdEndRenderPass(commandBuffer);
 
@@ -408,10 +733,22 @@ private:
 
     void drawFrame() 
     {
+        PROFILE_FUNCTION();
         auto device = LogicalDevice::GetVkDevice();
         auto instance = Instance::GetInstance();
+
+        // uploads recorded since the last frame go out before this frame's commands
+        UploadManager::Submit();
+        UploadManager::Update();
+        MeshManager::Update();
+        TextureManager::Update();
+        AssetManager::Update();
+        TextureStreamer::Update(camera.GetView(), camera.GetProj(), (float)SwapChain::GetExtent().height);
      
-        imguiDrawFrame();
+        if (!Window::IsHeadless())
+        {
+            imguiDrawFrame();
+        }
 
         auto image = SwapChain::Acquire();
 
@@ -420,14 +757,34 @@ private:
             return;
         }
         
-        updateUniformBuffer(image);
-        updateCommandBuffer(image);
+        uint32_t frame = SwapChain::GetCurrentFrame();
+        bool recordBenchmark = UnlitGraphicsPipeline::IsRecordBenchmarkRequested();
+        size_t keepSpawned = SceneManager::GetSpawnedCount();
+        if (recordBenchmark)
+        {
+            // the synthetic scene has to be in this frame's model data before anything records it,
+            // it only lives for the run
+            size_t modelCount = SceneManager::GetModels().size();
+            if (modelCount < UnlitGraphicsPipeline::BenchmarkModels)
+            {
+                SceneManager::SpawnModels(UnlitGraphicsPipeline::BenchmarkModels - (uint32_t)modelCount);
+            }
+        }
+        updateUniformBuffer(frame);
+        if (recordBenchmark)
+        {
+            benchmarkRecording(frame, image);
+            SceneManager::ClearSpawnedModels(keepSpawned);
+        }
+        updateCommandBuffer(frame, image);
 
         SwapChain::SubmitAndPresent(image);
+        lastImage = image;
     }
 
     void RecreateFrameResources()
     {
+        PROFILE_FUNCTION();
         auto device = LogicalDevice::GetVkDevice();
         auto instance = Instance::GetInstance();
 
@@ -440,14 +797,70 @@ private:
 
         Window::UpdateFramebufferSize();
         vkDeviceWaitIdle(device);
-        DestroyFrameResources();
-        PhysicalDevice::OnSurfaceUpdate();
-        SwapChain::Create();
-        GraphicsPipelineManager::Create();
-        UnlitGraphicsPipeline::Create();
-        SceneManager::Create();
-        CreateImgui();
+
+        auto recreateStart = std::chrono::high_resolution_clock::now();
+        const char* mode = "Swapchain";
+
+        if (SwapChain::IsFullRecreateForced())
+        {
+            // the old path, kept to compare against
+            mode = "Full";
+            DestroyFrameResources();
+            PhysicalDevice::OnSurfaceUpdate();
+            SwapChain::Create();
+            GraphicsPipelineManager::Create();
+            UnlitGraphicsPipeline::Create();
+            SceneManager::Create();
+            CreateImgui();
+        }
+        else
+        {
+            VkFormat colorFormat = SwapChain::GetColorFormat();
+            VkFormat depthFormat = SwapChain::GetDepthFormat();
+            VkSampleCountFlagBits numSamples = SwapChain::GetNumSamples();
+            uint32_t numImages = SwapChain::GetNumFrames();
+            uint32_t numFrames = SwapChain::GetFramesInFlight();
+
+            PhysicalDevice::OnSurfaceUpdate();
+            SwapChain::Recreate();
+
+            // pipelines only depend on render pass compatibility and per frame data on the frames in flight,
+            // a plain resize or extra swapchain images keep every scene descriptor and uniform buffer
+            bool renderPassChanged = colorFormat != SwapChain::GetColorFormat() ||
+                depthFormat != SwapChain::GetDepthFormat() ||
+                numSamples != SwapChain::GetNumSamples();
+            bool framesChanged = numFrames != SwapChain::GetFramesInFlight();
+            bool imageCountChanged = numImages != SwapChain::GetNumFrames();
+
+            if (renderPassChanged || framesChanged || imageCountChanged)
+            {
+                // imgui allocates from the shared descriptor pool, renders into the render pass
+                // and keeps buffers per swapchain image
+                DestroyImgui();
+            }
+            if (framesChanged)
+            {
+                mode = "Descriptors";
+                SceneManager::Destroy();
+                GraphicsPipelineManager::Destroy();
+                GraphicsPipelineManager::Create();
+                SceneManager::Create();
+            }
+            if (renderPassChanged)
+            {
+                mode = framesChanged ? "Descriptors + Pipelines" : "Pipelines";
+                UnlitGraphicsPipeline::Rebuild();
+            }
+            if (renderPassChanged || framesChanged || imageCountChanged)
+            {
+                CreateImgui();
+            }
+        }
+
         createUniformProjection();
+
+        auto recreateEnd = std::chrono::high_resolution_clock::now();
+        SwapChain::RecordRecreate(std::chrono::duration<float, std::milli>(recreateEnd - recreateStart).count(), mode);
     }
 
     void createUniformProjection() 
@@ -456,16 +869,14 @@ private:
         camera.SetExtent(ext.width, ext.height);
     }
 
-    void updateUniformBuffer(uint32_t currentImage) 
+    void updateUniformBuffer(uint32_t frameIndex) 
     {
-        for (Model* model : SceneManager::GetModels()) 
-        {
-            BufferManager::Update(model->buffers[currentImage], &model->ubo, sizeof(model->ubo));
-        }
+        PROFILE_FUNCTION();
+        SceneManager::UpdateModels(frameIndex);
 
         sceneUBO.view = camera.GetView();
         sceneUBO.proj = camera.GetProj();
-        BufferManager::Update(SceneManager::GetUniformBuffer(currentImage), &sceneUBO, sizeof(sceneUBO));
+        BufferManager::Update(SceneManager::GetUniformBuffer(frameIndex), &sceneUBO, sizeof(sceneUBO));
     }
 
     void SetupImgui() 
@@ -478,6 +889,12 @@ private:
 
     void CreateImgui() 
     {
+        // the glfw backend needs a window, headless frames draw no ui
+        if (Window::IsHeadless())
+        {
+            return;
+        }
+
         auto device = LogicalDevice::GetVkDevice();
         auto instance = Instance::GetInstance();
 
@@ -491,10 +908,11 @@ private:
         initInfo.Device = device;
         initInfo.QueueFamily = PhysicalDevice::GetGraphicsFamily();
         initInfo.Queue = LogicalDevice::GetGraphicsQueue();
-        initInfo.PipelineCache = VK_NULL_HANDLE;
+        initInfo.PipelineCache = PipelineCache::GetVkPipelineCache();
         initInfo.DescriptorPool = GraphicsPipelineManager::GetDescriptorPool();
         initInfo.MinImageCount = 2;
-        initInfo.ImageCount = (uint32_t)SwapChain::GetNumFrames();
+        // imgui rotates its own buffers, it must not reuse one a frame in flight still reads
+        initInfo.ImageCount = std::max(SwapChain::GetNumFrames(), SwapChain::GetFramesInFlight());
         initInfo.MSAASamples = SwapChain::GetNumSamples();
         initInfo.Allocator = Instance::GetAllocator();
         initInfo.CheckVkResultFn = CheckVulkanResult;
@@ -508,6 +926,10 @@ private:
 
     void DestroyImgui() 
     {
+        if (Window::IsHeadless())
+        {
+            return;
+        }
         ImGui_ImplVulkan_Shutdown();
         ImGui_ImplGlfw_Shutdown();
     }
@@ -519,13 +941,96 @@ private:
 
 };
 
-int main()
+int main(int argc, char** argv)
 {
+	// cpu only, no window or device is created
+	if (argc > 1 && std::string(argv[1]) == "--bench-assets")
+	{
+		AssetManager::BenchmarkDedup({ "assets/sponza/sponza.obj" });
+		AssetManager::BenchmarkLoad({ "assets/sponza/sponza.obj" });
+		MeshOptimizer::PrintReport();
+		return EXIT_SUCCESS;
+	}
+
+	// cpu only, writes a block compressed .tex next to every image
+	// --cook [directory] [--bc7] [--verify]
+	if (argc > 1 && std::string(argv[1]) == "--cook")
+	{
+		std::filesystem::path directory = "assets/sponza";
+		bool highQuality = false;
+		// decodes every block again and prints the PSNR of each texture
+		bool verify = false;
+		for (int i = 2; i < argc; i++)
+		{
+			std::string arg = argv[i];
+			if (arg == "--bc7")
+			{
+				highQuality = true;
+			}
+			else if (arg == "--verify")
+			{
+				verify = true;
+			}
+			else
+			{
+				directory = arg;
+			}
+		}
+		JobSystem::Create();
+		TextureCache::CookDirectory(directory, highQuality, verify);
+		JobSystem::Destroy();
+		return EXIT_SUCCESS;
+	}
+
+	// cpu only, mip generation scalar against simd and over 1 to N threads
+	// --bench-mips [directory]
+	if (argc > 1 && std::string(argv[1]) == "--bench-mips")
+	{
+		MipGenerator::Benchmark(argc > 2 ? argv[2] : "assets/sponza");
+		return EXIT_SUCCESS;
+	}
+
+	// offscreen replay for benchmarks on machines without a display
+	// --headless [frames] [--size WxH] [--png file] [--csv file]
+	bool headless = argc > 1 && std::string(argv[1]) == "--headless";
+	HeadlessSettings headlessSettings;
+	for (int i = 2; headless && i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--png" && i + 1 < argc)
+		{
+			headlessSettings.pngPath = argv[++i];
+		}
+		else if (arg == "--csv" && i + 1 < argc)
+		{
+			headlessSettings.csvPath = argv[++i];
+		}
+		else if (arg == "--size" && i + 1 < argc)
+		{
+			if (sscanf(argv[++i], "%ux%u", &headlessSettings.width, &headlessSettings.height) != 2)
+			{
+				std::cerr << "Expected --size WIDTHxHEIGHT" << std::endl;
+				return EXIT_FAILURE;
+			}
+		}
+		else
+		{
+			headlessSettings.frames = (uint32_t)std::max(1, atoi(arg.c_str()));
+		}
+	}
+
 	HelloTriangleApplication app;
 
 	try
 	{
-		app.run();
+		if (headless)
+		{
+			app.runHeadless(headlessSettings);
+		}
+		else
+		{
+			app.run();
+		}
 	}
 	catch (const std::exception& e)
 	{